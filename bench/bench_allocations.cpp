@@ -0,0 +1,101 @@
+// Counts heap allocations made while rendering a typical UI frame, with and
+// without a FrameArena attached to the Painter and the fonts.
+//
+// Usage: bench_allocations [--frames N]
+
+#include "cvimgproc.h"
+#include <atomic>
+#include <new>
+
+namespace
+{
+    std::atomic<uint64_t> heap_allocations{ 0 };
+}
+
+void* operator new(size_t size)
+{
+    heap_allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        abort();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+    void render_frame(cv::Painter& painter, cv::FontBase& ascii_font, cv::FontBase& gb2312_font, int frame)
+    {
+        painter.fill(cv::RGB565_BLACK);
+        painter.rectangle(cv::Point(10, 10), cv::Point(310, 60), cv::RGB565_BLUE, cv::FILLED);
+        painter.putText("Speed 42 km/h", cv::Point(16, 20), ascii_font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        painter.putText("\xCB\xD9\xB6\xC8", cv::Point(200, 20), gb2312_font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        painter.circle(cv::Point(80, 150), 50, cv::RGB565_GREEN, 3);
+        painter.ellipse(cv::Point(80, 150), cv::Size(40, 40), 0.0f, 0.0f, float(frame % 360), cv::RGB565_YELLOW, cv::FILLED);
+        painter.ellipse(cv::RotatedRect(cv::Point2f(230, 150), cv::Size2f(120, 60), 20.0f), cv::RGB565_RED, 2);
+        painter.ellipse(cv::Point(230, 150), cv::Size(30, 20), 0.0f, 0.0f, 360.0f, cv::RGB565_CYAN, cv::FILLED);
+        static const std::vector<cv::Point> trend{ { 10, 230 }, { 60, 210 }, { 110, 220 }, { 160, 200 }, { 210, 215 }, { 310, 205 } };
+        painter.polyline(trend, cv::RGB565_MAGENTA, 2);
+        painter.putText("Battery 87%  Temp 23C", cv::Point(16, 80), ascii_font, cv::RGB565_WHITE, cv::RGB565_BLACK);
+    }
+
+    uint64_t count_allocations(cv::Painter& painter, cv::FontBase& ascii_font, cv::FontBase& gb2312_font, cv::FrameArena* arena, int frames)
+    {
+        painter.set_frame_arena(arena);
+        ascii_font.set_frame_arena(arena);
+        gb2312_font.set_frame_arena(arena);
+        uint64_t start = heap_allocations;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            render_frame(painter, ascii_font, gb2312_font, frame);
+            if (arena != nullptr)
+            {
+                arena->reset();
+            }
+        }
+        return heap_allocations - start;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = 100;
+    if (argc == 3 && std::string_view(argv[1]) == "--frames")
+    {
+        frames = std::max(1, std::atoi(argv[2]));
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--frames N]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> frame_buffer(320 * 240 * 2);
+    cv::Mat frame(240, 320, cv::RGB565, frame_buffer.data());
+    cv::Painter painter(frame);
+    cv::ASCIIFont ascii_font(_default_ascii_font);
+    cv::GB2312Font gb2312_font(_default_gb2312_font);
+    static cv::StaticFrameArena<8192> arena;
+
+    uint64_t heap_only = count_allocations(painter, ascii_font, gb2312_font, nullptr, frames);
+    uint64_t with_arena = count_allocations(painter, ascii_font, gb2312_font, &arena, frames);
+
+    std::printf("frames rendered:               %d\n", frames);
+    std::printf("heap allocations/frame, heap:  %.1f\n", double(heap_only) / frames);
+    std::printf("heap allocations/frame, arena: %.1f\n", double(with_arena) / frames);
+    std::printf("arena allocations/frame:       %.1f\n", double(arena.allocation_count()) / frames);
+    std::printf("arena high water mark:         %zu of %zu bytes\n", arena.high_water_mark(), arena.capacity());
+    std::printf("arena overflows:               %u\n", arena.overflow_count());
+    return 0;
+}
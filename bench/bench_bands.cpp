@@ -0,0 +1,118 @@
+// Draws an 800x480 RGB565 dashboard frame directly into a full framebuffer
+// and by replaying a recorded DisplayList over bands of several heights, and
+// reports the framebuffer memory and the time per frame of each. The bands
+// are assembled into a frame, which must match the direct drawing.
+//
+// Usage: bench_bands [--repeat N]
+
+#include "cvrender.h"
+#include <chrono>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    void draw_dashboard(cv::Painter& painter, cv::FontBase& font, const cv::Mat& icon)
+    {
+        painter.fill(cv::RGB565_BLACK);
+        painter.rectangle(cv::Point(0, 0), cv::Point(799, 39), cv::RGB565_BLUE, cv::FILLED);
+        painter.putText("Line 3 - Packaging", cv::Point(12, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        painter.putText("12:05:42", cv::Point(720, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        for (int i = 0; i < 3; i++)
+        {
+            cv::Point center(140 + i * 260, 200);
+            painter.circle(center, 110, cv::RGB565_CYAN, 6);
+            painter.ellipse(center, cv::Size(90, 90), 0, 135, 135 + 60 * (i + 2), cv::RGB565_GREEN, 10);
+            painter.line(center, cv::Point(center.x + 70 - i * 40, center.y - 60), cv::RGB565_RED, 4);
+            painter.circle(center, 8, cv::RGB565_WHITE, cv::FILLED);
+            painter.putText("rpm x100", cv::Point(center.x - 32, center.y + 40), font, cv::RGB565_YELLOW, cv::RGB565_BLACK);
+        }
+        std::vector<cv::Point> graph;
+        for (int x = 0; x <= 760; x += 8)
+        {
+            graph.push_back(cv::Point(20 + x, 400 - int(40 * std::sin(x / 50.0)) - x / 20));
+        }
+        painter.rectangle(cv::Point(16, 340), cv::Point(783, 463), cv::RGB565_WHITE, 1);
+        painter.polyline(graph, cv::RGB565_GREEN, 2);
+        for (int i = 0; i < 12; i++)
+        {
+            painter.rectangle(cv::Point(24 + i * 64, 450 - i * 6), cv::Point(64 + i * 64, 460), cv::RGB565_MAGENTA, cv::FILLED);
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            painter.drawBitmap(icon, cv::Point(340 + i * 40, 4));
+        }
+        painter.drawMarker(cv::Point(400, 330), cv::RGB565_YELLOW, cv::MARKER_STAR, 20, 2);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 20;
+    if (argc == 3 && std::string_view(argv[1]) == "--repeat")
+    {
+        repeat = std::max(1, std::atoi(argv[2]));
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--repeat N]\n", argv[0]);
+        return 1;
+    }
+
+    const cv::Size frame_size(800, 480);
+    cv::ASCIIFont font(_default_ascii_font);
+    cv::Mat icon(32, 32, cv::RGB565);
+    for (int y = 0; y < icon.rows; y++)
+    {
+        for (int x = 0; x < icon.cols; x++)
+        {
+            icon.at<uint16_t>(y, x) = uint16_t((x * 2) << 11 | (y * 2) << 5 | (x + y));
+        }
+    }
+
+    cv::Mat frame(frame_size, cv::RGB565);
+    auto start = bench_clock::now();
+    for (int i = 0; i < repeat; i++)
+    {
+        cv::Painter painter(frame);
+        draw_dashboard(painter, font, icon);
+    }
+    double direct_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+
+    cv::DisplayList list(frame_size, cv::RGB565);
+    start = bench_clock::now();
+    for (int i = 0; i < repeat; i++)
+    {
+        list.clear();
+        cv::Painter recorder(list);
+        draw_dashboard(recorder, font, icon);
+    }
+    double record_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+
+    std::printf("%-12s %12s %10s %10s %s\n", "mode", "buffer KB", "frame ms", "vs direct", "output");
+    std::printf("%-12s %12.1f %10.3f %10s %s\n", "full frame", frame.total() * 2 / 1024.0, direct_ms, "1.00x", "-");
+    std::printf("%-12s %12s %10.3f %10s %s\n", "record", "-", record_ms, "-", "-");
+
+    const int band_heights[] = { 8, 16, 40, 80, 160 };
+    for (int band_height : band_heights)
+    {
+        cv::Mat band(band_height, frame_size.width, cv::RGB565);
+        size_t bands = 0;
+        auto count_band = [&](const cv::Mat&, int) { bands++; };
+        start = bench_clock::now();
+        for (int i = 0; i < repeat; i++)
+        {
+            cv::render_bands(list, band, count_band);
+        }
+        double band_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+
+        cv::Mat assembled(frame_size, cv::RGB565);
+        cv::render_bands(list, band, [&](const cv::Mat& b, int y) { b.copyTo(assembled(cv::Rect(0, y, b.cols, b.rows))); });
+        bool same = memcmp(assembled.data, frame.data, frame.total() * 2) == 0;
+
+        std::string name = "800x" + std::to_string(band_height);
+        std::printf("%-12s %12.1f %10.3f %9.2fx %s\n", name.c_str(), band.total() * 2 / 1024.0, band_ms, band_ms / direct_ms,
+            same ? "ok" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Lists the Blitters of the build with their capabilities and minimum block
+// sizes, and runs fill, copy, convert, blend and expand on every supported
+// format pair through each of them, checking that they give the pixels of the
+// CPU Blitter. Linked against the library built with the DMA2D software model,
+// the DMA2D Blitter runs on the model, which also estimates its time.
+//
+// Usage: bench_blitter
+
+#include "cvimgproc.h"
+#include <chrono>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    const int types[] = { cv::RGB332, cv::RGB565, cv::ARGB8888, cv::RGB888, cv::ARGB4444, cv::A8, cv::L4 };
+    const char* type_names[] = { "RGB332", "RGB565", "ARGB8888", "RGB888", "ARGB4444", "A8", "L4" };
+    const int formats[] = { cv::COLOR_RGB332, cv::COLOR_RGB565, cv::COLOR_RGB565_SWAPPED, cv::COLOR_GRAY8, cv::COLOR_RGB888, cv::COLOR_ARGB8888 };
+    const char* format_names[] = { "RGB332", "RGB565", "RGB565S", "GRAY8", "RGB888", "ARGB8888" };
+
+    void randomize(cv::Mat& mat, uint32_t seed)
+    {
+        for (int y = 0; y < mat.rows; y++)
+        {
+            uint8_t* row = mat.ptr<uint8_t>(y);
+            for (size_t x = 0; x < (mat.cols * mat.elemBits() + 7) / 8; x++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                row[x] = uint8_t(seed >> 24);
+            }
+        }
+    }
+
+    bool same(const cv::Mat& a, const cv::Mat& b)
+    {
+        for (int y = 0; y < a.rows; y++)
+        {
+            if (memcmp(a.ptr<uint8_t>(y), b.ptr<uint8_t>(y), (a.cols * a.elemBits() + 7) / 8) != 0) return false;
+        }
+        return true;
+    }
+
+    struct Result
+    {
+        int cases = 0;
+        int mismatches = 0;
+        double host_ms = 0;
+    };
+
+    // run op through blitter and the CPU Blitter on copies of dst, compare
+    template<typename Op>
+    void run(cv::Blitter& blitter, const cv::Mat& dst, Op op, Result& result)
+    {
+        cv::Mat expected = dst.clone(), actual = dst.clone();
+        op(*cv::getCpuBlitter(), expected);
+        auto start = bench_clock::now();
+        op(blitter, actual);
+        result.host_ms += std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3;
+        result.cases++;
+        result.mismatches += !same(expected, actual);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        std::printf("Usage: %s\n", argv[0]);
+        return 1;
+    }
+    const char* op_names[] = { "fill", "copy", "convert", "blend", "expand" };
+    cv::Blitter* blitters[] = { cv::getCpuBlitter(), cv::getDma2dBlitter() };
+    std::printf("default Blitter: %s\n", cv::getBlitter()->name());
+    const cv::Size size(97, 61);
+    bool ok = true;
+    // random colors, some transparent and some translucent
+    cv::Mat palette(1, 256, cv::ARGB8888);
+    randomize(palette, 7);
+    for (int i = 0; i < 256; i += 5)
+    {
+        palette.at<uint32_t>(0, i) &= i % 2 == 0 ? 0x00FFFFFFu : 0xFFFFFFFFu;
+    }
+
+    for (cv::Blitter* blitter : blitters)
+    {
+        if (blitter == nullptr)
+        {
+            continue;
+        }
+        std::printf("\n%s Blitter, minimum pixels:", blitter->name());
+        for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+        {
+            std::printf(" %s %zu", op_names[op], blitter->get_min_pixels(cv::BlitOperation(op)));
+        }
+        std::printf("\n%-8s %-44s %6s %10s %s\n", "op", "supported", "cases", "host ms", "output");
+#if defined(CVCORE_DMA2D_EMULATION)
+        dma2d_emu::reset_stats();
+#endif
+        for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+        {
+            Result result;
+            std::string supported;
+            const bool by_format = op == cv::BLIT_CONVERT;
+            const int count = by_format ? int(sizeof(formats) / sizeof(formats[0])) : int(sizeof(types) / sizeof(types[0]));
+            for (int i = 0; i < count; i++)
+            {
+                for (int j = 0; j < count; j++)
+                {
+                    const int src = by_format ? formats[i] : types[i], dst = by_format ? formats[j] : types[j];
+                    if ((op == cv::BLIT_FILL && i != j) || (op == cv::BLIT_CONVERT && i == j) || !blitter->supports(cv::BlitOperation(op), src, dst))
+                    {
+                        continue;
+                    }
+                    const int src_type = by_format ? cv::colorFormatType(src) : src;
+                    const int dst_type = by_format ? cv::colorFormatType(dst) : dst;
+                    supported += std::string(supported.empty() ? "" : " ") + (by_format ? format_names[i] : type_names[i]);
+                    if (op != cv::BLIT_FILL)
+                    {
+                        supported += std::string(">") + (by_format ? format_names[j] : type_names[j]);
+                    }
+                    // L4 Mats and ROIs start at an even column
+                    cv::Size block = dst_type == cv::L4 ? cv::Size(96, size.height) : size;
+                    cv::Mat source(block, src_type), target(block, dst_type);
+                    randomize(source, 17 + i);
+                    randomize(target, 31 + j);
+                    switch (op)
+                    {
+                    case cv::BLIT_FILL:
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.fill(m, 0x5A3C96E1u & (dst_type == cv::L4 ? 0x0F : 0xFFFFFFFF)); }, result);
+                        break;
+                    case cv::BLIT_COPY:
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.copy(source, m); }, result);
+                        break;
+                    case cv::BLIT_CONVERT:
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.convert(source, src, m, dst); }, result);
+                        break;
+                    case cv::BLIT_BLEND:
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.blend(source, m, 255, 0x40C0E0); }, result);
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.blend(source, m, 100, 0x40C0E0); }, result);
+                        break;
+                    case cv::BLIT_EXPAND:
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.expand(source, m, palette.ptr<uint32_t>()); }, result);
+                        run(*blitter, target, [&](cv::Blitter& b, cv::Mat& m) { b.expand(source, m, palette.ptr<uint32_t>(), true); }, result);
+                        break;
+                    }
+                }
+            }
+            if (supported.size() > 44)
+            {
+                supported = supported.substr(0, 41) + "...";
+            }
+            std::printf("%-8s %-44s %6d %10.3f %s\n", op_names[op], supported.c_str(), result.cases, result.host_ms,
+                result.mismatches == 0 ? "ok" : "MISMATCH");
+            ok &= result.mismatches == 0;
+        }
+#if defined(CVCORE_DMA2D_EMULATION)
+        const dma2d_emu::Dma2dStats& stats = dma2d_emu::stats();
+        if (stats.transfers > 0)
+        {
+            std::printf("%u DMA2D transfers, estimated %.1f us against %.1f us of CPU code\n", stats.transfers,
+                stats.dma2d_us(dma2d_emu::timing_model()), stats.cpu_us(dma2d_emu::timing_model()));
+        }
+#endif
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+// Calibrates the DMA2D Blitter against the CPU one with calibrateBlitter, on
+// the software model of the DMA2D. Both sides are timed in modeled cycles:
+// the DMA2D by the model's estimate of each transfer, the CPU by a CPU
+// Blitter that adds the model's estimate of its fallback code, so the
+// crossover sizes are those of the board the model describes rather than of
+// the host.
+//
+// The calibration is stored as bytes and applied to a new Blitter, which must
+// get the same minimum sizes, and a corrupted copy must be refused. A frame's
+// worth of blocks from a typical screen (small rectangles, glyphs, icons,
+// panels, a camera image, palette sprites and a few blended overlays) is then
+// costed with every block on the CPU, every block on the DMA2D, the default
+// minimum sizes and the calibrated ones, each block going where the minimum
+// sizes send it.
+//
+// Usage: bench_calibrate [--clock-mhz F] [--bus-bytes-per-cycle F]
+
+#include "cvimgproc.h"
+
+namespace
+{
+    // the CPU Blitter, adding the modeled cycles of its fallback code
+    class ModeledCpuBlitter : public cv::CpuBlitter
+    {
+    public:
+        double cycles = 0;
+
+        virtual void fill(const cv::Mat& dst, uint32_t color) override
+        {
+            cv::CpuBlitter::fill(dst, color);
+            cycles += overhead(dst) + dst.total() * dst.elemSize() / model().cpu_store_bytes_per_cycle;
+        }
+
+        virtual void copy(const cv::Mat& src, const cv::Mat& dst) override
+        {
+            cv::CpuBlitter::copy(src, dst);
+            cycles += overhead(dst) + dst.total() * dst.elemSize() / model().cpu_copy_bytes_per_cycle;
+        }
+
+        virtual void convert(const cv::Mat& src, int src_format, const cv::Mat& dst, int dst_format) override
+        {
+            cv::CpuBlitter::convert(src, src_format, dst, dst_format);
+            cycles += overhead(dst) + dst.total() * model().cpu_convert_cycles_per_pixel;
+        }
+
+        virtual void blend(const cv::Mat& src, const cv::Mat& dst, uint8_t alpha, uint32_t color) override
+        {
+            cv::CpuBlitter::blend(src, dst, alpha, color);
+            cycles += overhead(dst) + dst.total() * model().cpu_blend_cycles_per_pixel;
+        }
+
+        virtual void expand(const cv::Mat& src, const cv::Mat& dst, const uint32_t* palette, bool blend) override
+        {
+            cv::CpuBlitter::expand(src, dst, palette, blend);
+            cycles += overhead(dst) + dst.total() * (blend ? model().cpu_blend_cycles_per_pixel : model().cpu_convert_cycles_per_pixel);
+        }
+
+    private:
+        static const dma2d_emu::Dma2dTimingModel& model()
+        {
+            return dma2d_emu::timing_model();
+        }
+
+        static double overhead(const cv::Mat& dst)
+        {
+            return model().cpu_call_cycles + dst.rows * model().cpu_line_cycles;
+        }
+    };
+
+    ModeledCpuBlitter modeled_cpu;
+
+    double modeled_cycles()
+    {
+        return dma2d_emu::stats().dma2d_cycles + modeled_cpu.cycles;
+    }
+
+    struct Block
+    {
+        cv::BlitOperation op;
+        cv::Size size;
+        int count;
+    };
+
+    // one frame of a dashboard-like RGB565 screen
+    const Block frame_blocks[] = {
+        { cv::BLIT_FILL, cv::Size(4, 4), 200 },      // markers, bullets
+        { cv::BLIT_FILL, cv::Size(24, 12), 60 },     // small buttons, bars
+        { cv::BLIT_FILL, cv::Size(200, 100), 6 },    // panels
+        { cv::BLIT_FILL, cv::Size(800, 2), 10 },     // separators
+        { cv::BLIT_COPY, cv::Size(8, 16), 300 },     // glyphs
+        { cv::BLIT_COPY, cv::Size(32, 32), 24 },     // icons
+        { cv::BLIT_COPY, cv::Size(160, 96), 4 },     // cached widgets
+        { cv::BLIT_CONVERT, cv::Size(160, 120), 1 }, // RGB332 camera image
+        { cv::BLIT_CONVERT, cv::Size(8, 8), 40 },    // RGB332 thumbnails
+        { cv::BLIT_BLEND, cv::Size(48, 48), 8 },     // translucent overlays
+        { cv::BLIT_BLEND, cv::Size(10, 10), 40 },    // cursor, badges
+        { cv::BLIT_EXPAND, cv::Size(64, 64), 6 },    // palette sprites
+        { cv::BLIT_EXPAND, cv::Size(12, 12), 30 },   // palette icons
+    };
+
+    // opaque grays
+    uint32_t palette[256];
+
+    // modeled cycles of the frame, each block on dma2d if it accepts it
+    double frame_cycles(cv::Blitter& dma2d, const cv::Mat& screen, const cv::Mat& rgb332, const cv::Mat& argb8888)
+    {
+        const double start = modeled_cycles();
+        for (const Block& block : frame_blocks)
+        {
+            const cv::Rect rect(cv::Point(0, 0), block.size);
+            const cv::Mat dst = screen(rect);
+            const bool indexed = block.op == cv::BLIT_CONVERT || block.op == cv::BLIT_EXPAND;
+            const cv::Mat src = indexed ? rgb332(rect) : block.op == cv::BLIT_BLEND ? argb8888(rect) : screen(cv::Rect(cv::Point(0, 240), block.size));
+            cv::Blitter& blitter = dma2d.accepts(block.op, src, dst) ? dma2d : static_cast<cv::Blitter&>(modeled_cpu);
+            for (int i = 0; i < block.count; i++)
+            {
+                switch (block.op)
+                {
+                case cv::BLIT_FILL:
+                    blitter.fill(dst, cv::RGB565_BLUE);
+                    break;
+                case cv::BLIT_COPY:
+                    blitter.copy(src, dst);
+                    break;
+                case cv::BLIT_CONVERT:
+                    blitter.convert(src, cv::COLOR_RGB332, dst, cv::COLOR_RGB565);
+                    break;
+                case cv::BLIT_EXPAND:
+                    blitter.expand(src, dst, palette);
+                    break;
+                default:
+                    blitter.blend(src, dst, 255, 0);
+                    break;
+                }
+            }
+        }
+        return modeled_cycles() - start;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dma2d_emu::Dma2dTimingModel model;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--clock-mhz" && i + 1 < argc)
+        {
+            model.clock_hz = std::atof(argv[++i]) * 1e6;
+        }
+        else if (arg == "--bus-bytes-per-cycle" && i + 1 < argc)
+        {
+            model.bus_bytes_per_cycle = std::atof(argv[++i]);
+        }
+        else
+        {
+            std::printf("Usage: %s [--clock-mhz F] [--bus-bytes-per-cycle F]\n", argv[0]);
+            return 1;
+        }
+    }
+    dma2d_emu::set_timing_model(model);
+    const char* op_names[] = { "fill", "copy", "convert", "blend", "expand" };
+    bool ok = true;
+
+    cv::Blitter& dma2d = *cv::getDma2dBlitter();
+    size_t defaults[cv::BLIT_OPERATION_COUNT];
+    for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+    {
+        defaults[op] = dma2d.get_min_pixels(cv::BlitOperation(op));
+    }
+    const cv::BlitCalibration calibration = cv::calibrateBlitter(dma2d, cv::RGB565, [] { return uint32_t(modeled_cycles()); }, &modeled_cpu);
+
+    std::printf("DMA2D Blitter minimum pixels, RGB565, %.0f MHz, %.2f bus bytes per cycle\n", model.clock_hz / 1e6, model.bus_bytes_per_cycle);
+    std::printf("%-8s %10s %10s\n", "op", "default", "calibrated");
+    for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+    {
+        char calibrated[16] = "never";
+        if (calibration.min_pixels[op] != UINT32_MAX)
+        {
+            std::snprintf(calibrated, sizeof(calibrated), "%u", calibration.min_pixels[op]);
+        }
+        std::printf("%-8s %10zu %10s\n", op_names[op], defaults[op], calibrated);
+    }
+
+    // stored and applied at the next startup
+    uint8_t stored[sizeof(cv::BlitCalibration)];
+    std::memcpy(stored, &calibration, sizeof(stored));
+    cv::BlitCalibration loaded;
+    std::memcpy(&loaded, stored, sizeof(loaded));
+    cv::Dma2dBlitter restored;
+    bool applied = cv::applyBlitCalibration(restored, loaded);
+    for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+    {
+        applied &= restored.get_min_pixels(cv::BlitOperation(op)) == dma2d.get_min_pixels(cv::BlitOperation(op));
+    }
+    stored[sizeof(stored) / 2] ^= 0x10;
+    std::memcpy(&loaded, stored, sizeof(loaded));
+    cv::Dma2dBlitter untouched;
+    bool refused = !cv::applyBlitCalibration(untouched, loaded) && untouched.get_min_pixels(cv::BLIT_COPY) == defaults[cv::BLIT_COPY];
+    std::printf("\nstored calibration applied %s, corrupted one refused %s\n", applied ? "ok" : "NO", refused ? "ok" : "NO");
+    ok &= applied && refused;
+
+    cv::Mat screen(480, 800, cv::RGB565), rgb332(120, 160, cv::RGB332), argb8888(48, 48, cv::ARGB8888);
+    screen = cv::RGB565_BLACK;
+    rgb332 = 0x5A;
+    argb8888 = 0x80C08040u;
+    for (int i = 0; i < 256; i++)
+    {
+        palette[i] = 0xFF000000u | (uint32_t(i) * 0x010101u);
+    }
+    size_t calibrated[cv::BLIT_OPERATION_COUNT];
+    for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+    {
+        calibrated[op] = dma2d.get_min_pixels(cv::BlitOperation(op));
+    }
+    struct
+    {
+        const char* name;
+        const size_t* min_pixels;
+        size_t all;
+        double us;
+    } setups[] = {
+        { "all CPU", nullptr, SIZE_MAX, 0 },
+        { "all DMA2D", nullptr, 0, 0 },
+        { "default", defaults, 0, 0 },
+        { "calibrated", calibrated, 0, 0 },
+    };
+    std::printf("\n%-12s %10s\n", "selection", "frame us");
+    for (auto& setup : setups)
+    {
+        for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+        {
+            dma2d.set_min_pixels(cv::BlitOperation(op), setup.min_pixels != nullptr ? setup.min_pixels[op] : setup.all);
+        }
+        setup.us = frame_cycles(dma2d, screen, rgb332, argb8888) * 1e6 / model.clock_hz;
+        std::printf("%-12s %10.1f\n", setup.name, setup.us);
+    }
+    const double best_fixed = std::min(setups[0].us, setups[1].us);
+    const bool fastest = setups[3].us <= best_fixed && setups[3].us <= setups[2].us;
+    std::printf("calibrated %s\n", fastest ? "fastest: ok" : "slower than a fixed selection: NO");
+    ok &= fastest;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Times cv::cvtColor for every pair of color formats on a 320x240 frame,
+// next to the per-pixel loop an application would hand-roll, and checks that
+// both give the same pixels.
+//
+// Usage: bench_color [--min-time-ms N]
+
+#include "cvimgproc.h"
+#include "cvkernels.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    const int formats[] = { cv::COLOR_RGB332, cv::COLOR_RGB565, cv::COLOR_RGB565_SWAPPED, cv::COLOR_GRAY8, cv::COLOR_RGB888, cv::COLOR_ARGB8888 };
+
+    const char* format_name(int format)
+    {
+        switch (format)
+        {
+        case cv::COLOR_RGB332: return "RGB332";
+        case cv::COLOR_RGB565: return "RGB565";
+        case cv::COLOR_RGB565_SWAPPED: return "RGB565S";
+        case cv::COLOR_GRAY8: return "GRAY8";
+        case cv::COLOR_RGB888: return "RGB888";
+        case cv::COLOR_ARGB8888: return "ARGB8888";
+        }
+        return "?";
+    }
+
+    uint32_t expand(uint32_t v, int bits)
+    {
+        uint32_t result = 0;
+        for (int shift = 8 - bits; shift > -bits; shift -= bits)
+        {
+            result |= shift >= 0 ? v << shift : v >> -shift;
+        }
+        return result & 0xFF;
+    }
+
+    // the straightforward per-pixel conversion, through ARGB8888
+    uint32_t read_argb(const cv::Mat& m, int format, int y, int x)
+    {
+        switch (format)
+        {
+        case cv::COLOR_RGB332:
+        {
+            uint8_t v = m.at<uint8_t>(y, x);
+            return 0xFF000000u | expand(v >> 5, 3) << 16 | expand((v >> 2) & 7, 3) << 8 | expand(v & 3, 2);
+        }
+        case cv::COLOR_RGB565:
+        case cv::COLOR_RGB565_SWAPPED:
+        {
+            uint16_t v = m.at<uint16_t>(y, x);
+            if (format == cv::COLOR_RGB565_SWAPPED)
+            {
+                v = cv::swap_bytes(v);
+            }
+            return 0xFF000000u | expand(v >> 11, 5) << 16 | expand((v >> 5) & 0x3F, 6) << 8 | expand(v & 0x1F, 5);
+        }
+        case cv::COLOR_GRAY8:
+            return 0xFF000000u | m.at<uint8_t>(y, x) * 0x010101u;
+        case cv::COLOR_RGB888:
+        {
+            const cv::rgb888_t& v = m.at<cv::rgb888_t>(y, x);
+            return 0xFF000000u | uint32_t(v.r) << 16 | uint32_t(v.g) << 8 | v.b;
+        }
+        }
+        return m.at<uint32_t>(y, x);
+    }
+
+    void write_argb(cv::Mat& m, int format, int y, int x, uint32_t c)
+    {
+        uint32_t r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
+        switch (format)
+        {
+        case cv::COLOR_RGB332:
+            m.at<uint8_t>(y, x) = uint8_t((r >> 5) << 5 | (g >> 5) << 2 | b >> 6);
+            break;
+        case cv::COLOR_RGB565:
+            m.at<uint16_t>(y, x) = uint16_t((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+            break;
+        case cv::COLOR_RGB565_SWAPPED:
+            m.at<uint16_t>(y, x) = cv::swap_bytes(uint16_t((r >> 3) << 11 | (g >> 2) << 5 | b >> 3));
+            break;
+        case cv::COLOR_GRAY8:
+            m.at<uint8_t>(y, x) = uint8_t((r * 77 + g * 150 + b * 29 + 128) >> 8);
+            break;
+        case cv::COLOR_RGB888:
+            m.at<cv::rgb888_t>(y, x) = cv::rgb888_t{ uint8_t(b), uint8_t(g), uint8_t(r) };
+            break;
+        case cv::COLOR_ARGB8888:
+            m.at<uint32_t>(y, x) = c;
+            break;
+        }
+    }
+
+    void reference_convert(const cv::Mat& src, cv::Mat& dst, int src_format, int dst_format)
+    {
+        for (int y = 0; y < src.rows; y++)
+        {
+            for (int x = 0; x < src.cols; x++)
+            {
+                write_argb(dst, dst_format, y, x, read_argb(src, src_format, y, x));
+            }
+        }
+    }
+
+    double ns_per_pixel(const std::function<void()>& run, size_t pixels, double min_seconds)
+    {
+        size_t calls = 0;
+        size_t batch = 1;
+        double elapsed = 0.0;
+        auto start = bench_clock::now();
+        while (elapsed < min_seconds)
+        {
+            for (size_t i = 0; i < batch; i++)
+            {
+                run();
+            }
+            calls += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        }
+        return elapsed * 1e9 / (double(calls) * pixels);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double min_seconds = 0.05;
+    if (argc == 3 && std::string_view(argv[1]) == "--min-time-ms")
+    {
+        min_seconds = std::atof(argv[2]) / 1000.0;
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--min-time-ms N]\n", argv[0]);
+        return 1;
+    }
+
+    const cv::Size size(320, 240);
+    std::printf("cvtColor %dx%d, span kernels: %s\n", size.width, size.height, cv::span_kernels_isa());
+    std::printf("%-20s %14s %14s %s\n", "case", "cvtColor ns/px", "per-pixel ns/px", "output");
+    for (int src_format : formats)
+    {
+        cv::Mat src(size, cv::colorFormatType(src_format));
+        for (int y = 0; y < src.rows; y++)
+        {
+            uint8_t* row = src.ptr<uint8_t>(y);
+            for (size_t i = 0; i < size.width * src.elemSize(); i++)
+            {
+                row[i] = uint8_t(i * 29 + y * 7 + 3);
+            }
+        }
+        for (int dst_format : formats)
+        {
+            if (dst_format == src_format)
+            {
+                continue;
+            }
+            cv::Mat dst(size, cv::colorFormatType(dst_format));
+            cv::Mat expected(size, cv::colorFormatType(dst_format));
+            cv::cvtColor(src, dst, src_format, dst_format);
+            reference_convert(src, expected, src_format, dst_format);
+            bool same = true;
+            for (int y = 0; y < size.height; y++)
+            {
+                same = same && memcmp(dst.ptr<uint8_t>(y), expected.ptr<uint8_t>(y), size.width * dst.elemSize()) == 0;
+            }
+            const size_t pixels = size.area();
+            double converted = ns_per_pixel([&]() { cv::cvtColor(src, dst, src_format, dst_format); }, pixels, min_seconds);
+            double hand_rolled = ns_per_pixel([&]() { reference_convert(src, expected, src_format, dst_format); }, pixels, min_seconds);
+            std::string name = std::string(format_name(src_format)) + " > " + format_name(dst_format);
+            std::printf("%-20s %14.2f %14.2f %s\n", name.c_str(), converted, hand_rolled, same ? "ok" : "MISMATCH");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Measures Mat::copyTo throughput in MB/s for continuous, strided and
+// overlapping (scrolling) copies, next to a plain per-row std::copy_n loop.
+// The result of every copyTo case is checked against that loop, done through
+// a temporary copy where source and destination overlap.
+//
+// Usage: bench_copy [--min-time-ms N]
+
+#include "cvcore.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    struct CopyCase
+    {
+        std::string name;
+        cv::Mat src;
+        cv::Mat dst;
+    };
+
+    // the per-row loop copyTo used to run, with the row index fixed; it
+    // corrupts overlapping copies and is timed there for reference only
+    void row_loop_copy(const cv::Mat& src, cv::Mat dst)
+    {
+        size_t row_size = std::min(src.cols, dst.cols) * src.elemSize();
+        for (int y = 0; y < std::min(src.rows, dst.rows); y++)
+        {
+            std::copy_n(src.ptr<uint8_t>(y), row_size, dst.ptr<uint8_t>(y));
+        }
+    }
+
+    double megabytes_per_second(const std::function<void()>& run, size_t bytes, double min_seconds)
+    {
+        size_t calls = 0;
+        size_t batch = 1;
+        double elapsed = 0.0;
+        auto start = bench_clock::now();
+        while (elapsed < min_seconds)
+        {
+            for (size_t i = 0; i < batch; i++)
+            {
+                run();
+            }
+            calls += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        }
+        return double(bytes) * calls / elapsed / 1e6;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double min_seconds = 0.1;
+    if (argc == 3 && std::string_view(argv[1]) == "--min-time-ms")
+    {
+        min_seconds = std::atof(argv[2]) / 1000.0;
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--min-time-ms N]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-36s %12s %14s %14s %s\n", "case", "bytes", "copyTo MB/s", "row loop MB/s", "output");
+    const cv::Size frame_sizes[] = { cv::Size(320, 240), cv::Size(800, 480) };
+    for (const cv::Size& size : frame_sizes)
+    {
+        std::vector<uint8_t> buffer(size.area() * 2 * 2);
+        for (size_t i = 0; i < buffer.size(); i++)
+        {
+            buffer[i] = uint8_t(i * 7 + 1);
+        }
+        const std::vector<uint8_t> initial(buffer);
+        cv::Mat front(size, cv::RGB565, buffer.data());
+        cv::Mat back(size, cv::RGB565, buffer.data() + size.area() * 2);
+        const int w = size.width, h = size.height;
+        const std::string suffix = " " + std::to_string(w) + "x" + std::to_string(h);
+        const CopyCase cases[] = {
+            { "continuous" + suffix, front, back },
+            { "strided 3/4 ROI" + suffix, front(cv::Rect(w / 8, h / 8, w * 3 / 4, h * 3 / 4)), back(cv::Rect(w / 16, h / 16, w * 3 / 4, h * 3 / 4)) },
+            { "scroll up 8 rows" + suffix, front(cv::Rect(0, 8, w, h - 8)), front(cv::Rect(0, 0, w, h - 8)) },
+            { "scroll down 8 rows" + suffix, front(cv::Rect(0, 0, w, h - 8)), front(cv::Rect(0, 8, w, h - 8)) },
+            { "scroll left 8 cols" + suffix, front(cv::Rect(8, 0, w - 8, h)), front(cv::Rect(0, 0, w - 8, h)) },
+            { "scroll right 8 cols" + suffix, front(cv::Rect(0, 0, w - 8, h)), front(cv::Rect(8, 0, w - 8, h)) },
+        };
+        for (const CopyCase& copy_case : cases)
+        {
+            size_t bytes = size_t(copy_case.src.rows) * copy_case.src.cols * copy_case.src.elemSize();
+            buffer = initial;
+            copy_case.src.copyTo(copy_case.dst);
+            std::vector<uint8_t> copied(buffer);
+            buffer = initial;
+            cv::Mat src = copy_case.src.clone();
+            row_loop_copy(src, copy_case.dst);
+            bool same = copied == buffer;
+
+            double copy_to = megabytes_per_second([&]() { copy_case.src.copyTo(copy_case.dst); }, bytes, min_seconds);
+            double row_loop = megabytes_per_second([&]() { row_loop_copy(copy_case.src, copy_case.dst); }, bytes, min_seconds);
+            std::printf("%-36s %12zu %14.0f %14.0f %s\n", copy_case.name.c_str(), bytes, copy_to, row_loop, same ? "ok" : "MISMATCH");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Records layered 800x480 RGB565 screens (background, opaque panels and
+// content, dialogs and images on top), culls the commands later opaque fills
+// and bitmaps cover, and reports the culled commands, the overdraw saved as
+// pixels and as frames of 800x480, and the replay time with and without
+// culling. Both replays must give the same frame.
+//
+// Usage: bench_cull [--repeat N]
+
+#include "cvrender.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    struct Screen
+    {
+        const char* name;
+        std::function<void(cv::Painter&)> draw;
+    };
+
+    void panel(cv::Painter& painter, cv::FontBase& font, cv::Rect rc, const char* title, int value)
+    {
+        cv::Point center(rc.x + rc.width / 2, rc.y + rc.height / 2 + 10);
+        int radius = std::min(rc.width, rc.height) / 3;
+        painter.rectangle(rc.tl(), rc.br(), cv::RGB565_BLUE, cv::FILLED);
+        painter.rectangle(rc.tl(), rc.br(), cv::RGB565_WHITE, 2);
+        painter.putText(title, rc.tl() + cv::Point(8, 8), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        painter.circle(center, radius, cv::RGB565_CYAN, 4);
+        painter.ellipse(center, cv::Size(radius - 10, radius - 10), 0, 135, 135 + value * 27 / 10, cv::RGB565_GREEN, 8);
+        painter.line(center, center + cv::Point(radius / 2, -radius / 2), cv::RGB565_RED, 3);
+    }
+
+    void background(cv::Painter& painter)
+    {
+        painter.fill(cv::RGB565_BLACK);
+        for (int y = 0; y < 480; y += 40)
+        {
+            painter.rectangle(cv::Point(0, y), cv::Point(799, y + 19), 0x2104, cv::FILLED);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 50;
+    if (argc == 3 && std::string_view(argv[1]) == "--repeat")
+    {
+        repeat = std::max(1, std::atoi(argv[2]));
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--repeat N]\n", argv[0]);
+        return 1;
+    }
+
+    const cv::Size frame_size(800, 480);
+    cv::ASCIIFont font(_default_ascii_font);
+    cv::Mat image(frame_size, cv::RGB565), icon(64, 64, cv::RGB565);
+    for (int y = 0; y < image.rows; y++)
+    {
+        for (int x = 0; x < image.cols; x++)
+        {
+            image.at<uint16_t>(y, x) = uint16_t((x / 8) << 11 | (y / 8) << 5 | (x + y) / 50);
+        }
+    }
+    image(cv::Rect(0, 0, 64, 64)).copyTo(icon);
+
+    auto panels = [&](cv::Painter& p) {
+        background(p);
+        panel(p, font, cv::Rect(10, 10, 250, 220), "Pressure", 40);
+        panel(p, font, cv::Rect(275, 10, 250, 220), "Flow", 65);
+        panel(p, font, cv::Rect(540, 10, 250, 220), "Temperature", 80);
+        panel(p, font, cv::Rect(10, 245, 780, 225), "Trend", 55);
+    };
+    const Screen screens[] = {
+        { "panels", panels },
+        { "dialog", [&](cv::Painter& p) {
+            panels(p);
+            p.rectangle(cv::Point(150, 90), cv::Point(650, 390), cv::RGB565_WHITE, cv::FILLED);
+            p.drawBitmap(icon, cv::Point(170, 110));
+            p.putText("Filter change required", cv::Point(250, 130), font, cv::RGB565_BLACK, cv::RGB565_WHITE);
+            p.rectangle(cv::Point(520, 330), cv::Point(630, 370), cv::RGB565_BLUE, cv::FILLED);
+            p.putText("OK", cv::Point(566, 344), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        } },
+        { "panel zoom", [&](cv::Painter& p) {
+            panels(p);
+            panel(p, font, cv::Rect(0, 0, 800, 480), "Pressure", 40);
+        } },
+        { "image viewer", [&](cv::Painter& p) {
+            panels(p);
+            p.drawBitmap(image, cv::Point(0, 0));
+            p.rectangle(cv::Point(0, 440), cv::Point(799, 479), cv::RGB565_BLACK, cv::FILLED);
+            p.putText("image 3 / 12", cv::Point(350, 452), font, cv::RGB565_WHITE, cv::RGB565_BLACK);
+        } },
+    };
+
+    std::printf("%-14s %8s %8s %12s %8s %10s %10s %8s %s\n", "screen", "commands", "culled", "saved px", "frames", "replay ms",
+        "culled ms", "speedup", "output");
+    for (const Screen& screen : screens)
+    {
+        cv::DisplayList list(frame_size, cv::RGB565), culled_list(frame_size, cv::RGB565);
+        cv::Painter recorder(list), culled_recorder(culled_list);
+        screen.draw(recorder);
+        screen.draw(culled_recorder);
+        int culled = culled_list.cull();
+
+        cv::Mat frame(frame_size, cv::RGB565), culled_frame(frame_size, cv::RGB565);
+        cv::Painter painter(frame), culled_painter(culled_frame);
+        list.replay(painter);
+        culled_list.replay(culled_painter);
+        auto start = bench_clock::now();
+        for (int i = 0; i < repeat; i++)
+        {
+            list.replay(painter);
+        }
+        double replay_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+        start = bench_clock::now();
+        for (int i = 0; i < repeat; i++)
+        {
+            culled_list.replay(culled_painter);
+        }
+        double culled_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+        bool same = memcmp(frame.data, culled_frame.data, frame.total() * 2) == 0;
+
+        std::printf("%-14s %8d %8d %12d %8.2f %10.3f %10.3f %7.2fx %s\n", screen.name, list.size(), culled,
+            culled_list.get_culled_area(), double(culled_list.get_culled_area()) / frame_size.area(), replay_ms, culled_ms,
+            replay_ms / culled_ms, same ? "ok" : "MISMATCH");
+    }
+    return 0;
+}
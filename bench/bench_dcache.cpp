@@ -0,0 +1,107 @@
+// D-cache maintenance of DMA2D transfers typical of an 800x480 RGB565 screen,
+// on the software model of the DMA2D, which counts the maintenance calls and
+// the lines they go through and checks every transfer against them: each
+// line the DMA2D reads or writes must have been cleaned before, each line it
+// writes invalidated by the time its interrupt handler returns.
+//
+// Next to the lines the driver maintains are those of one span from the
+// first to the last byte of every area it reads, the way the sources used to
+// be cleaned (without invalidating the output). A transfer within memory
+// marked non-cacheable must not maintain any line. The CPU also writes the
+// pixels beside a queued 780x8 copy before its interrupt, which must keep
+// them.
+//
+// Usage: bench_dcache
+
+#include "cvimgproc.h"
+
+namespace
+{
+    // 32-byte lines from the first to the last byte of the mat
+    uint64_t span_lines(const cv::Mat& mat)
+    {
+        const uintptr_t start = reinterpret_cast<uintptr_t>(mat.ptr<uint8_t>(0));
+        const uintptr_t end = reinterpret_cast<uintptr_t>(mat.ptr<uint8_t>(mat.rows - 1)) + (mat.cols * mat.elemBits() + 7) / 8;
+        return (((end + 31) & ~uintptr_t(31)) - (start & ~uintptr_t(31))) / 32;
+    }
+
+    struct Case
+    {
+        const char* name;
+        uint64_t span_lines;
+        std::function<void()> transfer;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        std::printf("Usage: %s\n", argv[0]);
+        return 1;
+    }
+    const dma2d_emu::Dma2dTimingModel& model = dma2d_emu::timing_model();
+    cv::Mat frame(480, 800, cv::RGB565), back(480, 800, cv::RGB565), uncached(480, 800, cv::RGB565);
+    cv::Mat camera(272, 480, cv::RGB332), mask(16, 8, cv::A8);
+    frame = cv::RGB565_BLUE;
+    back = cv::RGB565_WHITE;
+    camera = 0x5A;
+    mask = 0x80;
+    // as the MPU would map it
+    dma2d_emu::set_non_cacheable(uncached.data, uncached.total() * uncached.elemSize());
+    if (!dma2d_set_non_cacheable(uncached.data, uncached.total() * uncached.elemSize()))
+    {
+        std::printf("non-cacheable region refused\n");
+        return 1;
+    }
+
+    const cv::Rect icon(100, 100, 64, 64), band(0, 200, 800, 40), glyph(300, 50, 8, 16), strip(10, 400, 780, 8);
+    const Case cases[] = {
+        { "64x64 copy", span_lines(back(icon)), [&] { dma2d_copy(back, icon, frame, cv::Point(400, 300)); } },
+        { "800x40 band copy", span_lines(back(band)), [&] { dma2d_copy(back, band, frame, cv::Point(0, 40)); } },
+        { "800x480 fill", 0, [&] { dma2d_fill(frame, cv::RGB565_BLACK); } },
+        { "480x272 RGB332", span_lines(camera), [&] { dma2d_convert(camera, cv::Rect(0, 0, 480, 272), frame, cv::Point(0, 0), RGB332toRGB888LUT); } },
+        { "8x16 glyph blend", span_lines(mask) + span_lines(frame(glyph)), [&] { dma2d_blend(mask, cv::Rect(0, 0, 8, 16), frame, glyph.tl(), 255, 0xFFFFFF); } },
+        { "non-cacheable", 0, [&] { dma2d_copy(uncached, icon, uncached, cv::Point(400, 300)); } },
+        { "780x8 beside CPU", span_lines(back(strip)), [&] {
+            // the interrupt waits for the critical section, the copy is
+            // still queued while the CPU writes
+            core_util_critical_section_enter();
+            dma2d_submit_copy(back, strip, frame, strip.tl());
+            for (int y = strip.y; y < strip.y + strip.height; y++)
+            {
+                uint16_t* row = frame.ptr<uint16_t>(y);
+                const int xs[] = { 0, strip.x + strip.width };
+                for (int x : xs)
+                {
+                    const int width = x == 0 ? strip.x : frame.cols - x;
+                    std::fill(row + x, row + x + width, cv::RGB565_RED);
+                    dma2d_emu::cpu_write(row + x, width * 2);
+                }
+            }
+            core_util_critical_section_exit();
+        } },
+    };
+
+    bool ok = true;
+    std::printf("%-18s %10s %8s %8s %10s %10s %8s %8s %s\n", "transfer", "span lines", "calls", "lines", "maint us", "uncleaned", "stale", "lost",
+        "output");
+    for (const Case& test : cases)
+    {
+        dma2d_emu::reset_stats();
+        test.transfer();
+        dma2d_wait();
+        dma2d_emu::wait_idle();
+        const dma2d_emu::Dma2dStats& stats = dma2d_emu::stats();
+        bool good = stats.uncleaned_lines == 0 && stats.stale_lines == 0 && stats.lost_lines == 0;
+        if (&test == &cases[5])
+        {
+            good &= stats.cache_calls == 0;
+        }
+        ok &= good;
+        std::printf("%-18s %10llu %8u %8llu %10.2f %10llu %8llu %8llu %s\n", test.name, (unsigned long long)test.span_lines, stats.cache_calls,
+            (unsigned long long)stats.cache_lines, stats.cache_us(model), (unsigned long long)stats.uncleaned_lines,
+            (unsigned long long)stats.stale_lines, (unsigned long long)stats.lost_lines, good ? "ok" : "NOT MAINTAINED");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// Counts the bytes a 320x240 RGB565 dashboard sends to an SPI panel per
+// update, flushing the bounding dirty rect versus the multi-rect dirty
+// region, for a few typical updates and region merge thresholds. Every
+// pixel that changed must lie inside the flushed rects, which is checked
+// against the previous frame.
+//
+// Usage: bench_dirty
+
+#include "cvimgproc.h"
+#include "cvdisplay.h"
+#include "mock_display_sink.h"
+#include <functional>
+
+namespace
+{
+    struct Dashboard
+    {
+        cv::ASCIIFont font { _default_ascii_font };
+        int speed = 42;
+        int minutes = 12 * 60 + 5;
+        int needle_angle = 30;
+        bool icons = false;
+
+        void clock(cv::Painter& painter)
+        {
+            char text[8];
+            std::snprintf(text, sizeof(text), "%02d:%02d", minutes / 60 % 24, minutes % 60);
+            painter.putText(text, cv::Point(262, 4), font, cv::RGB565_WHITE, cv::RGB565_BLACK);
+        }
+
+        void speed_text(cv::Painter& painter)
+        {
+            // room for any int
+            char text[24];
+            std::snprintf(text, sizeof(text), "%3d km/h", speed);
+            painter.putText(text, cv::Point(4, 4), font, cv::RGB565_WHITE, cv::RGB565_BLACK);
+        }
+
+        void needle(cv::Painter& painter, uint16_t color)
+        {
+            double radians = needle_angle * CV_PI / 180;
+            cv::Point center(160, 150);
+            cv::Point tip(center.x + int(std::cos(radians) * 70), center.y - int(std::sin(radians) * 70));
+            painter.line(center, tip, color, 3);
+        }
+
+        void status_icons(cv::Painter& painter)
+        {
+            uint16_t color = icons ? cv::RGB565_YELLOW : cv::RGB565_BLACK;
+            painter.circle(cv::Point(12, 227), 8, color, cv::FILLED);
+            painter.rectangle(cv::Point(298, 218), cv::Point(314, 234), color, cv::FILLED);
+            painter.drawMarker(cv::Point(12, 40), color, cv::MARKER_TRIANGLE_UP, 14, 2);
+            painter.drawMarker(cv::Point(306, 40), color, cv::MARKER_STAR, 14, 1);
+        }
+
+        void full(cv::Painter& painter)
+        {
+            painter.fill(cv::RGB565_BLACK);
+            painter.circle(cv::Point(160, 150), 80, cv::RGB565_BLUE, 2);
+            clock(painter);
+            speed_text(painter);
+            needle(painter, cv::RGB565_RED);
+            status_icons(painter);
+        }
+    };
+
+    struct Workload
+    {
+        const char* name;
+        std::function<void(Dashboard&, cv::Painter&)> update;
+    };
+
+    // pixels of after that differ from before lie inside the region
+    bool region_covers_changes(const cv::Mat& before, const cv::Mat& after, const cv::DirtyRegion& region)
+    {
+        for (int y = 0; y < after.rows; y++)
+        {
+            for (int x = 0; x < after.cols; x++)
+            {
+                if (before.at<uint16_t>(y, x) == after.at<uint16_t>(y, x))
+                {
+                    continue;
+                }
+                bool covered = false;
+                for (const cv::Rect& rect : region)
+                {
+                    covered = covered || rect.contains(cv::Point(x, y));
+                }
+                if (!covered)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        std::printf("Usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    const Workload workloads[] = {
+        { "clock tick", [](Dashboard& d, cv::Painter& p) { d.minutes++; d.clock(p); } },
+        { "speed + needle", [](Dashboard& d, cv::Painter& p) {
+            d.needle(p, cv::RGB565_BLACK);
+            d.speed++;
+            d.needle_angle += 4;
+            d.speed_text(p);
+            d.needle(p, cv::RGB565_RED);
+        } },
+        { "status icons", [](Dashboard& d, cv::Painter& p) { d.icons = !d.icons; d.status_icons(p); } },
+        { "clock + speed", [](Dashboard& d, cv::Painter& p) { d.minutes++; d.clock(p); d.speed--; d.speed_text(p); } },
+        { "everything", [](Dashboard& d, cv::Painter& p) {
+            d.minutes++;
+            d.clock(p);
+            d.speed++;
+            d.speed_text(p);
+            d.needle(p, cv::RGB565_BLACK);
+            d.needle_angle -= 6;
+            d.needle(p, cv::RGB565_RED);
+            d.icons = !d.icons;
+            d.status_icons(p);
+        } },
+        { "full redraw", [](Dashboard& d, cv::Painter& p) { d.full(p); } },
+    };
+    const int merge_percents[] = { 0, 25, 100 };
+    // 40 MHz SPI clock
+    const double spi_bytes_per_second = 5e6;
+
+    std::vector<uint8_t> buffers(4096 * 2);
+    MockDisplaySink sink(0);
+    cv::FlushStage stage(sink, buffers.data(), buffers.data() + 4096, 4096);
+
+    std::printf("%-16s %6s %10s %10s %6s %8s %8s %7s %s\n", "update", "merge%", "bound B", "region B", "rects",
+        "bound ms", "region ms", "saved", "output");
+    for (int merge_percent : merge_percents)
+    {
+        size_t bound_total = 0, region_total = 0;
+        cv::Mat frame(240, 320, cv::RGB565);
+        cv::Painter painter(frame);
+        painter.set_dirty_merge_percent(merge_percent);
+        Dashboard dashboard;
+        dashboard.full(painter);
+        painter.reset_dirty_rect();
+        for (const Workload& workload : workloads)
+        {
+            cv::Mat before = frame.clone();
+            workload.update(dashboard, painter);
+
+            size_t bound_bytes = painter.get_dirty_rect().area() * 2;
+            int rects = painter.get_dirty_region().size();
+            bool ok = region_covers_changes(before, frame, painter.get_dirty_region());
+            sink.reset();
+            stage.flush(painter);
+            size_t region_bytes = sink.total_bytes();
+            ok = ok && sink.windows() == size_t(rects) && region_bytes <= bound_bytes;
+            bound_total += bound_bytes;
+            region_total += region_bytes;
+            std::printf("%-16s %6d %10zu %10zu %6d %8.2f %8.2f %6.1f%% %s\n", workload.name, merge_percent, bound_bytes, region_bytes,
+                rects, bound_bytes / spi_bytes_per_second * 1e3, region_bytes / spi_bytes_per_second * 1e3,
+                bound_bytes > 0 ? 100.0 * (bound_bytes - region_bytes) / bound_bytes : 0.0, ok ? "ok" : "MISMATCH");
+        }
+        std::printf("%-16s %6d %10zu %10zu %6s %8.2f %8.2f %6.1f%%\n\n", "total", merge_percent, bound_total, region_total, "",
+            bound_total / spi_bytes_per_second * 1e3, region_total / spi_bytes_per_second * 1e3,
+            100.0 * (bound_total - region_total) / bound_total);
+    }
+    return 0;
+}
@@ -0,0 +1,333 @@
+// Estimates what the DMA2D paths of Painter save over the CPU fallbacks.
+//
+// Links against the library built with the DMA2D software model. Each case is
+// run once; the model reports the estimated peripheral time of the transfers it
+// executed and the estimated time of the equivalent CPU code. The output of
+// every case is also checked against a plain CPU reference. Then transfers
+// through the same and through alternating CLUTs are counted, to check that a
+// resident CLUT is not loaded again, and that one changed in place is.
+//
+// Usage: bench_dma2d [--clock-mhz F] [--bus-bytes-per-cycle F] [--setup-cycles F]
+
+#include "cvimgproc.h"
+#include <functional>
+#include <memory>
+
+namespace
+{
+    struct BenchCase
+    {
+        std::string name;
+        std::function<void()> run;
+        std::function<bool()> check;
+    };
+
+    void report(const BenchCase& bench_case)
+    {
+        dma2d_emu::reset_stats();
+        bench_case.run();
+        const dma2d_emu::Dma2dStats& stats = dma2d_emu::stats();
+        const dma2d_emu::Dma2dTimingModel& model = dma2d_emu::timing_model();
+        double dma2d_us = stats.dma2d_us(model);
+        double cpu_us = stats.cpu_us(model);
+        std::printf("%-34s %9u %10llu %12.2f %12.2f %8.1f%% %s\n", bench_case.name.c_str(), stats.transfers,
+            (unsigned long long)stats.pixels, dma2d_us, cpu_us, cpu_us > 0 ? (cpu_us - dma2d_us) * 100.0 / cpu_us : 0.0,
+            bench_case.check() ? "ok" : "MISMATCH");
+    }
+
+    const char* format_name(int type)
+    {
+        switch (type)
+        {
+        case cv::RGB565: return "RGB565";
+        case cv::RGB332: return "RGB332";
+        case cv::ARGB8888: return "ARGB8888";
+        case cv::RGB888: return "RGB888";
+        case cv::ARGB4444: return "ARGB4444";
+        case cv::A8: return "A8";
+        case cv::L4: return "L4";
+        }
+        return "?";
+    }
+
+    bool check_copy(const cv::Mat& src, const cv::Mat& dst)
+    {
+        for (int y = 0; y < src.rows; y++)
+        {
+            if (memcmp(src.ptr<uint8_t>(y), dst.ptr<uint8_t>(y), (src.cols * src.elemBits() + 7) / 8) != 0) return false;
+        }
+        return true;
+    }
+
+    // compare with a row filled by the CPU
+    bool check_fill(const cv::Mat& mat, uint32_t color)
+    {
+        cv::Mat reference(1, mat.cols, mat.type);
+        reference = color;
+        for (int y = 0; y < mat.rows; y++)
+        {
+            if (!check_copy(reference, mat.row(y))) return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    dma2d_emu::Dma2dTimingModel model;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--clock-mhz" && i + 1 < argc)
+        {
+            model.clock_hz = std::atof(argv[++i]) * 1e6;
+        }
+        else if (arg == "--bus-bytes-per-cycle" && i + 1 < argc)
+        {
+            model.bus_bytes_per_cycle = std::atof(argv[++i]);
+        }
+        else if (arg == "--setup-cycles" && i + 1 < argc)
+        {
+            model.setup_cycles = std::atof(argv[++i]);
+        }
+        else
+        {
+            std::printf("Usage: %s [--clock-mhz F] [--bus-bytes-per-cycle F] [--setup-cycles F]\n", argv[0]);
+            return 1;
+        }
+    }
+    dma2d_emu::set_timing_model(model);
+    // every case goes to the DMA2D, the defaults leave small blocks to the CPU
+    for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+    {
+        cv::getBlitter()->set_min_pixels(cv::BlitOperation(op), 0);
+    }
+
+    std::vector<uint8_t> frame_buffer(800 * 480 * 4);
+    std::vector<uint8_t> bitmap_buffer(128 * 128 * 4);
+    std::vector<uint8_t> flat_buffer(800 * 480 * 2);
+    for (size_t i = 0; i < bitmap_buffer.size(); i++)
+    {
+        bitmap_buffer[i] = uint8_t(i * 13 + 5);
+    }
+    // sprite palettes, entry 0 transparent
+    uint32_t palettes[2][256];
+    for (int i = 0; i < 256; i++)
+    {
+        palettes[0][i] = i == 0 ? 0 : 0xFF000000u | (uint32_t(i) * 0x00010203u);
+        palettes[1][i] = i == 0 ? 0 : 0x80000000u | (uint32_t(255 - i) * 0x00030201u);
+    }
+
+    std::vector<BenchCase> cases;
+    const int types[] = { cv::RGB565, cv::RGB332, cv::ARGB8888, cv::RGB888, cv::ARGB4444, cv::A8, cv::L4 };
+    const uint32_t colors[] = { cv::RGB565_CYAN, cv::RGB332_CYAN, cv::ARGB8888_CYAN, cv::RGB888_CYAN, cv::ARGB4444_CYAN, 0xC0, 0x9 };
+    for (size_t type_index = 0; type_index < sizeof(types) / sizeof(types[0]); type_index++)
+    {
+        const int type = types[type_index];
+        const uint32_t color = colors[type_index];
+        const char* type_name = format_name(type);
+        const cv::Size frame_sizes[] = { cv::Size(320, 240), cv::Size(800, 480) };
+        for (const cv::Size& size : frame_sizes)
+        {
+            cv::Mat frame(size, type, frame_buffer.data());
+            cases.push_back({ std::string("fill ") + type_name + " " + std::to_string(size.width) + "x" + std::to_string(size.height),
+                [=]() { cv::Painter(frame).fill(color); },
+                [=]() { return check_fill(frame, color); } });
+        }
+        cv::Mat frame(480, 800, type, frame_buffer.data());
+        const int rect_sizes[] = { 4, 16, 64, 200 };
+        for (int rect_size : rect_sizes)
+        {
+            if (type == cv::L4)
+            {
+                break; // Painter draws no shapes on L4
+            }
+            cv::Point pt1(50, 50), pt2(50 + rect_size, 50 + rect_size);
+            cases.push_back({ std::string("rectangle ") + type_name + " " + std::to_string(rect_size) + "x" + std::to_string(rect_size),
+                [=]() { cv::Painter(frame).rectangle(pt1, pt2, color, cv::FILLED); },
+                [=]() { return check_fill(frame(cv::Rect(pt1, pt2)), color); } });
+        }
+        const int bitmap_sizes[] = { 8, 32, 64, 128 };
+        for (int bitmap_size : bitmap_sizes)
+        {
+            cv::Mat bitmap(bitmap_size, bitmap_size, type, bitmap_buffer.data());
+            cv::Point org(100, 60);
+            cases.push_back({ std::string("drawBitmap ") + type_name + " " + std::to_string(bitmap_size) + "x" + std::to_string(bitmap_size),
+                [=]() { cv::Painter(frame).drawBitmap(bitmap, org); },
+                [=]() { return check_copy(bitmap, frame(cv::Rect(org, bitmap.size()))); } });
+        }
+        const int copy_sizes[] = { 16, 64, 200 };
+        for (int copy_size : copy_sizes)
+        {
+            cv::Mat src(copy_size, copy_size, type, bitmap_buffer.data() + bitmap_buffer.size() / 2);
+            cv::Mat dst = frame(cv::Rect(300, 100, copy_size, copy_size));
+            if (copy_size > 128)
+            {
+                src = frame(cv::Rect(0, 0, copy_size, copy_size));
+            }
+            cases.push_back({ std::string("copyTo ") + type_name + " " + std::to_string(copy_size) + "x" + std::to_string(copy_size),
+                [=]() { src.copyTo(dst); },
+                [=]() { return check_copy(src, dst); } });
+        }
+    }
+    {
+        cv::Mat frame(240, 320, cv::RGB332, frame_buffer.data());
+        cases.push_back({ "rgb332_to_rgb565 320x240",
+            [=, &flat_buffer]() { dma2d_flat_rgb332_to_rgb565(frame, cv::Rect(0, 0, 320, 240), flat_buffer.data()); },
+            [=, &flat_buffer]() {
+                const uint16_t* converted = reinterpret_cast<const uint16_t*>(flat_buffer.data());
+                for (int y = 0; y < frame.rows; y++)
+                    for (int x = 0; x < frame.cols; x++)
+                        if (converted[y * frame.cols + x] != cv::rgb332_to_rgb565(frame.at<uint8_t>(y, x))) return false;
+                return true;
+            } });
+    }
+    {
+        // translucent icons and masks over an RGB565 frame, against the CPU
+        // blend of the pixels they covered
+        const int sources[] = { cv::ARGB8888, cv::ARGB4444, cv::A8 };
+        const int blend_sizes[] = { 48, 128 };
+        const uint8_t alphas[] = { 255, 160 };
+        cv::Mat frame(480, 800, cv::RGB565, frame_buffer.data());
+        for (int source : sources)
+        {
+            for (int blend_size : blend_sizes)
+            {
+                for (uint8_t alpha : alphas)
+                {
+                    cv::Mat bitmap(blend_size, blend_size, source, bitmap_buffer.data());
+                    cv::Mat target = frame(cv::Rect(200, 100, blend_size, blend_size));
+                    auto covered = std::make_shared<cv::Mat>(target.size(), cv::RGB565);
+                    cases.push_back({ std::string("drawBitmap ") + format_name(source) + " " + std::to_string(blend_size) + "x" +
+                            std::to_string(blend_size) + " a" + std::to_string(alpha),
+                        [=]() {
+                            for (int y = 0; y < target.rows; y++)
+                            {
+                                memcpy(covered->ptr<uint8_t>(y), target.ptr<uint8_t>(y), target.cols * 2);
+                            }
+                            cv::Painter(frame).drawBitmap(bitmap, cv::Point(200, 100), alpha, cv::RGB565_YELLOW);
+                        },
+                        [=]() {
+                            cv::getCpuBlitter()->blend(bitmap, *covered, alpha, cv::RGB565_YELLOW);
+                            return check_copy(*covered, target);
+                        } });
+                }
+            }
+        }
+    }
+    {
+        // palette sprites expanded over an RGB565 frame, against the CPU
+        // expansion over the pixels they covered
+        const int sources[] = { cv::L4, cv::RGB332 };
+        cv::Mat frame(480, 800, cv::RGB565, frame_buffer.data());
+        for (int source : sources)
+        {
+            for (bool blend : { false, true })
+            {
+                cv::Mat bitmap(64, 64, source, bitmap_buffer.data());
+                cv::Mat target = frame(cv::Rect(200, 100, 64, 64));
+                auto covered = std::make_shared<cv::Mat>(target.size(), cv::RGB565);
+                const uint32_t* palette = palettes[blend];
+                cases.push_back({ std::string("drawBitmap ") + (source == cv::L4 ? "L4" : "L8") + " 64x64 palette" + (blend ? " blend" : ""),
+                    [=]() {
+                        for (int y = 0; y < target.rows; y++)
+                        {
+                            memcpy(covered->ptr<uint8_t>(y), target.ptr<uint8_t>(y), target.cols * 2);
+                        }
+                        cv::Painter(frame).drawBitmap(bitmap, cv::Point(200, 100), palette, blend);
+                    },
+                    [=]() {
+                        cv::getCpuBlitter()->expand(bitmap, *covered, palette, blend);
+                        return check_copy(*covered, target);
+                    } });
+            }
+        }
+    }
+    {
+        // pixel format conversions, against the CPU conversion of cvtColor
+        const int conversions[][2] = {
+            { cv::COLOR_RGB332, cv::COLOR_ARGB8888 }, { cv::COLOR_GRAY8, cv::COLOR_RGB565 }, { cv::COLOR_RGB565, cv::COLOR_RGB888 },
+            { cv::COLOR_RGB565, cv::COLOR_ARGB8888 }, { cv::COLOR_RGB888, cv::COLOR_RGB565 }, { cv::COLOR_ARGB8888, cv::COLOR_RGB565 },
+        };
+        const char* names[] = { "RGB332", "RGB565", "RGB565S", "GRAY8", "RGB888", "ARGB8888" };
+        for (auto& conversion : conversions)
+        {
+            const int src_format = conversion[0], dst_format = conversion[1];
+            cv::Mat src(128, 128, cv::colorFormatType(src_format), bitmap_buffer.data());
+            cv::Mat dst = cv::Mat(480, 800, cv::colorFormatType(dst_format), frame_buffer.data())(cv::Rect(100, 60, 128, 128));
+            cases.push_back({ std::string("cvtColor ") + names[src_format] + " > " + names[dst_format] + " 128x128",
+                [=]() mutable { cv::cvtColor(src, dst, src_format, dst_format); },
+                [=]() {
+                    cv::Mat expected(src.size(), cv::colorFormatType(dst_format));
+                    cv::getCpuBlitter()->convert(src, src_format, expected, dst_format);
+                    return check_copy(expected, dst);
+                } });
+        }
+    }
+
+    std::printf("DMA2D model: %.0f MHz, %.2f bus bytes/cycle, %.0f setup cycles\n", model.clock_hz / 1e6, model.bus_bytes_per_cycle, model.setup_cycles);
+    std::printf("%-34s %9s %10s %12s %12s %9s %s\n", "case", "transfers", "pixels", "dma2d us", "cpu us", "saved", "output");
+    for (auto& bench_case : cases)
+    {
+        report(bench_case);
+    }
+
+    struct ClutCase
+    {
+        const char* name;
+        std::function<void()> run;
+        uint32_t expected_loads;
+    };
+    cv::Mat rgb332_frame(240, 320, cv::RGB332, frame_buffer.data());
+    cv::Mat frame(480, 800, cv::RGB565, frame_buffer.data() + 320 * 240);
+    cv::Mat l8_sprite(32, 32, cv::RGB332, bitmap_buffer.data()), l4_sprite(32, 32, cv::L4, bitmap_buffer.data());
+    uint32_t tinted[256];
+    bool tinted_red = true;
+    const ClutCase clut_cases[] = {
+        { "rgb332_to_rgb565 320x240 x10", [&]() {
+            for (int i = 0; i < 10; i++)
+                dma2d_flat_rgb332_to_rgb565(rgb332_frame, cv::Rect(0, 0, 320, 240), flat_buffer.data());
+        }, 1 },
+        { "L8 sprites 32x32 x24, one palette", [&]() {
+            for (int i = 0; i < 24; i++)
+                cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(i * 32, 0), palettes[0], true);
+        }, 1 },
+        { "L4 sprites 32x32 x24, one palette", [&]() {
+            for (int i = 0; i < 24; i++)
+                cv::Painter(frame).drawBitmap(l4_sprite, cv::Point(i * 32, 40), palettes[0], true);
+        }, 1 },
+        { "L4 then L8 sprites, one palette", [&]() {
+            cv::Painter(frame).drawBitmap(l4_sprite, cv::Point(0, 80), palettes[0]);
+            cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(32, 80), palettes[0]);
+            cv::Painter(frame).drawBitmap(l4_sprite, cv::Point(64, 80), palettes[0]);
+        }, 2 },
+        { "L8 sprites 32x32 x24, two palettes", [&]() {
+            for (int i = 0; i < 24; i++)
+                cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(i * 32, 120), palettes[i & 1], true);
+        }, 24 },
+        { "L8 sprites, palette copied", [&]() {
+            std::copy(palettes[0], palettes[0] + 256, tinted);
+            cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(0, 160), palettes[0]);
+            cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(32, 160), tinted);
+        }, 1 },
+        { "L8 sprites, palette tinted", [&]() {
+            cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(0, 200), tinted);
+            std::fill(tinted, tinted + 256, 0xFFFF0000u);
+            cv::Painter(frame).drawBitmap(l8_sprite, cv::Point(32, 200), tinted);
+            tinted_red = frame.at<uint16_t>(200, 32) == cv::RGB565_RED;
+        }, 2 },
+    };
+    bool ok = true;
+    std::printf("\n%-34s %9s %10s %s\n", "CLUT residency", "transfers", "CLUT loads", "output");
+    for (const ClutCase& clut_case : clut_cases)
+    {
+        dma2d_invalidate_clut();
+        dma2d_emu::reset_stats();
+        clut_case.run();
+        const dma2d_emu::Dma2dStats& stats = dma2d_emu::stats();
+        const bool expected = stats.clut_loads == clut_case.expected_loads && tinted_red;
+        std::printf("%-34s %9u %10u %s\n", clut_case.name, stats.transfers, stats.clut_loads, expected ? "ok" : "UNEXPECTED");
+        ok &= expected;
+    }
+    return ok ? 0 : 1;
+}
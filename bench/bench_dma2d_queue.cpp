@@ -0,0 +1,255 @@
+// Checks and times the queued DMA2D API against the software model, whose
+// queued transfers run on a worker thread.
+//
+// The ordering check submits a few hundred fills and copies between
+// overlapping areas of two Mats, more than the queue holds, and polls the
+// fences while they complete: a done fence must never follow one that is not
+// done. The final pixels must match the same operations done on the CPU.
+//
+// The overlap case draws an 800x480 RGB565 screen as 25 panels, each drawn by
+// the CPU into one of two panel buffers and copied to the frame by the DMA2D,
+// once with the blocking dma2d_copy and once with dma2d_submit_copy, drawing
+// the next panel while the last one is copied. The model is paced, so the
+// transfers take their estimated time, and the wall time of both is reported.
+//
+// Usage: bench_dma2d_queue [--repeat N] [--clock-mhz F] [--bus-bytes-per-cycle F]
+
+#include "cvimgproc.h"
+#include <chrono>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    struct Operation
+    {
+        bool copy;
+        int src, dest;
+        cv::Rect rect;
+        cv::Point pos;
+        uint16_t color;
+    };
+
+    std::vector<Operation> random_operations(int count, cv::Size size)
+    {
+        std::vector<Operation> operations;
+        uint32_t seed = 4711;
+        auto next = [&seed](int range) {
+            seed = seed * 1664525u + 1013904223u;
+            return int((seed >> 8) % uint32_t(range));
+        };
+        for (int i = 0; i < count; i++)
+        {
+            Operation op;
+            op.copy = next(3) != 0;
+            op.src = next(2);
+            op.dest = next(2);
+            op.rect = cv::Rect(next(size.width / 2), next(size.height / 2), 8 + next(size.width / 2 - 8), 8 + next(size.height / 2 - 8));
+            op.pos = cv::Point(next(size.width - op.rect.width), next(size.height - op.rect.height));
+            if (op.copy && op.src == op.dest)
+            {
+                // the DMA2D copies rows first to last, keep the areas apart
+                op.dest = 1 - op.src;
+            }
+            op.color = uint16_t(next(0x10000));
+            operations.push_back(op);
+        }
+        return operations;
+    }
+
+    bool check_ordering(int count)
+    {
+        const cv::Size size(256, 128);
+        std::vector<Operation> operations = random_operations(count, size);
+        cv::Mat mats[2] = { cv::Mat(size, cv::RGB565), cv::Mat(size, cv::RGB565) };
+        cv::Mat expected[2] = { cv::Mat(size, cv::RGB565), cv::Mat(size, cv::RGB565) };
+        for (int i = 0; i < 2; i++)
+        {
+            mats[i] = cv::RGB565_BLACK;
+            expected[i] = cv::RGB565_BLACK;
+        }
+
+        std::vector<dma2d_fence_t> fences;
+        int polls = 0, out_of_order = 0;
+        auto poll = [&]() {
+            // done fences must be a prefix of the submitted ones; checked
+            // from the last, as transfers may complete meanwhile
+            bool done_seen = false;
+            for (auto fence = fences.rbegin(); fence != fences.rend(); ++fence)
+            {
+                bool done = dma2d_fence_done(*fence);
+                out_of_order += !done && done_seen;
+                done_seen |= done;
+            }
+            polls++;
+        };
+        for (const Operation& op : operations)
+        {
+            if (op.copy)
+            {
+                fences.push_back(dma2d_submit_copy(mats[op.src], op.rect, mats[op.dest], op.pos));
+            }
+            else
+            {
+                fences.push_back(dma2d_submit_fill(mats[op.dest](op.rect), op.color));
+            }
+            if (fences.size() % 8 == 0)
+            {
+                poll();
+            }
+        }
+        while (!dma2d_fence_done(fences.back()))
+        {
+            poll();
+        }
+        poll();
+
+        // the reference, after the queue drained: copyTo may use the DMA2D
+        for (const Operation& op : operations)
+        {
+            if (op.copy)
+            {
+                expected[op.src](op.rect).copyTo(expected[op.dest](cv::Rect(op.pos, op.rect.size())));
+            }
+            else
+            {
+                expected[op.dest](op.rect) = op.color;
+            }
+        }
+        bool increasing = true;
+        for (size_t i = 1; i < fences.size(); i++)
+        {
+            increasing &= int32_t(fences[i] - fences[i - 1]) > 0;
+        }
+        bool same = true;
+        for (int i = 0; i < 2; i++)
+        {
+            same &= memcmp(mats[i].data, expected[i].data, mats[i].total() * 2) == 0;
+        }
+        std::printf("%-24s %6d ops %6d polls  increasing %s  in order %s  pixels %s\n", "ordering", count, polls,
+            increasing ? "ok" : "NO", out_of_order == 0 ? "ok" : "NO", same ? "ok" : "MISMATCH");
+        return increasing && out_of_order == 0 && same;
+    }
+
+    void draw_panel(cv::Painter& painter, int index, cv::FontBase& font)
+    {
+        // no fill: Painter::fill and filled rectangles go to the DMA2D too,
+        // and would wait for the queued copies
+        cv::Mat mat = painter.get_mat();
+        mat = index % 2 ? cv::RGB565_BLACK : cv::RGB565_BLUE;
+        cv::Size size = painter.get_mat_size();
+        char text[32];
+        std::snprintf(text, sizeof(text), "Sensor %02d", index);
+        painter.putText(text, cv::Point(6, 6), font, cv::RGB565_WHITE, cv::RGB565_BLACK);
+        std::snprintf(text, sizeof(text), "%5.1f C", 20 + index * 0.7);
+        painter.putText(text, cv::Point(6, 24), font, cv::RGB565_YELLOW, cv::RGB565_BLACK);
+        std::vector<cv::Point> graph;
+        for (int x = 0; x < size.width - 12; x += 4)
+        {
+            graph.push_back(cv::Point(6 + x, size.height - 24 + int(14 * std::sin((x + index * 17) / 11.0))));
+        }
+        painter.polyline(graph, cv::RGB565_GREEN, 2);
+        painter.circle(cv::Point(size.width - 24, 24), 14, cv::RGB565_RED, 3);
+        painter.line(cv::Point(4, size.height - 4), cv::Point(size.width - 4, size.height - 4), cv::RGB565_CYAN, 1);
+    }
+
+    // draw the panels and copy them to frame, returns the wall time in ms
+    double draw_screen(const cv::Mat& frame, cv::Mat panels[2], bool queued, cv::FontBase& font)
+    {
+        const cv::Size panel_size = panels[0].size();
+        dma2d_fence_t fences[2] = { 0, 0 };
+        auto start = bench_clock::now();
+        int index = 0;
+        for (int y = 0; y < frame.rows; y += panel_size.height)
+        {
+            for (int x = 0; x < frame.cols; x += panel_size.width, index++)
+            {
+                cv::Mat& panel = panels[index % 2];
+                // the copy of the panel drawn two panels ago reads this buffer
+                dma2d_wait_fence(fences[index % 2]);
+                cv::Painter painter(panel);
+                draw_panel(painter, index, font);
+                const cv::Rect rect(0, 0, panel.cols, panel.rows);
+                if (queued)
+                {
+                    fences[index % 2] = dma2d_submit_copy(panel, rect, frame, cv::Point(x, y));
+                }
+                else
+                {
+                    dma2d_copy(panel, rect, frame, cv::Point(x, y));
+                }
+            }
+        }
+        dma2d_wait();
+        return std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 10;
+    dma2d_emu::Dma2dTimingModel model;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--clock-mhz" && i + 1 < argc)
+        {
+            model.clock_hz = std::atof(argv[++i]) * 1e6;
+        }
+        else if (arg == "--bus-bytes-per-cycle" && i + 1 < argc)
+        {
+            model.bus_bytes_per_cycle = std::atof(argv[++i]);
+        }
+        else
+        {
+            std::printf("Usage: %s [--repeat N] [--clock-mhz F] [--bus-bytes-per-cycle F]\n", argv[0]);
+            return 1;
+        }
+    }
+    dma2d_emu::set_timing_model(model);
+
+    bool ok = check_ordering(DMA2D_QUEUE_SIZE / 2);
+    ok &= check_ordering(400);
+
+    dma2d_emu::set_paced(true);
+    cv::ASCIIFont font(_default_ascii_font);
+    const cv::Size frame_size(800, 480);
+    cv::Mat panels[2] = { cv::Mat(96, 160, cv::RGB565), cv::Mat(96, 160, cv::RGB565) };
+    cv::Mat blocking_frame(frame_size, cv::RGB565), queued_frame(frame_size, cv::RGB565);
+
+    // CPU time of the drawing alone
+    double cpu_ms = 0;
+    for (int i = 0; i < repeat; i++)
+    {
+        auto start = bench_clock::now();
+        for (int index = 0; index < 25; index++)
+        {
+            cv::Painter painter(panels[0]);
+            draw_panel(painter, index, font);
+        }
+        cpu_ms += std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3;
+    }
+    cpu_ms /= repeat;
+
+    dma2d_emu::reset_stats();
+    double blocking_ms = 0, queued_ms = 0;
+    for (int i = 0; i < repeat; i++)
+    {
+        blocking_ms += draw_screen(blocking_frame, panels, false, font);
+        queued_ms += draw_screen(queued_frame, panels, true, font);
+    }
+    blocking_ms /= repeat;
+    queued_ms /= repeat;
+    const double dma2d_ms = dma2d_emu::stats().dma2d_us(model) / 1e3 / (2 * repeat);
+    bool same = memcmp(blocking_frame.data, queued_frame.data, blocking_frame.total() * 2) == 0;
+    ok &= same;
+
+    std::printf("\n%-10s %9s %9s %9s %s\n", "mode", "draw ms", "dma2d ms", "wall ms", "output");
+    std::printf("%-10s %9.3f %9.3f %9.3f %s\n", "blocking", cpu_ms, dma2d_ms, blocking_ms, "-");
+    std::printf("%-10s %9.3f %9.3f %9.3f %s\n", "queued", cpu_ms, dma2d_ms, queued_ms, same ? "ok" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Host benchmark for the Painter drawing hot paths.
+//
+// Every case is run on 320x240 and 800x480 frames in RGB565, RGB332 and the
+// 32/24-bit LTDC layer formats ARGB8888 and RGB888.
+// The pixel count of a case is measured once by drawing it on a cleared frame
+// and counting the pixels that changed; ns/pixel is the time per call divided
+// by that count. The clipped cases draw under a clip rect of the top left
+// quarter of the frame.
+//
+// Usage: bench_drawing [--min-time-ms N] [--filter SUBSTRING]
+
+#include "cvimgproc.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    struct BenchCase
+    {
+        const char* name;
+        std::function<void(cv::Painter&)> draw;
+    };
+
+    struct BenchResult
+    {
+        size_t pixels_per_call = 0;
+        double calls_per_sec = 0.0;
+        double ns_per_pixel = 0.0;
+    };
+
+    size_t count_painted(const cv::Mat& mat)
+    {
+        size_t painted = 0;
+        for (int y = 0; y < mat.rows; y++)
+        {
+            const uint8_t* p = mat.ptr<uint8_t>(y);
+            for (size_t x = 0; x < mat.cols * mat.elemSize(); x += mat.elemSize())
+            {
+                bool changed = false;
+                for (size_t b = 0; b < mat.elemSize(); b++)
+                {
+                    changed |= p[x + b] != 0;
+                }
+                painted += changed ? 1 : 0;
+            }
+        }
+        return painted;
+    }
+
+    BenchResult run_case(cv::Mat& mat, const BenchCase& bench_case, double min_seconds)
+    {
+        BenchResult result;
+        mat = 0;
+        cv::Painter probe(mat);
+        bench_case.draw(probe);
+        result.pixels_per_call = count_painted(mat);
+
+        cv::Painter painter(mat);
+        size_t calls = 0;
+        size_t batch = 1;
+        double elapsed = 0.0;
+        auto start = bench_clock::now();
+        while (elapsed < min_seconds)
+        {
+            for (size_t i = 0; i < batch; i++)
+            {
+                bench_case.draw(painter);
+            }
+            calls += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        }
+        result.calls_per_sec = calls / elapsed;
+        if (result.pixels_per_call > 0)
+        {
+            result.ns_per_pixel = elapsed * 1e9 / (double(calls) * result.pixels_per_call);
+        }
+        return result;
+    }
+
+    const char* format_name(int type)
+    {
+        switch (type)
+        {
+        case cv::RGB565: return "RGB565";
+        case cv::RGB332: return "RGB332";
+        case cv::ARGB8888: return "ARGB8888";
+        case cv::RGB888: return "RGB888";
+        }
+        return "?";
+    }
+
+    std::vector<BenchCase> make_cases(cv::Size size, int type, cv::FontBase& ascii_font, cv::FontBase& gb2312_font, const cv::Mat& bitmap)
+    {
+        const int w = size.width, h = size.height;
+        uint32_t color = cv::RGB565_WHITE, bg_color = cv::RGB565_BLUE;
+        switch (type)
+        {
+        case cv::RGB332:
+            color = cv::RGB332_WHITE;
+            bg_color = cv::RGB332_BLUE;
+            break;
+        case cv::ARGB8888:
+            color = cv::ARGB8888_WHITE;
+            bg_color = cv::ARGB8888_BLUE;
+            break;
+        case cv::RGB888:
+            color = cv::RGB888_WHITE;
+            bg_color = cv::RGB888_BLUE;
+            break;
+        }
+        std::vector<cv::Point> contour{ { w / 10, h / 2 }, { w * 3 / 10, h / 5 }, { w / 2, h * 4 / 5 },
+                                        { w * 7 / 10, h / 5 }, { w * 9 / 10, h / 2 }, { w / 2, h * 9 / 10 } };
+        return {
+            { "fill", [=](cv::Painter& p) { p.fill(color); } },
+            { "line", [=](cv::Painter& p) { p.line(cv::Point(w / 8, h / 8), cv::Point(w * 7 / 8, h * 6 / 8), color); } },
+            { "line_thick5", [=](cv::Painter& p) { p.line(cv::Point(w / 8, h / 8), cv::Point(w * 7 / 8, h * 6 / 8), color, 5); } },
+            { "rectangle_filled", [=](cv::Painter& p) { p.rectangle(cv::Point(w / 4, h / 4), cv::Point(w * 3 / 4, h * 3 / 4), color, cv::FILLED); } },
+            { "circle", [=](cv::Painter& p) { p.circle(cv::Point(w / 2, h / 2), h / 3, color); } },
+            { "circle_filled", [=](cv::Painter& p) { p.circle(cv::Point(w / 2, h / 2), h / 3, color, cv::FILLED); } },
+            { "ellipse", [=](cv::Painter& p) { p.ellipse(cv::Point(w / 2, h / 2), cv::Size(w / 3, h / 4), 30.0f, 0.0f, 360.0f, color); } },
+            { "ellipse_filled", [=](cv::Painter& p) { p.ellipse(cv::Point(w / 2, h / 2), cv::Size(w / 3, h / 4), 30.0f, 0.0f, 360.0f, color, cv::FILLED); } },
+            { "polyline", [=](cv::Painter& p) { p.polyline(contour, color); } },
+            { "putText_ascii", [=, &ascii_font](cv::Painter& p) { p.putText("The quick brown fox jumps over the lazy dog", cv::Point(4, 4), ascii_font, color, bg_color); } },
+            { "putText_gb2312", [=, &gb2312_font](cv::Painter& p) { p.putText("\xD6\xD0\xCE\xC4\xCF\xD4\xCA\xBE\xB2\xE2\xCA\xD4", cv::Point(4, 4), gb2312_font, color, bg_color); } },
+            { "drawBitmap_64x64", [=](cv::Painter& p) { p.drawBitmap(bitmap, cv::Point(w / 3, h / 3)); } },
+            // the top left quarter of the frame as clip rect
+            { "ellipse_clipped", [=](cv::Painter& p) {
+                p.push_clip(cv::Rect(0, 0, w / 2, h / 2));
+                p.ellipse(cv::Point(w / 2, h / 2), cv::Size(w / 3, h / 4), 30.0f, 0.0f, 360.0f, color, cv::FILLED);
+                p.pop_clip();
+            } },
+            { "circle_rejected", [=](cv::Painter& p) {
+                p.push_clip(cv::Rect(0, 0, w / 2, h / 2));
+                p.circle(cv::Point(w * 3 / 4, h * 3 / 4), h / 8, color, 3);
+                p.pop_clip();
+            } },
+        };
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double min_seconds = 0.2;
+    std::string filter;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--min-time-ms" && i + 1 < argc)
+        {
+            min_seconds = std::atof(argv[++i]) / 1000.0;
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            std::printf("Usage: %s [--min-time-ms N] [--filter SUBSTRING]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    cv::ASCIIFont ascii_font(_default_ascii_font);
+    cv::GB2312Font gb2312_font(_default_gb2312_font);
+
+    const cv::Size sizes[] = { cv::Size(320, 240), cv::Size(800, 480) };
+    const int types[] = { cv::RGB565, cv::RGB332, cv::ARGB8888, cv::RGB888 };
+
+    std::printf("%-18s %-8s %-8s %12s %12s %12s\n", "case", "size", "format", "pixels/call", "calls/s", "ns/pixel");
+    for (const cv::Size& size : sizes)
+    {
+        for (int type : types)
+        {
+            cv::Mat frame(size, type);
+            cv::Mat bitmap(64, 64, type);
+            for (size_t i = 0; i < bitmap.step[0] * bitmap.rows; i++)
+            {
+                bitmap.data[i] = uint8_t(i * 7 + 1) | 1;
+            }
+
+            char size_name[16];
+            std::snprintf(size_name, sizeof(size_name), "%dx%d", size.width, size.height);
+            for (const BenchCase& bench_case : make_cases(size, type, ascii_font, gb2312_font, bitmap))
+            {
+                if (!filter.empty() && std::string_view(bench_case.name).find(filter) == std::string_view::npos)
+                {
+                    continue;
+                }
+                BenchResult result = run_case(frame, bench_case, min_seconds);
+                std::printf("%-18s %-8s %-8s %12zu %12.0f %12.3f\n", bench_case.name, size_name,
+                    format_name(type), result.pixels_per_call, result.calls_per_sec, result.ns_per_pixel);
+            }
+        }
+    }
+    return 0;
+}
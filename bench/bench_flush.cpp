@@ -0,0 +1,98 @@
+// Measures FlushStage sending a full 320x240 frame to a mock SPI panel:
+// end-to-end MB/s and time to first byte, for single and ping-pong chunk
+// buffers of several sizes and a few SPI byte rates. The received bytes are
+// checked against a byte-swapped RGB565 conversion of the frame.
+//
+// Usage: bench_flush [--repeat N]
+
+#include "cvimgproc.h"
+#include "cvdisplay.h"
+#include "mock_display_sink.h"
+
+namespace
+{
+    struct FlushResult
+    {
+        double seconds = 0;
+        double first_byte_seconds = 0;
+        bool same = true;
+    };
+
+    FlushResult run_flush(const cv::Mat& frame, double bytes_per_second, size_t buffer_size, bool ping_pong, int repeat)
+    {
+        std::vector<uint8_t> buffers(buffer_size * 2);
+        MockDisplaySink sink(bytes_per_second);
+        cv::FlushStage stage(sink, buffers.data(), ping_pong ? buffers.data() + buffer_size : nullptr, buffer_size);
+        cv::Mat expected;
+        cv::cvtColor(frame, expected, frame.type == cv::RGB565 ? cv::COLOR_RGB565 : cv::COLOR_RGB332, cv::COLOR_RGB565_SWAPPED);
+
+        FlushResult result;
+        for (int i = 0; i < repeat; i++)
+        {
+            sink.reset();
+            auto start = MockDisplaySink::clock::now();
+            stage.flush(frame, cv::Rect(0, 0, frame.cols, frame.rows));
+            result.seconds += std::chrono::duration<double>(sink.last_done_time() - start).count();
+            result.first_byte_seconds += std::chrono::duration<double>(sink.first_send_time() - start).count();
+            result.same = result.same && sink.received().size() == expected.total() * 2 &&
+                memcmp(sink.received().data(), expected.data, sink.received().size()) == 0;
+        }
+        result.seconds /= repeat;
+        result.first_byte_seconds /= repeat;
+        return result;
+    }
+
+    void draw_frame(cv::Mat& frame)
+    {
+        cv::ASCIIFont font(_default_ascii_font);
+        cv::Painter painter(frame);
+        bool rgb565 = frame.type == cv::RGB565;
+        painter.fill(rgb565 ? cv::RGB565_BLACK : cv::RGB332_BLACK);
+        painter.rectangle(cv::Point(10, 10), cv::Point(310, 60), rgb565 ? cv::RGB565_BLUE : cv::RGB332_BLUE, cv::FILLED);
+        painter.circle(cv::Point(80, 150), 50, rgb565 ? cv::RGB565_GREEN : cv::RGB332_GREEN, 3);
+        painter.putText("Speed 42 km/h", cv::Point(16, 20), font, rgb565 ? cv::RGB565_WHITE : cv::RGB332_WHITE, rgb565 ? cv::RGB565_BLUE : cv::RGB332_BLUE);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 5;
+    if (argc == 3 && std::string_view(argv[1]) == "--repeat")
+    {
+        repeat = std::max(1, std::atoi(argv[2]));
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--repeat N]\n", argv[0]);
+        return 1;
+    }
+
+    const int types[] = { cv::RGB565, cv::RGB332 };
+    // SPI clocks of 40 and 80 MHz, and an unlimited link for the conversion alone
+    const double rates[] = { 5e6, 10e6, 0 };
+    const size_t buffer_sizes[] = { 1024, 4096, 16384 };
+    std::printf("%-8s %9s %-20s %10s %10s %12s %s\n", "frame", "SPI MB/s", "buffers", "frame ms", "MB/s", "first byte us", "output");
+    for (int type : types)
+    {
+        cv::Mat frame(240, 320, type);
+        draw_frame(frame);
+        const size_t frame_bytes = frame.total() * 2;
+        for (double rate : rates)
+        {
+            std::string rate_name = rate > 0 ? std::to_string(int(rate / 1e6)) : "inf";
+            auto report = [&](const std::string& name, size_t buffer_size, bool ping_pong) {
+                FlushResult result = run_flush(frame, rate, buffer_size, ping_pong, repeat);
+                std::printf("%-8s %9s %-20s %10.2f %10.2f %12.1f %s\n", type == cv::RGB565 ? "RGB565" : "RGB332", rate_name.c_str(),
+                    name.c_str(), result.seconds * 1e3, frame_bytes / result.seconds / 1e6, result.first_byte_seconds * 1e6,
+                    result.same ? "ok" : "MISMATCH");
+            };
+            report("whole frame", frame_bytes, false);
+            for (size_t buffer_size : buffer_sizes)
+            {
+                report("1 x " + std::to_string(buffer_size), buffer_size, false);
+                report("2 x " + std::to_string(buffer_size), buffer_size, true);
+            }
+        }
+    }
+    return 0;
+}
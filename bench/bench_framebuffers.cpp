@@ -0,0 +1,134 @@
+// Runs an 800x480 RGB565 dashboard through FrameBufferSet with two and three
+// buffers. Each frame only redraws the widgets that change; present copies
+// the areas changed since into the next back buffer. Reports the bytes and
+// time of that carry-over per frame next to copying the whole front buffer,
+// and checks every presented frame against the dashboard drawn from scratch.
+//
+// Usage: bench_framebuffers [--frames N]
+
+#include "cvdisplay.h"
+#include <chrono>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    struct Dashboard
+    {
+        cv::ASCIIFont font { _default_ascii_font };
+        int seconds = 0;
+        int values[3] = { 20, 50, 80 };
+
+        cv::Rect gauge_rect(int i) const
+        {
+            return cv::Rect(20 + i * 260, 60, 240, 240);
+        }
+
+        void clock(cv::Painter& painter)
+        {
+            char text[16];
+            std::snprintf(text, sizeof(text), "%02d:%02d:%02d", seconds / 3600 % 24, seconds / 60 % 60, seconds % 60);
+            painter.putText(text, cv::Point(700, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+        }
+
+        void gauge(cv::Painter& painter, int i)
+        {
+            cv::Rect rc = gauge_rect(i);
+            cv::Point center(rc.x + rc.width / 2, rc.y + rc.height / 2);
+            double radians = (225 - values[i] * 2.7) * CV_PI / 180;
+            painter.rectangle(rc.tl(), rc.br(), cv::RGB565_BLACK, cv::FILLED);
+            painter.circle(center, 110, cv::RGB565_CYAN, 6);
+            painter.ellipse(center, cv::Size(90, 90), 0, 135, 135 + values[i] * 2.7f, cv::RGB565_GREEN, 10);
+            painter.line(center, cv::Point(center.x + int(std::cos(radians) * 80), center.y - int(std::sin(radians) * 80)),
+                cv::RGB565_RED, 4);
+        }
+
+        void full(cv::Painter& painter)
+        {
+            painter.fill(cv::RGB565_BLACK);
+            painter.rectangle(cv::Point(0, 0), cv::Point(799, 39), cv::RGB565_BLUE, cv::FILLED);
+            painter.putText("Line 3 - Packaging", cv::Point(12, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+            clock(painter);
+            for (int i = 0; i < 3; i++)
+            {
+                gauge(painter, i);
+            }
+            painter.rectangle(cv::Point(16, 340), cv::Point(783, 463), cv::RGB565_WHITE, 1);
+        }
+
+        // advance one frame: the clock ticks every frame, one gauge moves
+        void update(cv::Painter& painter, int frame)
+        {
+            seconds++;
+            clock(painter);
+            int i = frame % 3;
+            values[i] = (values[i] + 7) % 100;
+            gauge(painter, i);
+        }
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = 60;
+    if (argc == 3 && std::string_view(argv[1]) == "--frames")
+    {
+        frames = std::max(1, std::atoi(argv[2]));
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--frames N]\n", argv[0]);
+        return 1;
+    }
+
+    const cv::Size frame_size(800, 480);
+    const size_t frame_bytes = frame_size.area() * 2;
+    std::printf("%-8s %14s %14s %12s %12s %s\n", "buffers", "carried B", "full copy B", "carry us", "full us", "output");
+    for (int count = 2; count <= cv::FrameBufferSet::MAX_BUFFERS; count++)
+    {
+        cv::FrameBufferSet buffers(frame_size, cv::RGB565, count);
+        Dashboard dashboard;
+        {
+            cv::Painter painter(buffers.back());
+            dashboard.full(painter);
+            buffers.present(painter);
+        }
+        // skip the whole-frame copies of the first presents
+        for (int i = 1; i < count; i++)
+        {
+            cv::Painter painter(buffers.back());
+            dashboard.update(painter, i);
+            buffers.present(painter);
+        }
+
+        size_t carried = 0;
+        double carry_seconds = 0;
+        bool same = true;
+        cv::Mat reference(frame_size, cv::RGB565);
+        for (int frame = 0; frame < frames; frame++)
+        {
+            cv::Painter painter(buffers.back());
+            dashboard.update(painter, frame);
+            auto start = bench_clock::now();
+            buffers.present(painter);
+            carry_seconds += std::chrono::duration<double>(bench_clock::now() - start).count();
+            carried += buffers.get_carried_bytes();
+
+            cv::Painter reference_painter(reference);
+            dashboard.full(reference_painter);
+            same = same && memcmp(buffers.front().data, reference.data, frame_bytes) == 0;
+        }
+
+        cv::Mat copy(frame_size, cv::RGB565);
+        auto start = bench_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            buffers.front().copyTo(copy);
+        }
+        double full_seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+        std::printf("%-8d %14zu %14zu %12.1f %12.1f %s\n", count, carried / frames, frame_bytes, carry_seconds * 1e6 / frames,
+            full_seconds * 1e6 / frames, same ? "ok" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+// Per-glyph cost of text drawing into an 800x480 RGB565 frame, for the
+// bundled 16px ASCII and GB2312 fonts and an anti-aliased copy of the ASCII
+// one. The bundled fonts are 1-bit; the copy gives the pixels next to the
+// strokes partial coverage and is encoded in the anti-aliased glyph format, so
+// its glyphs go through the A8 mask path.
+//
+// Each font is drawn on the CPU Blitter with the mask cache off and with it
+// on (16 KB), anti-aliased glyphs blended while decoding either way, by table
+// for RGB565; then on the DMA2D Blitter from cached masks. The CPU runs
+// report host ns per glyph; the DMA2D runs on the software model, which
+// reports its estimated time per glyph next to its estimate for the CPU code.
+// All three frames must be equal: the table and the DMA2D blender share the
+// same 8-bit arithmetic.
+//
+// Usage: bench_glyphs [--min-time-ms N]
+
+#include "cvimgproc.h"
+#include <chrono>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    // emit transparent runs of the anti-aliased glyph format
+    void encode_skip(std::vector<uint8_t>& out, int count)
+    {
+        while (count > 0)
+        {
+            int run = std::min(count, 31);
+            out.push_back(uint8_t(run));
+            count -= run;
+        }
+    }
+
+    // Encode levels 0~7 of a glyph in the anti-aliased format of
+    // FontBase::decode_char (char_data[0] == 3)
+    std::vector<uint8_t> encode_glyph(const std::vector<uint8_t>& levels)
+    {
+        std::vector<uint8_t> out{ 3 };
+        size_t i = 0;
+        while (i < levels.size())
+        {
+            int skip = 0;
+            while (i + skip < levels.size() && levels[i + skip] == 0)
+            {
+                skip++;
+            }
+            if (i + skip == levels.size())
+            {
+                break;
+            }
+            i += skip;
+            if (levels[i] == 7)
+            {
+                int run = 0;
+                while (i + run < levels.size() && levels[i + run] == 7)
+                {
+                    run++;
+                }
+                if (skip <= 31 && run <= 2)
+                {
+                    // skip, then one or two opaque pixels
+                    out.push_back(uint8_t((run == 1 ? 0x40 : 0x60) | skip));
+                }
+                else
+                {
+                    encode_skip(out, skip);
+                    for (int left = run; left > 0; left -= 31)
+                    {
+                        out.push_back(uint8_t(0x20 | std::min(left, 31)));
+                    }
+                }
+                i += run;
+            }
+            else if (skip == 0 && i + 1 < levels.size() && levels[i + 1] != 0 && levels[i + 1] != 7)
+            {
+                // two partial pixels
+                out.push_back(uint8_t(0xC0 | (levels[i] << 3) | levels[i + 1]));
+                i += 2;
+            }
+            else
+            {
+                // skip, then one partial pixel
+                encode_skip(out, skip > 7 ? skip : 0);
+                out.push_back(uint8_t(0x80 | ((skip > 7 ? 0 : skip) << 3) | levels[i]));
+                i++;
+            }
+        }
+        return out;
+    }
+
+    // An anti-aliased copy of the 1-bit ASCII font at font_data: stroke
+    // pixels stay opaque, transparent ones get 2 levels per stroke neighbour
+    std::vector<uint8_t> make_anti_aliased_font(const uint8_t* font_data)
+    {
+        const cv::font_header_t* header = reinterpret_cast<const cv::font_header_t*>(font_data);
+        const uint32_t map_address = header->data_address + header->length_of_description;
+        const int char_count = 0x7F - 0x20;
+        cv::font_header_t new_header = *header;
+        new_header.data_address = sizeof(cv::font_header_t);
+        new_header.length_of_description = 0;
+        new_header.anti_alias = 1;
+
+        cv::ASCIIFont font(font_data);
+        std::vector<cv::font_char_entry_t> entries(char_count);
+        std::vector<uint8_t> glyph_data;
+        std::vector<uint8_t> buffer;
+        for (int index = 0; index < char_count; index++)
+        {
+            std::memcpy(&entries[index], font_data + map_address + index * sizeof(cv::font_char_entry_t), sizeof(cv::font_char_entry_t));
+            cv::Mat coverage = font.get_char_bitmap(uint16_t(0x20 + index), 255, 0, cv::A8, buffer);
+            std::vector<uint8_t> levels(coverage.total());
+            for (int y = 0; y < coverage.rows; y++)
+            {
+                for (int x = 0; x < coverage.cols; x++)
+                {
+                    auto set = [&](int xx, int yy) {
+                        return xx >= 0 && yy >= 0 && xx < coverage.cols && yy < coverage.rows && coverage.at<uint8_t>(yy, xx) != 0;
+                    };
+                    int neighbours = set(x - 1, y) + set(x + 1, y) + set(x, y - 1) + set(x, y + 1);
+                    levels[y * coverage.cols + x] = uint8_t(set(x, y) ? 7 : std::min(6, neighbours * 2));
+                }
+            }
+            std::vector<uint8_t> encoded = encode_glyph(levels);
+            const uint32_t offset = uint32_t(char_count * sizeof(cv::font_char_entry_t) + glyph_data.size());
+            entries[index].char_data_addr_info[0] = uint8_t(offset);
+            entries[index].char_data_addr_info[1] = uint8_t(offset >> 8);
+            entries[index].char_data_addr_info[2] = uint8_t(offset >> 16);
+            entries[index].char_data_len = uint16_t(encoded.size());
+            glyph_data.insert(glyph_data.end(), encoded.begin(), encoded.end());
+        }
+        std::vector<uint8_t> result(sizeof(new_header) + entries.size() * sizeof(cv::font_char_entry_t) + glyph_data.size());
+        std::memcpy(result.data(), &new_header, sizeof(new_header));
+        std::memcpy(result.data() + sizeof(new_header), entries.data(), entries.size() * sizeof(cv::font_char_entry_t));
+        std::memcpy(result.data() + sizeof(new_header) + entries.size() * sizeof(cv::font_char_entry_t), glyph_data.data(), glyph_data.size());
+        return result;
+    }
+
+    // draw lines of text over the frame, returns the number of glyphs
+    int draw_lines(const cv::Mat& frame, cv::FontBase& font, std::string_view text, int glyphs_per_line)
+    {
+        cv::Painter painter(frame);
+        int lines = 0;
+        for (int y = 2; y + 16 <= frame.rows; y += 18, lines++)
+        {
+            painter.putText(text, cv::Point(2 + lines % 7, y), font, cv::RGB565_WHITE, cv::RGB565_WHITE);
+        }
+        return lines * glyphs_per_line;
+    }
+
+    struct FontCase
+    {
+        const char* name;
+        cv::FontBase* font;
+        std::string_view text;
+        int glyphs_per_line;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    double min_seconds = 0.2;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--min-time-ms" && i + 1 < argc)
+        {
+            min_seconds = std::atof(argv[++i]) / 1000.0;
+        }
+        else
+        {
+            std::printf("Usage: %s [--min-time-ms N]\n", argv[0]);
+            return 1;
+        }
+    }
+    std::vector<uint8_t> anti_aliased_data = make_anti_aliased_font(_default_ascii_font);
+    cv::ASCIIFont ascii(_default_ascii_font), anti_aliased(anti_aliased_data.data());
+    cv::GB2312Font gb2312(_default_gb2312_font);
+    // temperature, humidity, pressure, wind speed, rainfall (GB2312)
+    const char gb2312_text[] = "\xCE\xC2\xB6\xC8\xCA\xAA\xB6\xC8\xD1\xB9\xC1\xA6\xB7\xE7\xCB\xD9\xBD\xB5\xD3\xEA\xC1\xBF 23.5 C 61%";
+    const char ascii_text[] = "The quick brown fox jumps over the lazy dog 0123456789";
+    const FontCase fonts[] = {
+        { "ASCII 16px", &ascii, ascii_text, int(sizeof(ascii_text) - 1) },
+        { "GB2312 16px", &gb2312, gb2312_text, 11 + 11 },
+        { "ASCII 16px AA", &anti_aliased, ascii_text, int(sizeof(ascii_text) - 1) },
+    };
+    for (int op = 0; op < cv::BLIT_OPERATION_COUNT; op++)
+    {
+        cv::getDma2dBlitter()->set_min_pixels(cv::BlitOperation(op), 0);
+    }
+
+    const cv::Size frame_size(800, 480);
+    cv::Mat decoded(frame_size, cv::RGB565), cached(frame_size, cv::RGB565), masked(frame_size, cv::RGB565);
+    bool ok = true;
+    std::printf("%-14s %10s %12s %12s %12s %12s %s\n", "font", "glyphs", "cpu ns", "cached ns", "dma2d us", "cpu us", "output");
+    for (const FontCase& font_case : fonts)
+    {
+        cv::FontBase& font = *font_case.font;
+        // one frame for the output, then the same lines over it until
+        // min_seconds have passed
+        auto draw = [&](const cv::Mat& frame) {
+            cv::Painter(frame).fill(cv::RGB565_BLUE);
+            return draw_lines(frame, font, font_case.text, font_case.glyphs_per_line);
+        };
+        auto time_per_glyph = [&](const cv::Mat& frame) {
+            draw(frame);
+            cv::Mat scratch = frame.clone();
+            int glyphs = 0;
+            auto start = bench_clock::now();
+            double seconds = 0;
+            do
+            {
+                glyphs += draw_lines(scratch, font, font_case.text, font_case.glyphs_per_line);
+                seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+            } while (seconds < min_seconds);
+            return seconds * 1e9 / glyphs;
+        };
+
+        cv::setBlitter(cv::getCpuBlitter());
+        font.set_glyph_mask_cache_size(0);
+        const double decode_ns = time_per_glyph(decoded);
+        font.set_glyph_mask_cache_size(16384);
+        const double cached_ns = time_per_glyph(cached);
+
+        cv::setBlitter(nullptr);
+        cv::Painter(masked).fill(cv::RGB565_BLUE);
+        dma2d_emu::reset_stats();
+        const int glyphs = draw_lines(masked, font, font_case.text, font_case.glyphs_per_line);
+        const dma2d_emu::Dma2dStats& stats = dma2d_emu::stats();
+        const double dma2d_us = stats.dma2d_us(dma2d_emu::timing_model());
+        const double cpu_us = stats.cpu_us(dma2d_emu::timing_model());
+
+        const size_t bytes = decoded.total() * 2;
+        const bool same = std::memcmp(decoded.data, cached.data, bytes) == 0 && std::memcmp(decoded.data, masked.data, bytes) == 0;
+        ok &= same;
+        std::printf("%-14s %10d %12.1f %12.1f %12.3f %12.3f %s\n", font_case.name, glyphs, decode_ns, cached_ns, dma2d_us / glyphs,
+            cpu_us / glyphs, same ? "ok" : "MISMATCH");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// Compares the span kernels (cvkernels.h) with the loops they replaced, for
+// span widths of 1 to 1024 pixels. Spans start at every pixel offset of a
+// row, as horizontal lines of a drawing do.
+//
+// Usage: bench_kernels [--min-time-ms N]
+
+#include "cvkernels.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    // keep the compiler from dropping stores to p
+    inline void escape(void* p)
+    {
+        asm volatile("" : : "g"(p) : "memory");
+    }
+
+    // the ICV_HLINE fill of the RGB565 rasterizers: doubling memcpy calls
+    void hline_doubling_memcpy(uint16_t* dst, uint16_t value, size_t count)
+    {
+        uint8_t* hline_min_ptr = reinterpret_cast<uint8_t*>(dst);
+        uint8_t* hline_end_ptr = reinterpret_cast<uint8_t*>(dst + count);
+        uint8_t* hline_ptr = hline_min_ptr;
+        if (hline_min_ptr < hline_end_ptr)
+        {
+            memcpy(hline_ptr, &value, 2);
+            hline_ptr += 2;
+        }
+        size_t sizeToCopy = 2;
+        while (hline_ptr < hline_end_ptr)
+        {
+            memcpy(hline_ptr, hline_min_ptr, sizeToCopy);
+            hline_ptr += sizeToCopy;
+            sizeToCopy = std::min(2 * sizeToCopy, static_cast<size_t>(hline_end_ptr - hline_ptr));
+        }
+    }
+
+    struct KernelCase
+    {
+        const char* name;
+        size_t pixel_size;
+        std::function<void(uint8_t* dst, const uint8_t* src, size_t count)> run;
+    };
+
+    // ns per call, averaged over every start offset in a 16 pixel window
+    double time_case(const KernelCase& kernel_case, size_t width, std::vector<uint8_t>& dst, const std::vector<uint8_t>& src, double min_seconds)
+    {
+        size_t calls = 0;
+        size_t batch = 16;
+        double elapsed = 0.0;
+        auto start = bench_clock::now();
+        while (elapsed < min_seconds)
+        {
+            for (size_t i = 0; i < batch; i++)
+            {
+                size_t offset = (i & 15) * kernel_case.pixel_size;
+                kernel_case.run(dst.data() + offset, src.data() + offset, width);
+                escape(dst.data());
+            }
+            calls += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+        }
+        return elapsed * 1e9 / calls;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double min_seconds = 0.05;
+    if (argc == 3 && std::string_view(argv[1]) == "--min-time-ms")
+    {
+        min_seconds = std::atof(argv[2]) / 1000.0;
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--min-time-ms N]\n", argv[0]);
+        return 1;
+    }
+
+    const cv::rgb888_t rgb888 = { 0x12, 0x34, 0x56 };
+    // pairs of (current loop, kernel) with the same pixel size
+    const KernelCase cases[] = {
+        { "fill8 memset", 1, [](uint8_t* d, const uint8_t*, size_t n) { memset(d, 0x5A, n); } },
+        { "fill8 kernel", 1, [](uint8_t* d, const uint8_t*, size_t n) { cv::fill_span8(d, 0x5A, n); } },
+        { "fill16 std::fill_n", 2, [](uint8_t* d, const uint8_t*, size_t n) { std::fill_n(reinterpret_cast<uint16_t*>(d), n, uint16_t(0xF81F)); } },
+        { "fill16 ICV_HLINE", 2, [](uint8_t* d, const uint8_t*, size_t n) { hline_doubling_memcpy(reinterpret_cast<uint16_t*>(d), 0xF81F, n); } },
+        { "fill16 kernel", 2, [](uint8_t* d, const uint8_t*, size_t n) { cv::fill_span16(reinterpret_cast<uint16_t*>(d), 0xF81F, n); } },
+        { "fill24 std::fill_n", 3, [=](uint8_t* d, const uint8_t*, size_t n) { std::fill_n(reinterpret_cast<cv::rgb888_t*>(d), n, rgb888); } },
+        { "fill24 kernel", 3, [=](uint8_t* d, const uint8_t*, size_t n) { cv::fill_span24(reinterpret_cast<cv::rgb888_t*>(d), rgb888, n); } },
+        { "fill32 std::fill_n", 4, [](uint8_t* d, const uint8_t*, size_t n) { std::fill_n(reinterpret_cast<uint32_t*>(d), n, 0xFF00FF00u); } },
+        { "fill32 kernel", 4, [](uint8_t* d, const uint8_t*, size_t n) { cv::fill_span32(reinterpret_cast<uint32_t*>(d), 0xFF00FF00u, n); } },
+        { "copy16 std::copy_n", 2, [](uint8_t* d, const uint8_t* s, size_t n) { std::copy_n(reinterpret_cast<const uint16_t*>(s), n, reinterpret_cast<uint16_t*>(d)); } },
+        { "copy16 memcpy", 2, [](uint8_t* d, const uint8_t* s, size_t n) { memcpy(d, s, n * 2); } },
+        { "copy16 kernel", 2, [](uint8_t* d, const uint8_t* s, size_t n) { cv::copy_span(d, s, n * 2); } },
+    };
+    const size_t widths[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+
+    std::vector<uint8_t> dst((1024 + 16) * 4 + 64);
+    std::vector<uint8_t> src(dst.size());
+    for (size_t i = 0; i < src.size(); i++)
+    {
+        src[i] = uint8_t(i * 11 + 3);
+    }
+
+    std::printf("span kernels: %s, ns per call\n", cv::span_kernels_isa());
+    std::printf("%-20s", "case");
+    for (size_t width : widths)
+    {
+        std::printf(" %8zu", width);
+    }
+    std::printf("\n");
+    for (const KernelCase& kernel_case : cases)
+    {
+        std::printf("%-20s", kernel_case.name);
+        for (size_t width : widths)
+        {
+            std::printf(" %8.1f", time_case(kernel_case, width, dst, src, min_seconds));
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
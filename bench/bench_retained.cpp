@@ -0,0 +1,137 @@
+// Retained-mode redraw of an 800x480 RGB565 dashboard: every update records
+// the next frame into a DisplayList, diffs it against the previous list and
+// redraws only the damage. Reports the list size, the damaged area and the
+// time of diff + redraw next to a full replay of the new list, whose pixels
+// the redrawn frame must match.
+//
+// Usage: bench_retained [--repeat N]
+
+#include "cvrender.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    struct Dashboard
+    {
+        cv::ASCIIFont font { _default_ascii_font };
+        int seconds = 12 * 3600 + 5 * 60 + 42;
+        int rpm[3] = { 12, 30, 55 };
+        int graph_phase = 0;
+        bool alarm = false;
+
+        void draw(cv::Painter& painter)
+        {
+            char text[16];
+            painter.fill(cv::RGB565_BLACK);
+            painter.rectangle(cv::Point(0, 0), cv::Point(799, 39), cv::RGB565_BLUE, cv::FILLED);
+            painter.putText("Line 3 - Packaging", cv::Point(12, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+            std::snprintf(text, sizeof(text), "%02d:%02d:%02d", seconds / 3600 % 24, seconds / 60 % 60, seconds % 60);
+            painter.putText(text, cv::Point(720, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE);
+            if (alarm)
+            {
+                painter.circle(cv::Point(690, 20), 10, cv::RGB565_RED, cv::FILLED);
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                cv::Point center(140 + i * 260, 200);
+                double radians = (225 - rpm[i] * 2.7) * CV_PI / 180;
+                painter.circle(center, 110, cv::RGB565_CYAN, 6);
+                painter.ellipse(center, cv::Size(90, 90), 0, 135, 135 + rpm[i] * 2.7, cv::RGB565_GREEN, 10);
+                painter.line(center, cv::Point(center.x + int(std::cos(radians) * 80), center.y - int(std::sin(radians) * 80)),
+                    cv::RGB565_RED, 4);
+                painter.circle(center, 8, cv::RGB565_WHITE, cv::FILLED);
+                std::snprintf(text, sizeof(text), "%3d x100", rpm[i]);
+                painter.putText(text, cv::Point(center.x - 32, center.y + 40), font, cv::RGB565_YELLOW, cv::RGB565_BLACK);
+            }
+            std::vector<cv::Point> graph;
+            for (int x = 0; x <= 760; x += 8)
+            {
+                graph.push_back(cv::Point(20 + x, 400 - int(40 * std::sin((x + graph_phase) / 50.0))));
+            }
+            painter.rectangle(cv::Point(16, 340), cv::Point(783, 463), cv::RGB565_WHITE, 1);
+            painter.polyline(graph, cv::RGB565_GREEN, 2);
+        }
+    };
+
+    struct Update
+    {
+        const char* name;
+        std::function<void(Dashboard&)> apply;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 20;
+    if (argc == 3 && std::string_view(argv[1]) == "--repeat")
+    {
+        repeat = std::max(1, std::atoi(argv[2]));
+    }
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--repeat N]\n", argv[0]);
+        return 1;
+    }
+
+    const Update updates[] = {
+        { "nothing", [](Dashboard&) {} },
+        { "clock tick", [](Dashboard& d) { d.seconds++; } },
+        { "one needle", [](Dashboard& d) { d.rpm[1] += 3; } },
+        { "alarm on", [](Dashboard& d) { d.alarm = true; } },
+        { "clock + needles", [](Dashboard& d) { d.seconds++; d.rpm[0]++; d.rpm[2] -= 2; } },
+        { "graph scroll", [](Dashboard& d) { d.graph_phase += 8; } },
+    };
+    const cv::Size frame_size(800, 480);
+    const double frame_pixels = frame_size.area();
+
+    std::printf("%-16s %8s %10s %8s %10s %10s %8s %s\n", "update", "commands", "list B", "damage%", "replay ms", "retained ms",
+        "speedup", "output");
+    Dashboard dashboard;
+    cv::DisplayList previous(frame_size, cv::RGB565), current(frame_size, cv::RGB565);
+    cv::Painter recorder(previous);
+    dashboard.draw(recorder);
+    cv::Mat frame(frame_size, cv::RGB565), expected(frame_size, cv::RGB565);
+    cv::Painter frame_painter(frame);
+    previous.replay(frame_painter);
+
+    for (const Update& update : updates)
+    {
+        update.apply(dashboard);
+        current.clear();
+        cv::Painter current_recorder(current);
+        dashboard.draw(current_recorder);
+
+        cv::Painter expected_painter(expected);
+        auto start = bench_clock::now();
+        for (int i = 0; i < repeat; i++)
+        {
+            current.replay(expected_painter);
+        }
+        double replay_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+
+        // the redraw is repeated over a copy of the previous frame
+        cv::Mat previous_frame = frame.clone();
+        cv::DirtyRegion damage;
+        double retained_ms = 0;
+        for (int i = 0; i < repeat; i++)
+        {
+            previous_frame.copyTo(frame);
+            start = bench_clock::now();
+            damage.clear();
+            cv::DisplayList::diff(previous, current, damage);
+            frame_painter.reset_dirty_rect();
+            current.redraw(frame_painter, damage);
+            retained_ms += std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3;
+        }
+        retained_ms /= repeat;
+        bool same = memcmp(frame.data, expected.data, frame.total() * 2) == 0;
+
+        std::printf("%-16s %8d %10zu %7.1f%% %10.3f %10.3f %7.1fx %s\n", update.name, current.size(), current.byte_size(),
+            100.0 * damage.area() / frame_pixels, replay_ms, retained_ms, replay_ms / retained_ms, same ? "ok" : "MISMATCH");
+        std::swap(previous, current);
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Draws 800x480 RGB565 frames directly into the framebuffer and through
+// TileRenderer with tiles of several sizes, and reports the SDRAM traffic a
+// Cortex-M7 would make with the framebuffer in SDRAM, the SDRAM time it takes
+// at the given bandwidth, and the host time per frame (where the caches hide
+// the framebuffer traffic). Drawing directly through the write-back D-cache
+// fills and writes back each 32-byte line once per command touching it,
+// counted per command; a tiled frame is drawn in DTCM and each drawn tile is
+// written once. The tiled frames must match the direct drawing.
+//
+// Usage: bench_tiles [--repeat N] [--sdram-mb-s F]
+
+#include "cvrender.h"
+#include <chrono>
+#include <functional>
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+    using Command = std::function<void(cv::Painter&)>;
+
+    struct Scene
+    {
+        const char* name;
+        std::vector<Command> commands;
+    };
+
+    Scene dashboard(cv::FontBase& font)
+    {
+        Scene scene { "dashboard", {} };
+        auto& c = scene.commands;
+        c.push_back([](cv::Painter& p) { p.fill(cv::RGB565_BLACK); });
+        c.push_back([](cv::Painter& p) { p.rectangle(cv::Point(0, 0), cv::Point(799, 39), cv::RGB565_BLUE, cv::FILLED); });
+        c.push_back([&font](cv::Painter& p) { p.putText("Line 3 - Packaging", cv::Point(12, 12), font, cv::RGB565_WHITE, cv::RGB565_BLUE); });
+        for (int i = 0; i < 3; i++)
+        {
+            cv::Point center(140 + i * 260, 200);
+            c.push_back([=](cv::Painter& p) { p.circle(center, 110, cv::RGB565_CYAN, 6); });
+            c.push_back([=](cv::Painter& p) { p.circle(center, 100, cv::RGB565_BLACK, cv::FILLED); });
+            c.push_back([=](cv::Painter& p) { p.ellipse(center, cv::Size(90, 90), 0, 135, 135 + 60 * (i + 2), cv::RGB565_GREEN, 10); });
+            c.push_back([=](cv::Painter& p) { p.line(center, cv::Point(center.x + 70 - i * 40, center.y - 60), cv::RGB565_RED, 4); });
+            c.push_back([=](cv::Painter& p) { p.circle(center, 8, cv::RGB565_WHITE, cv::FILLED); });
+            c.push_back([=, &font](cv::Painter& p) {
+                p.putText("rpm x100", cv::Point(center.x - 32, center.y + 40), font, cv::RGB565_YELLOW, cv::RGB565_BLACK);
+            });
+        }
+        c.push_back([](cv::Painter& p) { p.rectangle(cv::Point(16, 340), cv::Point(783, 463), cv::RGB565_BLUE, cv::FILLED); });
+        for (int i = 0; i < 12; i++)
+        {
+            c.push_back([=](cv::Painter& p) {
+                p.rectangle(cv::Point(24 + i * 64, 450 - i * 6), cv::Point(64 + i * 64, 460), cv::RGB565_MAGENTA, cv::FILLED);
+            });
+        }
+        return scene;
+    }
+
+    // small primitives spread over the whole screen, as in a map or a chart
+    Scene scattered()
+    {
+        Scene scene { "scattered", {} };
+        auto& c = scene.commands;
+        c.push_back([](cv::Painter& p) { p.fill(cv::RGB565_BLACK); });
+        uint32_t seed = 12345;
+        auto next = [&seed](int range) {
+            seed = seed * 1664525u + 1013904223u;
+            return int((seed >> 8) % uint32_t(range));
+        };
+        for (int i = 0; i < 400; i++)
+        {
+            cv::Point pt(next(800), next(480));
+            cv::Point pt2(pt.x + next(61) - 30, pt.y + next(61) - 30);
+            uint16_t color = uint16_t(next(0x10000));
+            int radius = 4 + next(12);
+            switch (i % 4)
+            {
+            case 0: c.push_back([=](cv::Painter& p) { p.circle(pt, radius, color, cv::FILLED); }); break;
+            case 1: c.push_back([=](cv::Painter& p) { p.line(pt, pt2, color, 2); }); break;
+            case 2: c.push_back([=](cv::Painter& p) { p.rectangle(pt, pt2, color, cv::FILLED); }); break;
+            case 3: c.push_back([=](cv::Painter& p) { p.circle(pt, 10, color, 1); }); break;
+            }
+        }
+        return scene;
+    }
+
+    void draw(const Scene& scene, cv::Painter& painter)
+    {
+        for (const Command& command : scene.commands)
+        {
+            command(painter);
+        }
+    }
+
+    const int CACHE_LINE_PIXELS = 32 / 2;
+
+    // 32-byte cache lines a command writes to, found from the pixels that
+    // differ from the background after drawing it over either of two
+    // backgrounds; rows of 800 RGB565 pixels start on a line
+    size_t lines_written(const Command& command, cv::Mat& a, cv::Mat& b)
+    {
+        cv::Painter pa(a), pb(b);
+        pa.fill(0x0000);
+        pb.fill(0xffff);
+        command(pa);
+        command(pb);
+        size_t lines = 0;
+        for (int y = 0; y < a.rows; y++)
+        {
+            for (int x0 = 0; x0 < a.cols; x0 += CACHE_LINE_PIXELS)
+            {
+                bool written = false;
+                for (int x = x0; x < x0 + CACHE_LINE_PIXELS && !written; x++)
+                {
+                    written = a.at<uint16_t>(y, x) != 0x0000 || b.at<uint16_t>(y, x) != 0xffff;
+                }
+                lines += written;
+            }
+        }
+        return lines;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 20;
+    // 32-bit SDRAM at 100 MHz, with row and bus turnaround overhead
+    double sdram_mb_s = 200;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--sdram-mb-s" && i + 1 < argc)
+        {
+            sdram_mb_s = std::max(1.0, std::atof(argv[++i]));
+        }
+        else
+        {
+            std::printf("Usage: %s [--repeat N] [--sdram-mb-s F]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const cv::Size frame_size(800, 480);
+    cv::ASCIIFont font(_default_ascii_font);
+    const Scene scenes[] = { dashboard(font), scattered() };
+    const int tile_sizes[] = { 32, 64, 128 };
+
+    std::printf("%-10s %-10s %10s %10s %9s %9s %10s %s\n", "scene", "mode", "SDRAM KB", "vs direct", "SDRAM ms", "host ms",
+        "tile cmds", "output");
+    for (const Scene& scene : scenes)
+    {
+        cv::Mat frame(frame_size, cv::RGB565), scratch(frame_size, cv::RGB565);
+        size_t lines = 0;
+        for (const Command& command : scene.commands)
+        {
+            lines += lines_written(command, frame, scratch);
+        }
+        // line fill and write back
+        double direct_kb = lines * 64 / 1024.0;
+
+        auto start = bench_clock::now();
+        for (int i = 0; i < repeat; i++)
+        {
+            cv::Painter painter(frame);
+            draw(scene, painter);
+        }
+        double direct_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+        std::printf("%-10s %-10s %10.1f %9.2fx %9.3f %9.3f %10zu %s\n", scene.name, "direct", direct_kb, 1.0,
+            direct_kb * 1024 / sdram_mb_s / 1e3, direct_ms, scene.commands.size(), "-");
+
+        cv::DisplayList list(frame_size, cv::RGB565);
+        cv::Painter recorder(list);
+        draw(scene, recorder);
+        for (int tile_size : tile_sizes)
+        {
+            cv::Mat tile(tile_size, tile_size, cv::RGB565);
+            cv::Mat tiled(frame_size, cv::RGB565);
+            cv::TileRenderer renderer(tile);
+            start = bench_clock::now();
+            for (int i = 0; i < repeat; i++)
+            {
+                renderer.render(list, tiled);
+            }
+            double tiled_ms = std::chrono::duration<double>(bench_clock::now() - start).count() * 1e3 / repeat;
+
+            // each drawn tile is written once, edge tiles clipped to the frame;
+            // both scenes start with fill(), so every tile is drawn
+            int tile_count = ((frame_size.width + tile_size - 1) / tile_size) * ((frame_size.height + tile_size - 1) / tile_size);
+            double tiled_kb = frame_size.area() * 2 / 1024.0 * renderer.get_tiles_drawn() / tile_count;
+            bool same = memcmp(tiled.data, frame.data, frame.total() * 2) == 0;
+
+            std::string name = "tile " + std::to_string(tile_size);
+            std::printf("%-10s %-10s %10.1f %9.2fx %9.3f %9.3f %10d %s\n", scene.name, name.c_str(), tiled_kb, tiled_kb / direct_kb,
+                tiled_kb * 1024 / sdram_mb_s / 1e3, tiled_ms, renderer.get_commands_drawn(), same ? "ok" : "MISMATCH");
+        }
+    }
+    return 0;
+}
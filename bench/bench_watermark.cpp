@@ -0,0 +1,202 @@
+// Flush latency of a 480x272 RGB332 frame through Dma2dFlushStage to a
+// 16-bit panel, on the software model of the DMA2D: converting the whole
+// frame before sending it, against sending the lines each line-watermark
+// interrupt reports while the DMA2D converts the next ones.
+//
+// The flush runs for real through the driver and the model, in simulated
+// time. Lines are ready at the model's estimate of the conversion up to them
+// (its setup, then an equal share of the transfer per line). The panel holds
+// the model at the watermark the flush should see next: the lines ready when
+// its last send started, or else the next watermark, reached at its time. A
+// send starts once the flush saw its lines and the previous send is done, and
+// lasts its bytes at the panel bus rate; a conversion waiting for the buffer
+// starts once the panel has the rows before it. Each send must end at the
+// watermark the flush was held at, and the received bytes must match an
+// RGB565 conversion of the frame on the CPU. Reports the simulated time from
+// the flush to the last byte on the panel and to the first byte, for a few
+// bus rates and band heights.
+//
+// Usage: bench_watermark
+
+#include "cvimgproc.h"
+#include "cvdisplay.h"
+
+namespace
+{
+    // A panel of bytes_per_second, fed from buffer in simulated time, which
+    // steps the model from one watermark of band_lines to the next (0: the
+    // whole conversion at once)
+    class SimulatedPanel : public cv::DisplaySink
+    {
+    public:
+        SimulatedPanel(double _bytes_per_second, const uint8_t* _buffer, size_t _buffer_size, size_t _row_bytes, int _band_lines,
+            double _setup_us, double _line_us)
+            : bytes_per_second(_bytes_per_second), buffer(_buffer), buffer_rows(int(_buffer_size / _row_bytes)), row_bytes(_row_bytes),
+              band_lines(_band_lines), setup_us(_setup_us), line_us(_line_us)
+        {
+        }
+
+        void set_window(const cv::Rect& rect) override
+        {
+            received.clear();
+            done_us = now_us = 0;
+            first_us = -1;
+            rows_left = rect.height;
+            chunk_rows = 0;
+            followed = true;
+        }
+
+        void send(const uint8_t* data, size_t size) override
+        {
+            // the flush saw lines once they were ready and it was done with
+            // the last send
+            const int lines = int((data + size - buffer) / row_bytes);
+            followed &= lines == expected;
+            const double start_us = std::max(done_us, std::max(now_us, ready_us(lines)));
+            if (first_us < 0)
+            {
+                first_us = start_us;
+            }
+            done_us = start_us + size / bytes_per_second * 1e6;
+            now_us = start_us;
+            received.insert(received.end(), data, data + size);
+            sent = lines;
+            if (sent < chunk_rows)
+            {
+                // the lines ready by now, else those of the next watermark
+                const int ready = ready_lines(now_us);
+                hold(ready > sent ? ready : next_watermark(sent));
+            }
+        }
+
+        void wait() override
+        {
+            // the stage waits before converting the next rows into the buffer
+            now_us = conversion_us = std::max(now_us, done_us);
+            chunk_rows = std::min(buffer_rows, rows_left);
+            rows_left -= chunk_rows;
+            sent = 0;
+            expected = next_watermark(0);
+            dma2d_emu::set_line_limit(expected < chunk_rows ? expected : -1);
+        }
+
+        std::vector<uint8_t> received;
+        double first_us = -1, done_us = 0;
+        // every send ended at the watermark the model was held at
+        bool followed = true;
+
+    private:
+        double ready_us(int lines) const
+        {
+            return conversion_us + setup_us + lines * line_us;
+        }
+
+        int next_watermark(int lines) const
+        {
+            return band_lines > 0 ? std::min((lines / band_lines + 1) * band_lines, chunk_rows) : chunk_rows;
+        }
+
+        // lines of the watermarks passed by time_us
+        int ready_lines(double time_us) const
+        {
+            int lines = 0;
+            while (lines < chunk_rows && ready_us(next_watermark(lines)) <= time_us)
+            {
+                lines = next_watermark(lines);
+            }
+            return lines;
+        }
+
+        // let the model convert up to lines and wait until it has (all of
+        // them: until it is done), so that the flush sees them and no more
+        // when the send returns
+        void hold(int lines)
+        {
+            expected = lines;
+            dma2d_emu::set_line_limit(lines < chunk_rows ? lines : -1);
+            while (dma2d_fence_lines(dma2d_last_fence()) < lines)
+            {
+                ThisThread::yield();
+            }
+        }
+
+        double bytes_per_second;
+        const uint8_t* buffer;
+        int buffer_rows;
+        size_t row_bytes;
+        int band_lines;
+        double setup_us, line_us;
+        double conversion_us = 0, now_us = 0;
+        int rows_left = 0, chunk_rows = 0, sent = 0, expected = 0;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        std::printf("Usage: %s\n", argv[0]);
+        return 1;
+    }
+    cv::Mat frame(272, 480, cv::RGB332), expected;
+    cv::ASCIIFont font(_default_ascii_font);
+    cv::Painter painter(frame);
+    painter.fill(cv::RGB332_BLACK);
+    painter.rectangle(cv::Point(10, 10), cv::Point(470, 60), cv::RGB332_BLUE, cv::FILLED);
+    painter.circle(cv::Point(120, 170), 80, cv::RGB332_GREEN, 3);
+    painter.putText("Speed 42 km/h", cv::Point(16, 20), font, cv::RGB332_WHITE, cv::RGB332_BLUE);
+    cv::setBlitter(cv::getCpuBlitter());
+    cv::cvtColor(frame, expected, cv::COLOR_RGB332, cv::COLOR_RGB565);
+    cv::setBlitter(nullptr);
+    const size_t frame_bytes = frame.total() * 2, row_bytes = frame.cols * 2;
+    std::vector<uint8_t> buffer(frame_bytes);
+
+    // the modeled conversion, its CLUT loaded already
+    const dma2d_emu::Dma2dTimingModel model = dma2d_emu::timing_model();
+    dma2d_flat_rgb332_to_rgb565(frame, cv::Rect(0, 0, frame.cols, frame.rows), buffer.data());
+    dma2d_emu::reset_stats();
+    dma2d_flat_rgb332_to_rgb565(frame, cv::Rect(0, 0, frame.cols, frame.rows), buffer.data());
+    const double convert_us = dma2d_emu::stats().dma2d_us(model);
+    const double setup_us = model.setup_cycles * 1e6 / model.clock_hz;
+    const double line_us = (convert_us - setup_us) / frame.rows;
+    std::printf("480x272 RGB332 to RGB565 on the DMA2D: %.0f us modeled\n", convert_us);
+
+    // 16-bit panel buses
+    const double rates[] = { 20e6, 40e6, 80e6 };
+    struct
+    {
+        const char* name;
+        size_t buffer_size;
+        int band_lines;
+    } setups[] = {
+        { "frame, converted first", frame_bytes, 0 },
+        { "frame, 8-line bands", frame_bytes, 8 },
+        { "frame, 16-line bands", frame_bytes, 16 },
+        { "frame, 34-line bands", frame_bytes, 34 },
+        { "half, 16-line bands", frame_bytes / 2, 16 },
+    };
+    bool ok = true;
+    std::printf("%9s %-24s %10s %8s %14s %s\n", "bus MB/s", "buffer", "flush us", "saved", "first byte us", "output");
+    for (double rate : rates)
+    {
+        double whole_us = 0;
+        for (const auto& setup : setups)
+        {
+            SimulatedPanel panel(rate, buffer.data(), setup.buffer_size, row_bytes, setup.band_lines, setup_us, line_us);
+            cv::Dma2dFlushStage stage(panel, buffer.data(), setup.buffer_size, setup.band_lines);
+            bool same = stage.flush(frame, cv::Rect(0, 0, frame.cols, frame.rows));
+            dma2d_emu::set_line_limit(-1);
+            same = same && panel.received.size() == frame_bytes && memcmp(panel.received.data(), expected.data, frame_bytes) == 0;
+            if (setup.band_lines == 0)
+            {
+                whole_us = panel.done_us;
+            }
+            // banded flushes must beat converting first
+            const bool faster = setup.band_lines == 0 || setup.buffer_size < frame_bytes || panel.done_us < whole_us;
+            ok &= same && panel.followed && faster;
+            std::printf("%9.0f %-24s %10.1f %7.1f%% %14.1f %s\n", rate / 1e6, setup.name, panel.done_us, (1 - panel.done_us / whole_us) * 100,
+                panel.first_us, !same ? "MISMATCH" : !panel.followed ? "NOT AT WATERMARKS" : faster ? "ok" : "NOT FASTER");
+        }
+    }
+    return ok ? 0 : 1;
+}
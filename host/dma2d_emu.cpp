@@ -0,0 +1,721 @@
+#include "mbed.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace dma2d_emu
+{
+    // input color modes (FGPFCCR/BGPFCCR CM)
+    enum
+    {
+        CM_ARGB8888 = 0, CM_RGB888 = 1, CM_RGB565 = 2, CM_ARGB1555 = 3, CM_ARGB4444 = 4,
+        CM_L8 = 5, CM_AL44 = 6, CM_AL88 = 7, CM_L4 = 8, CM_A8 = 9, CM_A4 = 10
+    };
+
+    static Registers regs;
+    static uint32_t fg_clut[256];
+    static uint32_t bg_clut[256];
+    static Dma2dTimingModel model;
+    static Dma2dStats counters;
+
+    // Asynchronous transfers run on a worker thread. Its state is never
+    // destroyed, the worker may still wait on it when the program exits.
+    struct Worker
+    {
+        std::mutex mutex;
+        std::condition_variable started;
+        bool pending = false;
+        // the pending work is a foreground CLUT load, not a transfer
+        bool clut = false;
+        // from a start until the handler of the last transfer returned
+        bool busy = false;
+        std::condition_variable idle;
+    };
+    static Worker* worker = nullptr;
+    static std::atomic<uintptr_t> irq_vector { 0 };
+    static std::atomic<bool> irq_enabled { false };
+    static std::atomic<bool> paced { false };
+    // line limit of asynchronous transfers, see set_line_limit
+    static std::mutex limit_mutex;
+    static std::condition_variable limit_changed;
+    static int line_limit = -1;
+    static int limit_timeout_ms = 1000;
+    static thread_local bool on_worker = false;
+
+    static constexpr uint32_t INTERRUPT_ENABLES = DMA2D_CR_TEIE | DMA2D_CR_TCIE | DMA2D_CR_CEIE | DMA2D_CR_TWIE;
+    // start of the asynchronous transfer, for pacing
+    static std::chrono::steady_clock::time_point transfer_start;
+
+    static void raise_interrupt();
+    static void start_async(bool clut);
+
+    // D-cache maintenance since the last reset_stats: lines cleaned, and
+    // lines transfers wrote that are still to be invalidated. Maintenance
+    // runs on the CPU and in the handler on the worker thread.
+    struct CacheState
+    {
+        std::mutex mutex;
+        std::unordered_set<uintptr_t> cleaned;
+        bool all_cleaned = false;
+        std::unordered_set<uintptr_t> written;
+        // lines the CPU wrote since they were last cleaned
+        std::unordered_set<uintptr_t> dirty;
+        std::vector<std::pair<uintptr_t, uintptr_t>> non_cacheable;
+    };
+    static CacheState* cache = new CacheState();
+    static constexpr uintptr_t LINE = 32;
+
+    void maintain_dcache(CacheOp op, const volatile void* addr, int32_t size)
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        counters.cache_calls++;
+        counters.cache_cycles += model.cache_call_cycles;
+        if (addr == nullptr)
+        {
+            // set by set and way, through every line of the D-cache
+            const uint64_t lines = uint64_t(model.dcache_bytes) / LINE;
+            counters.cache_lines += lines;
+            counters.cache_cycles += lines * model.cache_line_cycles;
+            if (op & CACHE_CLEAN)
+            {
+                cache->all_cleaned = true;
+                cache->dirty.clear();
+            }
+            if (op & CACHE_INVALIDATE)
+            {
+                cache->written.clear();
+                counters.lost_lines += cache->dirty.size();
+                cache->dirty.clear();
+            }
+            return;
+        }
+        const uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+        for (uintptr_t line = start & ~(LINE - 1); line < start + uintptr_t(std::max(size, 0)); line += LINE)
+        {
+            counters.cache_lines++;
+            counters.cache_cycles += model.cache_line_cycles;
+            if (op & CACHE_CLEAN)
+            {
+                cache->cleaned.insert(line);
+                cache->dirty.erase(line);
+            }
+            if (op & CACHE_INVALIDATE)
+            {
+                cache->written.erase(line);
+                counters.lost_lines += cache->dirty.erase(line);
+            }
+        }
+    }
+
+    void cpu_write(const volatile void* addr, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        const uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+        for (uintptr_t line = start & ~(LINE - 1); line < start + size; line += LINE)
+        {
+            cache->dirty.insert(line);
+        }
+    }
+
+    // check that the lines of bytes at p were cleaned, and remember those a
+    // transfer writes
+    static void access_lines(const uint8_t* p, size_t bytes, bool write)
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        const uintptr_t start = reinterpret_cast<uintptr_t>(p);
+        for (const auto& region : cache->non_cacheable)
+        {
+            if (start >= region.first && start + bytes <= region.second)
+            {
+                return;
+            }
+        }
+        for (uintptr_t line = start & ~(LINE - 1); line < start + bytes; line += LINE)
+        {
+            if (!cache->all_cleaned && cache->cleaned.count(line) == 0)
+            {
+                counters.uncleaned_lines++;
+            }
+            if (write)
+            {
+                cache->written.insert(line);
+            }
+        }
+    }
+
+    // lines written and not invalidated once the handler returned
+    static void check_invalidated()
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        counters.stale_lines += cache->written.size();
+        cache->written.clear();
+    }
+
+    Registers& registers()
+    {
+        return regs;
+    }
+
+    size_t bytes_per_pixel(uint32_t color_mode)
+    {
+        switch (color_mode)
+        {
+        case CM_ARGB8888:
+            return 4;
+        case CM_RGB888:
+            return 3;
+        case CM_RGB565:
+        case CM_ARGB1555:
+        case CM_ARGB4444:
+        case CM_AL88:
+            return 2;
+        case CM_L8:
+        case CM_AL44:
+        case CM_A8:
+            return 1;
+        }
+        return 0;
+    }
+
+    // bits per pixel, also covering the 4-bit modes
+    static uint32_t bits_per_pixel(uint32_t color_mode)
+    {
+        return (color_mode == CM_L4 || color_mode == CM_A4) ? 4 : uint32_t(bytes_per_pixel(color_mode) * 8);
+    }
+
+    static inline uint32_t expand(uint32_t v, int bits)
+    {
+        // replicate the most significant bits like the hardware does
+        return bits == 4 ? v * 0x11 : (v << (8 - bits)) | (v >> (2 * bits - 8));
+    }
+
+    static inline uint32_t argb(uint32_t a, uint32_t r, uint32_t g, uint32_t b)
+    {
+        return (a << 24) | (r << 16) | (g << 8) | b;
+    }
+
+    // read one pixel from a layer as ARGB8888, before alpha mode processing
+    static uint32_t read_pixel(const uint8_t* row, int x, uint32_t pfccr, uint32_t color, const uint32_t* clut)
+    {
+        uint32_t cm = pfccr & DMA2D_FGPFCCR_CM;
+        switch (cm)
+        {
+        case CM_ARGB8888:
+        {
+            uint32_t v;
+            memcpy(&v, row + x * 4, 4);
+            return v;
+        }
+        case CM_RGB888:
+        {
+            const uint8_t* p = row + x * 3;
+            return argb(0xFF, p[2], p[1], p[0]);
+        }
+        case CM_RGB565:
+        {
+            uint16_t v;
+            memcpy(&v, row + x * 2, 2);
+            return argb(0xFF, expand(v >> 11, 5), expand((v >> 5) & 0x3F, 6), expand(v & 0x1F, 5));
+        }
+        case CM_ARGB1555:
+        {
+            uint16_t v;
+            memcpy(&v, row + x * 2, 2);
+            return argb((v & 0x8000) ? 0xFF : 0, expand((v >> 10) & 0x1F, 5), expand((v >> 5) & 0x1F, 5), expand(v & 0x1F, 5));
+        }
+        case CM_ARGB4444:
+        {
+            uint16_t v;
+            memcpy(&v, row + x * 2, 2);
+            return argb(expand(v >> 12, 4), expand((v >> 8) & 0xF, 4), expand((v >> 4) & 0xF, 4), expand(v & 0xF, 4));
+        }
+        case CM_L8:
+            return clut[row[x]];
+        case CM_AL44:
+            return (clut[row[x] & 0xF] & 0x00FFFFFF) | (expand(row[x] >> 4, 4) << 24);
+        case CM_AL88:
+            return (clut[row[x * 2]] & 0x00FFFFFF) | (uint32_t(row[x * 2 + 1]) << 24);
+        case CM_L4:
+            // the pixel at the lower address is held in the low nibble
+            return clut[(row[x / 2] >> ((x & 1) * 4)) & 0xF];
+        case CM_A8:
+            return (color & 0x00FFFFFF) | (uint32_t(row[x]) << 24);
+        case CM_A4:
+            return (color & 0x00FFFFFF) | (expand((row[x / 2] >> ((x & 1) * 4)) & 0xF, 4) << 24);
+        }
+        return 0;
+    }
+
+    static uint32_t apply_alpha_mode(uint32_t pixel, uint32_t pfccr)
+    {
+        uint32_t alpha = pfccr >> 24;
+        switch ((pfccr & DMA2D_FGPFCCR_AM) >> 16)
+        {
+        case 1:
+            return (pixel & 0x00FFFFFF) | (alpha << 24);
+        case 2:
+            return (pixel & 0x00FFFFFF) | (((pixel >> 24) * alpha / 255) << 24);
+        }
+        return pixel;
+    }
+
+    // write one ARGB8888 pixel in an output color mode
+    static void write_pixel(uint8_t* row, int x, uint32_t cm, uint32_t pixel)
+    {
+        uint32_t a = pixel >> 24, r = (pixel >> 16) & 0xFF, g = (pixel >> 8) & 0xFF, b = pixel & 0xFF;
+        switch (cm)
+        {
+        case CM_ARGB8888:
+            memcpy(row + x * 4, &pixel, 4);
+            break;
+        case CM_RGB888:
+            row[x * 3] = uint8_t(b);
+            row[x * 3 + 1] = uint8_t(g);
+            row[x * 3 + 2] = uint8_t(r);
+            break;
+        case CM_RGB565:
+        {
+            uint16_t v = uint16_t(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            memcpy(row + x * 2, &v, 2);
+            break;
+        }
+        case CM_ARGB1555:
+        {
+            uint16_t v = uint16_t(((a >> 7) << 15) | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3));
+            memcpy(row + x * 2, &v, 2);
+            break;
+        }
+        case CM_ARGB4444:
+        {
+            uint16_t v = uint16_t(((a >> 4) << 12) | ((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4));
+            memcpy(row + x * 2, &v, 2);
+            break;
+        }
+        }
+    }
+
+    // blend a foreground pixel over a background pixel, both ARGB8888
+    static uint32_t blend_pixel(uint32_t fg, uint32_t bg)
+    {
+        uint32_t fa = fg >> 24, ba = bg >> 24;
+        uint32_t mult = fa * ba / 255;
+        uint32_t out_a = fa + ba - mult;
+        if (out_a == 0)
+        {
+            return 0;
+        }
+        uint32_t result = out_a << 24;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            uint32_t fc = (fg >> shift) & 0xFF, bc = (bg >> shift) & 0xFF;
+            uint32_t c = (fc * fa + bc * ba - bc * mult) / out_a;
+            result |= std::min<uint32_t>(c, 255) << shift;
+        }
+        return result;
+    }
+
+    static void load_clut(uint32_t pfccr, uintptr_t cmar, uint32_t* clut)
+    {
+        uint32_t entries = ((pfccr & DMA2D_FGPFCCR_CS) >> 8) + 1;
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(cmar);
+        if (src == nullptr)
+        {
+            counters.config_errors++;
+            regs.ISR.value |= DMA2D_ISR_CEIF;
+            return;
+        }
+        access_lines(src, entries * ((pfccr & DMA2D_FGPFCCR_CCM) ? 3 : 4), false);
+        for (uint32_t i = 0; i < entries; i++)
+        {
+            if (pfccr & DMA2D_FGPFCCR_CCM)
+            {
+                clut[i] = argb(0xFF, src[i * 3 + 2], src[i * 3 + 1], src[i * 3]);
+            }
+            else
+            {
+                memcpy(&clut[i], src + i * 4, 4);
+            }
+        }
+        counters.clut_loads++;
+        counters.dma2d_cycles += entries * model.clut_cycles_per_entry;
+        counters.bytes_read += entries * ((pfccr & DMA2D_FGPFCCR_CCM) ? 3 : 4);
+        regs.ISR.value |= DMA2D_ISR_CTCIF;
+    }
+
+    static void on_fgpfccr_write()
+    {
+        if ((regs.FGPFCCR.value & DMA2D_FGPFCCR_START) && (regs.CR.value & DMA2D_CR_CTCIE))
+        {
+            start_async(true);
+        }
+        else if (regs.FGPFCCR.value & DMA2D_FGPFCCR_START)
+        {
+            load_clut(regs.FGPFCCR.value, regs.FGCMAR.value, fg_clut);
+            regs.FGPFCCR.value &= ~DMA2D_FGPFCCR_START;
+        }
+    }
+
+    static void on_bgpfccr_write()
+    {
+        if (regs.BGPFCCR.value & DMA2D_BGPFCCR_START)
+        {
+            load_clut(regs.BGPFCCR.value, regs.BGCMAR.value, bg_clut);
+            regs.BGPFCCR.value &= ~DMA2D_BGPFCCR_START;
+        }
+    }
+
+    // wait until line y is below the line limit, or the limit times out
+    static void wait_line_limit(int y)
+    {
+        std::unique_lock<std::mutex> lock(limit_mutex);
+        const auto timeout = std::chrono::milliseconds(limit_timeout_ms);
+        while (line_limit >= 0 && y >= line_limit)
+        {
+            if (limit_changed.wait_for(lock, timeout) == std::cv_status::timeout && line_limit >= 0 && y >= line_limit)
+            {
+                line_limit = -1;
+            }
+        }
+    }
+
+    static bool run_transfer()
+    {
+        const uint32_t mode = (regs.CR.value & DMA2D_CR_MODE) >> 16;
+        const int width = int((regs.NLR.value >> 16) & 0x3FFF);
+        const int height = int(regs.NLR.value & 0xFFFF);
+        const uint32_t fg_cm = regs.FGPFCCR.value & DMA2D_FGPFCCR_CM;
+        const uint32_t bg_cm = regs.BGPFCCR.value & DMA2D_BGPFCCR_CM;
+        const uint32_t out_cm = regs.OPFCCR.value & 0x7;
+        uint8_t* out = reinterpret_cast<uint8_t*>(regs.OMAR.value);
+        const uint8_t* fg = reinterpret_cast<const uint8_t*>(regs.FGMAR.value);
+        const uint8_t* bg = reinterpret_cast<const uint8_t*>(regs.BGMAR.value);
+
+        if (width == 0 || height == 0 || out == nullptr || (mode != MODE_R2M && fg == nullptr) ||
+            (mode == MODE_M2M_BLEND && bg == nullptr) || bits_per_pixel(fg_cm) == 0)
+        {
+            return false;
+        }
+
+        // Output mode 5 (L8) is not documented for OPFCCR, dma2d_fill uses it
+        // for 8-bit register-to-memory fills; it is emulated as a byte fill.
+        const size_t out_bpp = (mode == MODE_M2M) ? bytes_per_pixel(fg_cm) : (out_cm == CM_L8 ? 1 : bytes_per_pixel(out_cm));
+        const bool out_cm_valid = out_cm <= CM_ARGB4444 || (out_cm == CM_L8 && mode == MODE_R2M);
+        if (out_bpp == 0 || (mode != MODE_M2M && !out_cm_valid))
+        {
+            return false;
+        }
+
+        const size_t out_stride = (width + (regs.OOR.value & 0xFFFF)) * out_bpp;
+        const size_t fg_stride = (size_t(width) + (regs.FGOR.value & 0xFFFF)) * bits_per_pixel(fg_cm) / 8;
+        const size_t bg_stride = (size_t(width) + (regs.BGOR.value & 0xFFFF)) * bits_per_pixel(bg_cm) / 8;
+
+        for (int y = 0; y < height; y++)
+        {
+            if (mode != MODE_R2M)
+            {
+                access_lines(fg + y * fg_stride, (size_t(width) * bits_per_pixel(fg_cm) + 7) / 8, false);
+            }
+            if (mode == MODE_M2M_BLEND)
+            {
+                access_lines(bg + y * bg_stride, (size_t(width) * bits_per_pixel(bg_cm) + 7) / 8, false);
+            }
+            access_lines(out + y * out_stride, width * out_bpp, true);
+        }
+        // cost of the transfer
+        const uint64_t pixels = uint64_t(width) * height;
+        uint64_t bytes_read = 0;
+        if (mode != MODE_R2M)
+        {
+            bytes_read += pixels * bits_per_pixel(fg_cm) / 8;
+        }
+        if (mode == MODE_M2M_BLEND)
+        {
+            bytes_read += pixels * bits_per_pixel(bg_cm) / 8;
+        }
+        const uint64_t bytes_written = pixels * out_bpp;
+        double pipeline_cycles = 0;
+        double cpu_cycles = model.cpu_call_cycles + height * model.cpu_line_cycles;
+        switch (mode)
+        {
+        case MODE_R2M:
+            cpu_cycles += bytes_written / model.cpu_store_bytes_per_cycle;
+            break;
+        case MODE_M2M:
+            cpu_cycles += bytes_written / model.cpu_copy_bytes_per_cycle;
+            break;
+        case MODE_M2M_PFC:
+            pipeline_cycles = pixels * model.pfc_cycles_per_pixel;
+            cpu_cycles += pixels * model.cpu_convert_cycles_per_pixel;
+            break;
+        case MODE_M2M_BLEND:
+            pipeline_cycles = pixels * model.blend_cycles_per_pixel;
+            cpu_cycles += pixels * model.cpu_blend_cycles_per_pixel;
+            break;
+        }
+        const double bus_cycles = (bytes_read + bytes_written) / model.bus_bytes_per_cycle;
+        const double line_cycles = model.line_cycles + std::max(pipeline_cycles, bus_cycles) / height;
+
+        for (int y = 0; y < height; y++)
+        {
+            if (on_worker)
+            {
+                wait_line_limit(y);
+            }
+            uint8_t* out_row = out + y * out_stride;
+            switch (mode)
+            {
+            case MODE_R2M:
+                for (int x = 0; x < width; x++)
+                {
+                    memcpy(out_row + x * out_bpp, &regs.OCOLR.value, out_bpp);
+                }
+                break;
+            case MODE_M2M:
+                memcpy(out_row, fg + y * fg_stride, width * out_bpp);
+                break;
+            case MODE_M2M_PFC:
+                for (int x = 0; x < width; x++)
+                {
+                    uint32_t pixel = apply_alpha_mode(read_pixel(fg + y * fg_stride, x, regs.FGPFCCR.value, regs.FGCOLR.value, fg_clut), regs.FGPFCCR.value);
+                    write_pixel(out_row, x, out_cm, pixel);
+                }
+                break;
+            case MODE_M2M_BLEND:
+                for (int x = 0; x < width; x++)
+                {
+                    uint32_t fg_pixel = apply_alpha_mode(read_pixel(fg + y * fg_stride, x, regs.FGPFCCR.value, regs.FGCOLR.value, fg_clut), regs.FGPFCCR.value);
+                    uint32_t bg_pixel = apply_alpha_mode(read_pixel(bg + y * bg_stride, x, regs.BGPFCCR.value, regs.BGCOLR.value, bg_clut), regs.BGPFCCR.value);
+                    write_pixel(out_row, x, out_cm, blend_pixel(fg_pixel, bg_pixel));
+                }
+                break;
+            }
+            // line watermark: once LWR lines are written, at their modeled
+            // time when paced; the handler may move LWR further
+            if ((regs.CR.value & DMA2D_CR_TWIE) && uint32_t(y + 1) == (regs.LWR.value & 0xFFFF))
+            {
+                if (paced)
+                {
+                    const double cycles = model.setup_cycles + (y + 1) * line_cycles;
+                    std::this_thread::sleep_until(transfer_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(cycles / model.clock_hz)));
+                }
+                regs.ISR.value |= DMA2D_ISR_TWIF;
+                raise_interrupt();
+            }
+        }
+
+        // account the transfer
+        counters.transfers++;
+        counters.transfers_by_mode[mode]++;
+        counters.pixels += pixels;
+        counters.bytes_read += bytes_read;
+        counters.bytes_written += bytes_written;
+        counters.dma2d_cycles += model.setup_cycles + height * model.line_cycles + std::max(pipeline_cycles, bus_cycles);
+        counters.cpu_cycles += cpu_cycles;
+        return true;
+    }
+
+    static void finish_transfer()
+    {
+        if (run_transfer())
+        {
+            regs.ISR.value |= DMA2D_ISR_TCIF;
+        }
+        else
+        {
+            counters.config_errors++;
+            regs.ISR.value |= DMA2D_ISR_CEIF;
+        }
+        regs.CR.value &= ~DMA2D_CR_START;
+    }
+
+    // call the handler if an enabled interrupt flag is set
+    static void raise_interrupt()
+    {
+        const uint32_t cr = regs.CR.value, isr = regs.ISR.value;
+        const bool raised = ((cr & DMA2D_CR_TCIE) && (isr & DMA2D_ISR_TCIF)) || ((cr & DMA2D_CR_TEIE) && (isr & DMA2D_ISR_TEIF)) ||
+            ((cr & DMA2D_CR_CEIE) && (isr & DMA2D_ISR_CEIF)) || ((cr & DMA2D_CR_TWIE) && (isr & DMA2D_ISR_TWIF)) ||
+            ((cr & DMA2D_CR_CTCIE) && (isr & DMA2D_ISR_CTCIF)) || ((cr & DMA2D_CR_CAEIE) && (isr & DMA2D_ISR_CAEIF));
+        if (raised && irq_enabled && irq_vector != 0)
+        {
+            core_util_interrupt_enter();
+            reinterpret_cast<void (*)()>(uintptr_t(irq_vector))();
+            core_util_interrupt_exit();
+        }
+    }
+
+    static void worker_loop()
+    {
+        on_worker = true;
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        for (;;)
+        {
+            worker->started.wait(lock, [] { return worker->pending; });
+            const bool clut = worker->clut;
+            lock.unlock();
+            transfer_start = std::chrono::steady_clock::now();
+            const double cycles = counters.dma2d_cycles;
+            if (clut)
+            {
+                load_clut(regs.FGPFCCR.value, regs.FGCMAR.value, fg_clut);
+                regs.FGPFCCR.value &= ~DMA2D_FGPFCCR_START;
+            }
+            else
+            {
+                finish_transfer();
+            }
+            if (paced)
+            {
+                std::this_thread::sleep_until(transfer_start + std::chrono::duration<double>((counters.dma2d_cycles - cycles) / model.clock_hz));
+            }
+            lock.lock();
+            worker->pending = false;
+            lock.unlock();
+            // the handler may start the transfer after the CLUT load, or
+            // the next one
+            raise_interrupt();
+            check_invalidated();
+            lock.lock();
+            if (!worker->pending)
+            {
+                worker->busy = false;
+                worker->idle.notify_all();
+            }
+        }
+    }
+
+    static void start_async(bool clut)
+    {
+        if (worker == nullptr)
+        {
+            worker = new Worker();
+            std::thread(worker_loop).detach();
+        }
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (!worker->pending)
+        {
+            worker->pending = true;
+            worker->clut = clut;
+            worker->busy = true;
+            worker->started.notify_one();
+        }
+    }
+
+    static void on_cr_write()
+    {
+        if (regs.CR.value & DMA2D_CR_START)
+        {
+            if (regs.CR.value & INTERRUPT_ENABLES)
+            {
+                start_async(false);
+            }
+            else
+            {
+                finish_transfer();
+            }
+        }
+    }
+
+    void register_written(const void* reg)
+    {
+        if (reg == &regs.CR)
+        {
+            on_cr_write();
+        }
+        else if (reg == &regs.FGPFCCR)
+        {
+            on_fgpfccr_write();
+        }
+        else if (reg == &regs.BGPFCCR)
+        {
+            on_bgpfccr_write();
+        }
+        else if (reg == &regs.IFCR)
+        {
+            regs.ISR.value &= ~regs.IFCR.value;
+            regs.IFCR.value = 0;
+        }
+    }
+
+    void reset()
+    {
+        Registers& r = regs;
+        r.CR.value = r.ISR.value = r.IFCR.value = 0;
+        r.FGMAR.value = r.BGMAR.value = r.FGCMAR.value = r.BGCMAR.value = r.OMAR.value = 0;
+        r.FGOR.value = r.BGOR.value = r.FGPFCCR.value = r.FGCOLR.value = r.BGPFCCR.value = r.BGCOLR.value = 0;
+        r.OPFCCR.value = r.OCOLR.value = r.OOR.value = r.NLR.value = r.LWR.value = r.AMTCR.value = 0;
+        // nothing of the CLUTs is kept for the driver to rely on
+        memset(fg_clut, 0, sizeof(fg_clut));
+        memset(bg_clut, 0, sizeof(bg_clut));
+    }
+
+    void set_paced(bool _paced)
+    {
+        paced = _paced;
+    }
+
+    void set_line_limit(int lines, int timeout_ms)
+    {
+        std::lock_guard<std::mutex> lock(limit_mutex);
+        line_limit = lines;
+        limit_timeout_ms = timeout_ms;
+        limit_changed.notify_all();
+    }
+
+    void set_vector(int, uintptr_t vector)
+    {
+        irq_vector = vector;
+    }
+
+    void enable_irq(int, bool enable)
+    {
+        irq_enabled = enable;
+    }
+
+    void set_timing_model(const Dma2dTimingModel& _model)
+    {
+        model = _model;
+    }
+
+    const Dma2dTimingModel& timing_model()
+    {
+        return model;
+    }
+
+    void wait_idle()
+    {
+        if (worker == nullptr)
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        worker->idle.wait(lock, [] { return !worker->busy; });
+    }
+
+    void set_non_cacheable(const volatile void* addr, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        const uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+        cache->non_cacheable.emplace_back(start, start + size);
+    }
+
+    const Dma2dStats& stats()
+    {
+        return counters;
+    }
+
+    void reset_stats()
+    {
+        counters = Dma2dStats();
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->cleaned.clear();
+        cache->all_cleaned = false;
+        cache->written.clear();
+        cache->dirty.clear();
+    }
+}
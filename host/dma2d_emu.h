@@ -0,0 +1,237 @@
+#pragma once
+
+// Register-level software model of the STM32 DMA2D peripheral for the host build.
+//
+// The registers are laid out with the CMSIS names used by src/dma2d.cpp, so the
+// driver code runs unchanged: setting CR.START runs the programmed transfer,
+// setting FGPFCCR.START / BGPFCCR.START loads the CLUT (the foreground one on
+// the worker thread below, raising CTCIF, when CR.CTCIE is set). Supported
+// modes are register-to-memory, memory-to-memory, memory-to-memory with pixel
+// format conversion (including L8/L4 with an ARGB8888 or RGB888 CLUT) and
+// memory-to-memory with blending.
+//
+// A transfer started with an interrupt enable bit set in CR (TCIE, TEIE,
+// CEIE or TWIE) runs on a worker thread instead, like the hardware runs
+// beside the CPU: CR.START stays set until it completes, then ISR is updated
+// and the handler installed with NVIC_SetVector is called on the worker
+// thread within core_util_interrupt_enter/exit, which critical sections mask
+// like they mask interrupts on the target. With TWIE the handler is also
+// called once the transfer has written LWR lines, the transfer going on
+// after it returns.
+//
+// Every transfer is also costed by Dma2dTimingModel, together with what the
+// same operation would cost on the CPU, so benchmarks can estimate the gain of
+// the accelerated paths without hardware.
+//
+// The CMSIS D-cache maintenance functions (SCB_*DCache*) are provided too,
+// with __DCACHE_PRESENT, so the driver's cache maintenance runs. The model
+// keeps no cache: it counts the maintained lines and checks that every line
+// a transfer (or a CLUT load) reads or writes was cleaned before, and that
+// every line a transfer writes is invalidated by the time its interrupt
+// handler returns. CPU writes reported with cpu_write leave their lines
+// dirty until cleaned; invalidating them before counts them as lost.
+
+#include <cstdint>
+#include <cstddef>
+
+namespace dma2d_emu
+{
+    // called after every register write
+    void register_written(const void* reg);
+
+    // A peripheral register. Writes are forwarded to the emulator so that
+    // START bits take effect like on the hardware.
+    template<typename T>
+    class Register
+    {
+    public:
+        Register& operator = (T v) { value = v; written(); return *this; }
+        Register& operator |= (T v) { value |= v; written(); return *this; }
+        Register& operator &= (T v) { value &= v; written(); return *this; }
+        operator T() const { return value; }
+
+        T value = 0;
+
+    private:
+        void written() { register_written(this); }
+    };
+
+    // Address registers are pointer sized so the model works on 64-bit hosts.
+    struct Registers
+    {
+        Register<uint32_t> CR;
+        Register<uint32_t> ISR;
+        Register<uint32_t> IFCR;
+        Register<uintptr_t> FGMAR;
+        Register<uint32_t> FGOR;
+        Register<uintptr_t> BGMAR;
+        Register<uint32_t> BGOR;
+        Register<uint32_t> FGPFCCR;
+        Register<uint32_t> FGCOLR;
+        Register<uint32_t> BGPFCCR;
+        Register<uint32_t> BGCOLR;
+        Register<uintptr_t> FGCMAR;
+        Register<uintptr_t> BGCMAR;
+        Register<uint32_t> OPFCCR;
+        Register<uint32_t> OCOLR;
+        Register<uintptr_t> OMAR;
+        Register<uint32_t> OOR;
+        Register<uint32_t> NLR;
+        Register<uint32_t> LWR;
+        Register<uint32_t> AMTCR;
+    };
+
+    enum Mode { MODE_M2M = 0, MODE_M2M_PFC = 1, MODE_M2M_BLEND = 2, MODE_R2M = 3 };
+
+    // Cost model of the peripheral and of the CPU code it replaces.
+    // Defaults are rough figures for a 216 MHz Cortex-M7 with a 16-bit SDRAM
+    // framebuffer; adjust them to the board being estimated.
+    struct Dma2dTimingModel
+    {
+        double clock_hz = 216e6;                // AHB / core clock
+        double setup_cycles = 80;               // register programming and start
+        double line_cycles = 4;                 // per-line address update
+        double bus_bytes_per_cycle = 1.6;       // sustained framebuffer throughput
+        double pfc_cycles_per_pixel = 1;        // pixel format converter
+        double blend_cycles_per_pixel = 2;      // blender
+        double clut_cycles_per_entry = 1;       // CLUT load
+        double cpu_call_cycles = 20;            // CPU fallback: call and loop setup
+        double cpu_line_cycles = 10;            // CPU fallback: per-line overhead
+        double cpu_store_bytes_per_cycle = 1.0; // CPU fallback: fill store rate
+        double cpu_copy_bytes_per_cycle = 0.5;  // CPU fallback: copy rate (load + store)
+        double cpu_convert_cycles_per_pixel = 4; // CPU fallback: LUT conversion
+        double cpu_blend_cycles_per_pixel = 12; // CPU fallback: software blend
+        double dcache_bytes = 16384;            // D-cache size, for whole-cache maintenance
+        double cache_call_cycles = 12;          // D-cache maintenance call, barriers included
+        double cache_line_cycles = 3;           // D-cache maintenance per line
+    };
+
+    // Accumulated activity since the last reset_stats()
+    struct Dma2dStats
+    {
+        uint32_t transfers = 0;
+        uint32_t transfers_by_mode[4] = { 0, 0, 0, 0 };
+        uint32_t clut_loads = 0;
+        uint32_t config_errors = 0;
+        uint64_t pixels = 0;
+        uint64_t bytes_read = 0;
+        uint64_t bytes_written = 0;
+        double dma2d_cycles = 0;       // estimated peripheral cycles
+        double cpu_cycles = 0;         // estimated cycles of the CPU fallbacks
+        uint32_t cache_calls = 0;      // D-cache maintenance calls
+        uint64_t cache_lines = 0;      // lines they went through, all of the D-cache for whole-cache ones
+        uint64_t uncleaned_lines = 0;  // lines read or written by the DMA2D without being cleaned before
+        uint64_t stale_lines = 0;      // lines written by a transfer and not invalidated after it
+        uint64_t lost_lines = 0;       // lines holding CPU writes invalidated without being cleaned
+        double cache_cycles = 0;       // estimated CPU cycles of the D-cache maintenance
+
+        double dma2d_us(const Dma2dTimingModel& model) const { return dma2d_cycles * 1e6 / model.clock_hz; }
+        double cpu_us(const Dma2dTimingModel& model) const { return cpu_cycles * 1e6 / model.clock_hz; }
+        double cache_us(const Dma2dTimingModel& model) const { return cache_cycles * 1e6 / model.clock_hz; }
+    };
+
+    Registers& registers();
+
+    // peripheral reset (RCC force reset)
+    void reset();
+
+    void set_timing_model(const Dma2dTimingModel& model);
+
+    const Dma2dTimingModel& timing_model();
+
+    const Dma2dStats& stats();
+
+    void reset_stats();
+
+    // wait until the interrupt handler of the last asynchronous transfer has
+    // returned, its cache checks counted
+    void wait_idle();
+
+    // Asynchronous transfers take their modeled DMA2D time in wall-clock
+    // time when paced, so overlap with CPU work can be measured; off by default
+    void set_paced(bool paced);
+
+    // Asynchronous transfers wait before writing output line lines (from 0)
+    // until the limit is moved on; lines < 0 lifts it. A limit left in place
+    // for timeout_ms of wall-clock time is lifted too. Lets a benchmark hold
+    // a transfer at a line watermark until its simulated time has come.
+    void set_line_limit(int lines, int timeout_ms = 1000);
+
+    // interrupt vector and enable of the DMA2D interrupt
+    void set_vector(int irq, uintptr_t vector);
+    void enable_irq(int irq, bool enable);
+
+    // bytes per pixel of a DMA2D color mode, 0 for the 4-bit modes
+    size_t bytes_per_pixel(uint32_t color_mode);
+
+    enum CacheOp { CACHE_CLEAN = 1, CACHE_INVALIDATE = 2, CACHE_CLEAN_INVALIDATE = 3 };
+
+    // D-cache maintenance of the lines of size bytes at addr, of the whole
+    // D-cache if addr is nullptr
+    void maintain_dcache(CacheOp op, const volatile void* addr, int32_t size);
+
+    // the CPU wrote size bytes at addr through the D-cache
+    void cpu_write(const volatile void* addr, size_t size);
+
+    // memory the MPU would map non-cacheable, not checked
+    void set_non_cacheable(const volatile void* addr, size_t size);
+}
+
+#define __DCACHE_PRESENT 1U
+
+inline void SCB_CleanDCache_by_Addr(volatile void* addr, int32_t size) { ::dma2d_emu::maintain_dcache(::dma2d_emu::CACHE_CLEAN, addr, size); }
+inline void SCB_InvalidateDCache_by_Addr(volatile void* addr, int32_t size) { ::dma2d_emu::maintain_dcache(::dma2d_emu::CACHE_INVALIDATE, addr, size); }
+inline void SCB_CleanInvalidateDCache_by_Addr(volatile void* addr, int32_t size) { ::dma2d_emu::maintain_dcache(::dma2d_emu::CACHE_CLEAN_INVALIDATE, addr, size); }
+inline void SCB_CleanDCache() { ::dma2d_emu::maintain_dcache(::dma2d_emu::CACHE_CLEAN, nullptr, 0); }
+inline void SCB_CleanInvalidateDCache() { ::dma2d_emu::maintain_dcache(::dma2d_emu::CACHE_CLEAN_INVALIDATE, nullptr, 0); }
+
+#define DMA2D (&::dma2d_emu::registers())
+
+#define DMA2D_CR_START          (1UL << 0)
+#define DMA2D_CR_SUSP           (1UL << 1)
+#define DMA2D_CR_ABORT          (1UL << 2)
+#define DMA2D_CR_TEIE           (1UL << 8)
+#define DMA2D_CR_TCIE           (1UL << 9)
+#define DMA2D_CR_TWIE           (1UL << 10)
+#define DMA2D_CR_CAEIE          (1UL << 11)
+#define DMA2D_CR_CTCIE          (1UL << 12)
+#define DMA2D_CR_CEIE           (1UL << 13)
+#define DMA2D_CR_MODE           (3UL << 16)
+
+#define DMA2D_ISR_TEIF          (1UL << 0)
+#define DMA2D_ISR_TCIF          (1UL << 1)
+#define DMA2D_ISR_TWIF          (1UL << 2)
+#define DMA2D_ISR_CAEIF         (1UL << 3)
+#define DMA2D_ISR_CTCIF         (1UL << 4)
+#define DMA2D_ISR_CEIF          (1UL << 5)
+
+#define DMA2D_IFCR_CTEIF        DMA2D_ISR_TEIF
+#define DMA2D_IFCR_CTCIF        DMA2D_ISR_TCIF
+#define DMA2D_IFCR_CTWIF        DMA2D_ISR_TWIF
+#define DMA2D_IFCR_CAECIF       DMA2D_ISR_CAEIF
+#define DMA2D_IFCR_CCTCIF       DMA2D_ISR_CTCIF
+#define DMA2D_IFCR_CCEIF        DMA2D_ISR_CEIF
+
+#define DMA2D_FGPFCCR_CM        (0xFUL << 0)
+#define DMA2D_FGPFCCR_CCM       (1UL << 4)
+#define DMA2D_FGPFCCR_START     (1UL << 5)
+#define DMA2D_FGPFCCR_CS        (0xFFUL << 8)
+#define DMA2D_FGPFCCR_AM        (3UL << 16)
+#define DMA2D_FGPFCCR_ALPHA     (0xFFUL << 24)
+
+#define DMA2D_BGPFCCR_CM        DMA2D_FGPFCCR_CM
+#define DMA2D_BGPFCCR_CCM       DMA2D_FGPFCCR_CCM
+#define DMA2D_BGPFCCR_START     DMA2D_FGPFCCR_START
+#define DMA2D_BGPFCCR_CS        DMA2D_FGPFCCR_CS
+#define DMA2D_BGPFCCR_AM        DMA2D_FGPFCCR_AM
+#define DMA2D_BGPFCCR_ALPHA     DMA2D_FGPFCCR_ALPHA
+
+#define DMA2D_IRQn                      90
+#define NVIC_SetVector(irq, vector)     ::dma2d_emu::set_vector(irq, vector)
+#define NVIC_EnableIRQ(irq)             ::dma2d_emu::enable_irq(irq, true)
+#define NVIC_DisableIRQ(irq)            ::dma2d_emu::enable_irq(irq, false)
+
+#define __HAL_RCC_DMA2D_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_DMA2D_CLK_DISABLE()   do { } while (0)
+#define __HAL_RCC_DMA2D_FORCE_RESET()   ::dma2d_emu::reset()
+#define __HAL_RCC_DMA2D_RELEASE_RESET() do { } while (0)
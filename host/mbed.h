@@ -0,0 +1,123 @@
+#pragma once
+
+// Minimal stand-in for Mbed OS's mbed.h, used by the host (Linux) build only.
+// It provides just enough of the platform for the sources in src/ to compile
+// and run off-target: the C/C++ standard headers mbed.h pulls in, the rtos
+// ThisThread API, mbed::Callback, critical sections, the microsecond ticker
+// and the global using-directives mbed.h applies by default.
+// With CVCORE_DMA2D_EMULATION defined, the DMA2D peripheral is provided by the
+// software model in dma2d_emu.h.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#if defined(CVCORE_DMA2D_EMULATION)
+#include "dma2d_emu.h"
+#endif
+
+namespace mbed
+{
+    // Callback holds any callable here; Mbed's own is limited to small ones
+    template<typename F>
+    class Callback;
+
+    template<typename R, typename... Args>
+    class Callback<R(Args...)> : public std::function<R(Args...)>
+    {
+    public:
+        using std::function<R(Args...)>::function;
+    };
+}
+
+// Interrupts are masked through a lock that the emulated peripherals hold
+// while they run an interrupt handler
+inline std::recursive_mutex& core_util_interrupt_lock()
+{
+    static std::recursive_mutex* lock = new std::recursive_mutex();
+    return *lock;
+}
+
+// Interrupts waiting for the lock. A critical section entered outside of
+// another lets them in first, as the CPU takes a pending interrupt between
+// two critical sections, so polling in critical sections cannot starve them.
+inline std::atomic<int>& core_util_interrupts_pending()
+{
+    static std::atomic<int> pending { 0 };
+    return pending;
+}
+
+// critical sections the thread is in
+inline int& core_util_critical_section_depth()
+{
+    thread_local int depth = 0;
+    return depth;
+}
+
+inline void core_util_critical_section_enter()
+{
+    if (core_util_critical_section_depth() == 0)
+    {
+        while (core_util_interrupts_pending() > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    core_util_interrupt_lock().lock();
+    core_util_critical_section_depth()++;
+}
+
+inline void core_util_critical_section_exit()
+{
+    core_util_critical_section_depth()--;
+    core_util_interrupt_lock().unlock();
+}
+
+// entry and exit of an emulated interrupt handler
+inline void core_util_interrupt_enter()
+{
+    core_util_interrupts_pending()++;
+    core_util_interrupt_lock().lock();
+    core_util_interrupts_pending()--;
+    core_util_critical_section_depth()++;
+}
+
+inline void core_util_interrupt_exit()
+{
+    core_util_critical_section_exit();
+}
+
+// microsecond ticker of the HAL, wrapping every 71 minutes
+inline uint32_t us_ticker_read()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+namespace rtos
+{
+    namespace ThisThread
+    {
+        inline void yield()
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+using namespace mbed;
+using namespace std;
+using namespace rtos;
@@ -0,0 +1,54 @@
+#include "mock_display_sink.h"
+
+MockDisplaySink::MockDisplaySink(double _bytes_per_second)
+    : bytes_per_second(_bytes_per_second)
+{
+}
+
+void MockDisplaySink::set_window(const cv::Rect& rect)
+{
+    wait();
+    current_window = rect;
+    window_count++;
+    received_bytes.clear();
+}
+
+void MockDisplaySink::send(const uint8_t* data, size_t size)
+{
+    wait();
+    clock::time_point now = clock::now();
+    if (transfer_count == 0)
+    {
+        first_send = now;
+    }
+    transfer_count++;
+    total_byte_count += size;
+    pending_data = data;
+    pending_size = size;
+    pending_done = now + std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(bytes_per_second > 0 ? size / bytes_per_second : 0.0));
+}
+
+void MockDisplaySink::wait()
+{
+    if (pending_data == nullptr)
+    {
+        return;
+    }
+    // spin rather than sleep: transfers last tens of microseconds
+    while (clock::now() < pending_done)
+    {
+    }
+    received_bytes.insert(received_bytes.end(), pending_data, pending_data + pending_size);
+    last_done = pending_done;
+    pending_data = nullptr;
+}
+
+void MockDisplaySink::reset()
+{
+    wait();
+    received_bytes.clear();
+    transfer_count = 0;
+    total_byte_count = 0;
+    window_count = 0;
+}
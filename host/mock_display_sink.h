@@ -0,0 +1,54 @@
+#pragma once
+
+// DisplaySink stand-in for the host build.
+//
+// Models an SPI panel link of a given byte rate: send() returns at once and
+// the transfer "completes" when the wire time of its bytes has passed, as a
+// DMA-driven transfer would. The bytes are taken when the transfer completes,
+// so a flush that touches a buffer still in flight shows up in the received
+// pixels. Timestamps of the first byte and the last completion are recorded
+// for throughput and latency measurements.
+
+#include "cvdisplay.h"
+#include <chrono>
+
+class MockDisplaySink : public cv::DisplaySink
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    // bytes_per_second 0 completes transfers immediately
+    explicit MockDisplaySink(double bytes_per_second);
+
+    void set_window(const cv::Rect& rect) override;
+    void send(const uint8_t* data, size_t size) override;
+    void wait() override;
+
+    // forget the received pixels and timestamps
+    void reset();
+
+    // the window of the last set_window and the bytes received into it
+    const cv::Rect& window() const { return current_window; }
+    const std::vector<uint8_t>& received() const { return received_bytes; }
+
+    size_t transfers() const { return transfer_count; }
+    // bytes sent and windows set since reset()
+    size_t total_bytes() const { return total_byte_count; }
+    size_t windows() const { return window_count; }
+    // start of the first send() and completion of the last transfer since reset()
+    clock::time_point first_send_time() const { return first_send; }
+    clock::time_point last_done_time() const { return last_done; }
+
+private:
+    double bytes_per_second;
+    cv::Rect current_window;
+    std::vector<uint8_t> received_bytes;
+    const uint8_t* pending_data = nullptr;
+    size_t pending_size = 0;
+    clock::time_point pending_done;
+    clock::time_point first_send;
+    clock::time_point last_done;
+    size_t transfer_count = 0;
+    size_t total_byte_count = 0;
+    size_t window_count = 0;
+};
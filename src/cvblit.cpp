@@ -0,0 +1,541 @@
+#include "cvblit.h"
+#include "cvcolor.h"
+#include "dma2d.h"
+
+namespace cv
+{
+    bool Blitter::accepts(BlitOperation op, const Mat& src, const Mat& dst) const
+    {
+        if(size_t(dst.rows) * dst.cols < min_pixels[op])
+        {
+            return false;
+        }
+        return op == BLIT_CONVERT || supports(op, src.type, dst.type);
+    }
+
+    size_t Blitter::get_min_pixels(BlitOperation op) const
+    {
+        return min_pixels[op];
+    }
+
+    void Blitter::set_min_pixels(BlitOperation op, size_t pixels)
+    {
+        min_pixels[op] = pixels;
+    }
+
+    // CpuBlitter::copy is defined in cvcore.cpp next to Mat::copyTo, and
+    // CpuBlitter::convert in cvcolor.cpp with the conversions of cvtColor
+
+    const char* CpuBlitter::name() const
+    {
+        return "CPU";
+    }
+
+    static bool blend_source(int type)
+    {
+        return type == ARGB8888 || type == ARGB4444 || type == A8;
+    }
+
+    static bool blend_target(int type)
+    {
+        return type == RGB565 || type == RGB888 || type == ARGB8888;
+    }
+
+    // L4 or 8-bit palette indices
+    static bool expand_source(int type)
+    {
+        return type == L4 || type == RGB332;
+    }
+
+    bool CpuBlitter::supports(BlitOperation op, int src, int dst) const
+    {
+        switch(op)
+        {
+        case BLIT_FILL:
+            return true;
+        case BLIT_COPY:
+            return src == dst;
+        case BLIT_CONVERT:
+            return colorFormatType(src) >= 0 && colorFormatType(dst) >= 0;
+        case BLIT_BLEND:
+            return blend_source(src) && (blend_target(dst) || dst == RGB332);
+        case BLIT_EXPAND:
+            return expand_source(src) && (blend_target(dst) || dst == RGB332);
+        default:
+            return false;
+        }
+    }
+
+    void CpuBlitter::fill(const Mat& dst, uint32_t color)
+    {
+        Mat target(dst);
+        target = color;
+    }
+
+    // source pixel as ARGB8888, channels widened by bit replication
+    static inline uint32_t blend_read(const uint8_t* row, int x, int type, uint32_t color)
+    {
+        switch(type)
+        {
+        case ARGB8888:
+        {
+            uint32_t v;
+            memcpy(&v, row + x * 4, 4);
+            return v;
+        }
+        case ARGB4444:
+        {
+            uint16_t v;
+            memcpy(&v, row + x * 2, 2);
+            return ((v & 0xF000u) * 0x11000u) | ((v & 0x0F00u) * 0x1100u) | ((v & 0x00F0u) * 0x110u) | ((v & 0x000Fu) * 0x11u);
+        }
+        case A8:
+            return (uint32_t(row[x]) << 24) | color;
+        case RGB888:
+            return 0xFF000000u | (uint32_t(row[x * 3 + 2]) << 16) | (uint32_t(row[x * 3 + 1]) << 8) | row[x * 3];
+        case RGB565:
+        {
+            uint16_t v;
+            memcpy(&v, row + x * 2, 2);
+            uint32_t r = v >> 11, g = (v >> 5) & 0x3F, b = v & 0x1F;
+            return 0xFF000000u | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+        }
+        case RGB332:
+        {
+            uint32_t r = row[x] >> 5, g = (row[x] >> 2) & 0x07, b = row[x] & 0x03;
+            return 0xFF000000u | (((r << 5) | (r << 2) | (r >> 1)) << 16) | (((g << 5) | (g << 2) | (g >> 1)) << 8) | (b * 0x55);
+        }
+        }
+        return 0;
+    }
+
+    // ARGB8888 pixel to the dst type, channels truncated
+    static inline void blend_write(uint8_t* row, int x, int type, uint32_t pixel)
+    {
+        switch(type)
+        {
+        case ARGB8888:
+            memcpy(row + x * 4, &pixel, 4);
+            break;
+        case RGB888:
+            row[x * 3] = uint8_t(pixel);
+            row[x * 3 + 1] = uint8_t(pixel >> 8);
+            row[x * 3 + 2] = uint8_t(pixel >> 16);
+            break;
+        case RGB565:
+        {
+            uint16_t v = uint16_t(((pixel >> 8) & 0xF800) | ((pixel >> 5) & 0x07E0) | ((pixel >> 3) & 0x001F));
+            memcpy(row + x * 2, &v, 2);
+            break;
+        }
+        case RGB332:
+            row[x] = uint8_t(((pixel >> 16) & 0xE0) | ((pixel >> 11) & 0x1C) | ((pixel >> 6) & 0x03));
+            break;
+        }
+    }
+
+    // RGB888 value of a pixel value of type
+    static inline uint32_t pixel_rgb(uint32_t color, int type)
+    {
+        uint8_t bytes[4];
+        memcpy(bytes, &color, 4);
+        return blend_read(bytes, 0, type, 0) & 0x00FFFFFF;
+    }
+
+    // Porter-Duff over, with the integer arithmetic of the DMA2D blender
+    static inline uint32_t blend_pixel(uint32_t fg, uint32_t bg)
+    {
+        uint32_t fa = fg >> 24, ba = bg >> 24;
+        uint32_t mult = fa * ba / 255;
+        uint32_t out_a = fa + ba - mult;
+        if(out_a == 0)
+        {
+            return 0;
+        }
+        uint32_t result = out_a << 24;
+        for(int shift = 0; shift < 24; shift += 8)
+        {
+            uint32_t fc = (fg >> shift) & 0xFF, bc = (bg >> shift) & 0xFF;
+            uint32_t c = (fc * fa + bc * ba - bc * mult) / out_a;
+            result |= std::min<uint32_t>(c, 255) << shift;
+        }
+        return result;
+    }
+
+    // blend_pixel over an opaque background, where it reduces to one
+    // constant division per channel
+    static inline uint32_t blend_opaque(uint32_t fg, uint32_t bg)
+    {
+        const uint32_t fa = fg >> 24, ba = 255 - fa;
+        uint32_t result = 0xFF000000u;
+        for(int shift = 0; shift < 24; shift += 8)
+        {
+            result |= ((((fg >> shift) & 0xFF) * fa + ((bg >> shift) & 0xFF) * ba) / 255) << shift;
+        }
+        return result;
+    }
+
+    // blend fg over pixel x of a row of type, opaque unless ARGB8888
+    static inline void blend_over(uint8_t* row, int x, int type, bool opaque, uint32_t fg)
+    {
+        if(!opaque)
+        {
+            blend_write(row, x, type, blend_pixel(fg, blend_read(row, x, type, 0)));
+        }
+        else if(fg >= 0xFF000000u)
+        {
+            blend_write(row, x, type, fg);
+        }
+        else if(fg >= 0x01000000u)
+        {
+            blend_write(row, x, type, blend_opaque(fg, blend_read(row, x, type, 0)));
+        }
+    }
+
+    void CpuBlitter::blend(const Mat& src, const Mat& dst, uint8_t alpha, uint32_t color)
+    {
+        Mat target(dst);
+        color = pixel_rgb(color, dst.type);
+        // only ARGB8888 Mats have alpha; over the others a transparent pixel
+        // changes nothing and an opaque one replaces the pixel
+        const bool opaque = dst.type != ARGB8888;
+        for(int y = 0; y < dst.rows; y++)
+        {
+            const uint8_t* s = src.ptr<uint8_t>(y);
+            uint8_t* d = target.ptr<uint8_t>(y);
+            for(int x = 0; x < dst.cols; x++)
+            {
+                uint32_t fg = blend_read(s, x, src.type, color);
+                if(alpha != 255)
+                {
+                    fg = (fg & 0x00FFFFFF) | (((fg >> 24) * alpha / 255) << 24);
+                }
+                blend_over(d, x, dst.type, opaque, fg);
+            }
+        }
+    }
+
+    void CpuBlitter::expand(const Mat& src, const Mat& dst, const uint32_t* palette, bool blend)
+    {
+        Mat target(dst);
+        const bool opaque = dst.type != ARGB8888;
+        for(int y = 0; y < dst.rows; y++)
+        {
+            const uint8_t* s = src.ptr<uint8_t>(y);
+            uint8_t* d = target.ptr<uint8_t>(y);
+            for(int x = 0; x < dst.cols; x++)
+            {
+                // the left L4 pixel is in the low nibble
+                const uint32_t color = palette[src.type == L4 ? (s[x / 2] >> ((x & 1) * 4)) & 0x0F : s[x]];
+                if(blend)
+                {
+                    blend_over(d, x, dst.type, opaque, color);
+                }
+                else
+                {
+                    blend_write(d, x, dst.type, color);
+                }
+            }
+        }
+    }
+
+#if HAS_DMA2D
+    Dma2dBlitter::Dma2dBlitter()
+    {
+        // below these sizes the register setup and cache maintenance cost
+        // more than the CPU code
+        min_pixels[BLIT_COPY] = 2048;
+        min_pixels[BLIT_CONVERT] = 1024;
+        min_pixels[BLIT_EXPAND] = 1024;
+    }
+
+    const char* Dma2dBlitter::name() const
+    {
+        return "DMA2D";
+    }
+
+    bool Dma2dBlitter::supports(BlitOperation op, int src, int dst) const
+    {
+        switch(op)
+        {
+        case BLIT_FILL:
+            return true;
+        case BLIT_COPY:
+            return src == dst;
+        case BLIT_CONVERT:
+            // the pixel format converter outputs RGB565, RGB888 and ARGB8888,
+            // 8-bit sources are read as L8 through a CLUT
+            return (dst == COLOR_RGB565 || dst == COLOR_RGB888 || dst == COLOR_ARGB8888) &&
+                (src == COLOR_RGB332 || src == COLOR_GRAY8 || src == COLOR_RGB565 || src == COLOR_RGB888 || src == COLOR_ARGB8888);
+        case BLIT_BLEND:
+            return blend_source(src) && blend_target(dst);
+        case BLIT_EXPAND:
+            return expand_source(src) && blend_target(dst);
+        default:
+            return false;
+        }
+    }
+
+    bool Dma2dBlitter::accepts(BlitOperation op, const Mat& src, const Mat& dst) const
+    {
+        if(!Blitter::accepts(op, src, dst))
+        {
+            return false;
+        }
+        // the line offsets count whole pixels, and L4 pixels move in pairs
+        const size_t bits = dst.elemBits();
+        if(dst.step[0] * 8 % bits != 0 || (op != BLIT_FILL && src.step[0] * 8 % src.elemBits() != 0))
+        {
+            return false;
+        }
+        return op != BLIT_COPY || dst.type != L4 || (dst.cols & 1) == 0;
+    }
+
+    void Dma2dBlitter::fill(const Mat& dst, uint32_t color)
+    {
+        dma2d_fill(dst, color);
+    }
+
+    void Dma2dBlitter::copy(const Mat& src, const Mat& dst)
+    {
+        dma2d_copy(src, Rect(0, 0, dst.cols, dst.rows), dst, Point(0, 0));
+    }
+
+    void Dma2dBlitter::convert(const Mat& src, int src_format, const Mat& dst, int)
+    {
+        const uint8_t* clut = nullptr;
+        if(src_format == COLOR_RGB332)
+        {
+            clut = RGB332toRGB888LUT;
+        }
+        else if(src_format == COLOR_GRAY8)
+        {
+            clut = GRAY8toRGB888LUT;
+        }
+        dma2d_convert(src, Rect(0, 0, dst.cols, dst.rows), dst, Point(0, 0), clut);
+    }
+
+    void Dma2dBlitter::blend(const Mat& src, const Mat& dst, uint8_t alpha, uint32_t color)
+    {
+        dma2d_blend(src, Rect(0, 0, dst.cols, dst.rows), dst, Point(0, 0), alpha, pixel_rgb(color, dst.type));
+    }
+
+    void Dma2dBlitter::expand(const Mat& src, const Mat& dst, const uint32_t* palette, bool blend)
+    {
+        dma2d_indexed(src, Rect(0, 0, dst.cols, dst.rows), dst, Point(0, 0), palette, blend);
+    }
+#endif
+
+    static CpuBlitter cpu_blitter;
+#if HAS_DMA2D
+    static Dma2dBlitter dma2d_blitter;
+    static Blitter* const default_blitter = &dma2d_blitter;
+#else
+    static Blitter* const default_blitter = &cpu_blitter;
+#endif
+    static Blitter* current_blitter = default_blitter;
+
+    Blitter* getBlitter()
+    {
+        return current_blitter;
+    }
+
+    void setBlitter(Blitter* blitter)
+    {
+        current_blitter = blitter != nullptr ? blitter : default_blitter;
+    }
+
+    Blitter* getCpuBlitter()
+    {
+        return &cpu_blitter;
+    }
+
+    Blitter* getDma2dBlitter()
+    {
+#if HAS_DMA2D
+        return &dma2d_blitter;
+#else
+        return nullptr;
+#endif
+    }
+
+    Blitter& selectBlitter(BlitOperation op, const Mat& src, const Mat& dst)
+    {
+        return current_blitter->accepts(op, src, dst) ? *current_blitter : cpu_blitter;
+    }
+
+    static const uint32_t BLIT_CALIBRATION_MAGIC = 0x324C4243; // "CBL2"
+
+    // FNV-1a of the fields before the checksum
+    static uint32_t calibration_checksum(const BlitCalibration& calibration)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&calibration);
+        uint32_t hash = 2166136261u;
+        for(size_t i = 0; i < offsetof(BlitCalibration, checksum); i++)
+        {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    // by increasing area; even widths for L4 copies
+    static const Size calibration_blocks[] = {
+        Size(4, 4), Size(16, 2), Size(2, 16), Size(8, 8), Size(32, 4), Size(4, 32), Size(16, 16), Size(64, 8),
+        Size(8, 64), Size(32, 32), Size(128, 16), Size(16, 128), Size(64, 64), Size(128, 64), Size(128, 128)
+    };
+
+    // clock ticks a run of op takes, over enough runs to last this long
+    static const uint32_t calibration_ticks = 200;
+
+    template<typename Op>
+    static float time_operation(Callback<uint32_t()>& clock, Op op)
+    {
+        // warm up the caches and the CLUT
+        op();
+        for(uint32_t runs = 1;; runs *= 2)
+        {
+            const uint32_t start = clock();
+            for(uint32_t i = 0; i < runs; i++)
+            {
+                op();
+            }
+            const uint32_t ticks = clock() - start;
+            if(ticks >= calibration_ticks || runs >= 4096)
+            {
+                return float(ticks) / runs;
+            }
+        }
+    }
+
+    static uint32_t ticker_clock()
+    {
+        return us_ticker_read();
+    }
+
+    static int calibration_format(int type)
+    {
+        switch(type)
+        {
+        case RGB565:
+            return COLOR_RGB565;
+        case RGB888:
+            return COLOR_RGB888;
+        case ARGB8888:
+            return COLOR_ARGB8888;
+        default:
+            return -1;
+        }
+    }
+
+    BlitCalibration calibrateBlitter(Blitter& blitter, int type, Callback<uint32_t()> clock, Blitter* reference)
+    {
+        if(!clock)
+        {
+            clock = ticker_clock;
+        }
+        if(reference == nullptr)
+        {
+            reference = &cpu_blitter;
+        }
+        const int format = calibration_format(type);
+        const Size max_size = calibration_blocks[sizeof(calibration_blocks) / sizeof(calibration_blocks[0]) - 1];
+        Mat dst(max_size, type);
+        dst = 0;
+        // opaque grays, expanded without blending
+        Mat palette(1, 256, ARGB8888);
+        for(int i = 0; i < 256; i++)
+        {
+            palette.at<uint32_t>(0, i) = 0xFF000000u | (uint32_t(i) * 0x010101u);
+        }
+
+        BlitCalibration calibration;
+        calibration.magic = BLIT_CALIBRATION_MAGIC;
+        calibration.type = type;
+        for(int i = 0; i < BLIT_OPERATION_COUNT; i++)
+        {
+            const BlitOperation op = BlitOperation(i);
+            int src_type = type;
+            bool supported;
+            switch(op)
+            {
+            case BLIT_CONVERT:
+                src_type = RGB332;
+                supported = format >= 0 && blitter.supports(op, COLOR_RGB332, format) && reference->supports(op, COLOR_RGB332, format);
+                break;
+            case BLIT_BLEND:
+                src_type = ARGB8888;
+                supported = blitter.supports(op, ARGB8888, type) && reference->supports(op, ARGB8888, type);
+                break;
+            case BLIT_EXPAND:
+                src_type = RGB332;
+                supported = blitter.supports(op, RGB332, type) && reference->supports(op, RGB332, type);
+                break;
+            default:
+                supported = blitter.supports(op, type, type) && reference->supports(op, type, type);
+                break;
+            }
+            calibration.min_pixels[op] = UINT32_MAX;
+            if(!supported)
+            {
+                continue;
+            }
+            Mat src;
+            if(op != BLIT_FILL)
+            {
+                src.create(max_size, src_type);
+                // half transparent, so that blending skips no pixel
+                src = src_type == ARGB8888 ? 0x80C08040u : 0x5Au;
+            }
+            auto run = [&](Blitter& b, const Mat& s, const Mat& d) {
+                switch(op)
+                {
+                case BLIT_FILL:
+                    b.fill(d, 0x5A);
+                    break;
+                case BLIT_COPY:
+                    b.copy(s, d);
+                    break;
+                case BLIT_CONVERT:
+                    b.convert(s, COLOR_RGB332, d, format);
+                    break;
+                case BLIT_EXPAND:
+                    b.expand(s, d, palette.ptr<uint32_t>());
+                    break;
+                default:
+                    b.blend(s, d);
+                    break;
+                }
+            };
+            // from the largest block down, while blitter wins
+            for(int j = int(sizeof(calibration_blocks) / sizeof(calibration_blocks[0])) - 1; j >= 0; j--)
+            {
+                const Rect rect(Point(0, 0), calibration_blocks[j]);
+                const Mat d = dst(rect), s = op == BLIT_FILL ? Mat() : src(rect);
+                const float blitter_ticks = time_operation(clock, [&]() { run(blitter, s, d); });
+                const float reference_ticks = time_operation(clock, [&]() { run(*reference, s, d); });
+                if(blitter_ticks >= reference_ticks)
+                {
+                    break;
+                }
+                calibration.min_pixels[op] = j == 0 ? 0 : uint32_t(rect.area());
+            }
+        }
+        calibration.checksum = calibration_checksum(calibration);
+        applyBlitCalibration(blitter, calibration);
+        return calibration;
+    }
+
+    bool applyBlitCalibration(Blitter& blitter, const BlitCalibration& calibration)
+    {
+        if(calibration.magic != BLIT_CALIBRATION_MAGIC || calibration.checksum != calibration_checksum(calibration))
+        {
+            return false;
+        }
+        for(int i = 0; i < BLIT_OPERATION_COUNT; i++)
+        {
+            const uint32_t pixels = calibration.min_pixels[i];
+            blitter.set_min_pixels(BlitOperation(i), pixels == UINT32_MAX ? SIZE_MAX : pixels);
+        }
+        return true;
+    }
+}
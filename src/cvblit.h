@@ -0,0 +1,148 @@
+#pragma once
+
+#include "mbed.h"
+#include "cvcore.h"
+
+// Blitters move blocks of pixels: fill, copy, color conversion, blending and
+// expansion of palette indices.
+// Painter, Mat::copyTo and cvtColor hand their block operations to the
+// current Blitter when it accepts the block, and do them on the CPU
+// otherwise. The default is the DMA2D Blitter on builds with HAS_DMA2D (on
+// the host, backed by the software model of host/dma2d_emu.h), the CPU
+// Blitter elsewhere; firmware built with the DMA2D can switch to the CPU
+// Blitter at startup on boards without one.
+
+namespace cv
+{
+    enum BlitOperation
+    {
+        BLIT_FILL,
+        BLIT_COPY,
+        BLIT_CONVERT,
+        BLIT_BLEND,
+        BLIT_EXPAND,
+        BLIT_OPERATION_COUNT
+    };
+
+    class Blitter
+    {
+    public:
+        virtual ~Blitter() = default;
+
+        virtual const char* name() const = 0;
+
+        // Whether op is supported from src to dst: Mat types, except for
+        // BLIT_CONVERT, whose src and dst are color formats (see cvcolor.h).
+        // The destination of fill is dst, src is ignored.
+        virtual bool supports(BlitOperation op, int src, int dst) const = 0;
+
+        // Whether op on the block is handed to this Blitter: supported, of at
+        // least the minimum size and laid out as it needs. Color formats of
+        // BLIT_CONVERT are checked by supports.
+        virtual bool accepts(BlitOperation op, const Mat& src, const Mat& dst) const;
+
+        // smallest block in destination pixels worth handing over; smaller
+        // ones are done faster by the callers' CPU code
+        size_t get_min_pixels(BlitOperation op) const;
+        void set_min_pixels(BlitOperation op, size_t pixels);
+
+        // the operations work on the whole of dst; src must be at least as
+        // large and not overlap dst
+
+        // color is a pixel value of the dst type
+        virtual void fill(const Mat& dst, uint32_t color) = 0;
+
+        // src and dst of the same type
+        virtual void copy(const Mat& src, const Mat& dst) = 0;
+
+        virtual void convert(const Mat& src, int src_format, const Mat& dst, int dst_format) = 0;
+
+        // Blend src over dst, its alpha scaled by alpha. A8 sources give the
+        // alpha of color, a pixel value of the dst type. ARGB8888, ARGB4444
+        // and A8 sources blend into RGB565, RGB888 and ARGB8888 Mats, and on
+        // the CPU into RGB332 Mats, which the DMA2D cannot write.
+        virtual void blend(const Mat& src, const Mat& dst, uint8_t alpha = 255, uint32_t color = 0) = 0;
+
+        // Expand src of palette indices through palette, ARGB8888 colors: 16
+        // for L4 sources, 256 for 8-bit ones. With blend the palette alpha
+        // blends the colors over dst, otherwise they replace its pixels.
+        // Into the Mats blend writes.
+        virtual void expand(const Mat& src, const Mat& dst, const uint32_t* palette, bool blend = false) = 0;
+
+    protected:
+        size_t min_pixels[BLIT_OPERATION_COUNT] = {};
+    };
+
+    // Blocks of any size on the CPU, with the span kernels of cvkernels.h
+    class CpuBlitter : public Blitter
+    {
+    public:
+        virtual const char* name() const override;
+        virtual bool supports(BlitOperation op, int src, int dst) const override;
+        virtual void fill(const Mat& dst, uint32_t color) override;
+        virtual void copy(const Mat& src, const Mat& dst) override;
+        virtual void convert(const Mat& src, int src_format, const Mat& dst, int dst_format) override;
+        virtual void blend(const Mat& src, const Mat& dst, uint8_t alpha = 255, uint32_t color = 0) override;
+        virtual void expand(const Mat& src, const Mat& dst, const uint32_t* palette, bool blend = false) override;
+    };
+
+#if HAS_DMA2D
+    // Blocks through the blocking DMA2D functions of dma2d.h. L4 copies
+    // need an even width; lines must hold whole pixels. Palettes of the
+    // same colors stay in the CLUT between expansions.
+    class Dma2dBlitter : public Blitter
+    {
+    public:
+        Dma2dBlitter();
+
+        virtual const char* name() const override;
+        virtual bool supports(BlitOperation op, int src, int dst) const override;
+        virtual bool accepts(BlitOperation op, const Mat& src, const Mat& dst) const override;
+        virtual void fill(const Mat& dst, uint32_t color) override;
+        virtual void copy(const Mat& src, const Mat& dst) override;
+        virtual void convert(const Mat& src, int src_format, const Mat& dst, int dst_format) override;
+        virtual void blend(const Mat& src, const Mat& dst, uint8_t alpha = 255, uint32_t color = 0) override;
+        virtual void expand(const Mat& src, const Mat& dst, const uint32_t* palette, bool blend = false) override;
+    };
+#endif
+
+    // the current Blitter; nullptr restores the default
+    Blitter* getBlitter();
+    void setBlitter(Blitter* blitter);
+
+    Blitter* getCpuBlitter();
+
+    // the DMA2D Blitter, nullptr on builds without HAS_DMA2D
+    Blitter* getDma2dBlitter();
+
+    // the current Blitter if it accepts op on the block, else the CPU Blitter
+    Blitter& selectBlitter(BlitOperation op, const Mat& src, const Mat& dst);
+
+    // Minimum block sizes of a Blitter measured by calibrateBlitter. Plain
+    // data with a version and a checksum: store it (e.g. in flash) and apply
+    // it at the next startup instead of calibrating again.
+    struct BlitCalibration
+    {
+        uint32_t magic;
+        // Mat type of the calibration blocks
+        int32_t type;
+        // UINT32_MAX: the Blitter was never faster or does not support the op
+        uint32_t min_pixels[BLIT_OPERATION_COUNT];
+        uint32_t checksum;
+    };
+
+    // Time each operation through blitter and through reference (the CPU
+    // Blitter by default) on blocks of type from 4x4 to 128x128, squares,
+    // strips and columns, and set the minimum size of the operation to the
+    // smallest block area from which blitter is faster on every larger block.
+    // Convert is timed from RGB332 to the color format of type, blend from
+    // ARGB8888, expand from 8-bit indices. clock returns a time in any
+    // unit, the default reads the microsecond ticker; the whole calibration
+    // takes some 50 ms with it. Allocates a 128x128 Mat of type, a palette
+    // and one source Mat at a time.
+    BlitCalibration calibrateBlitter(Blitter& blitter, int type, Callback<uint32_t()> clock = nullptr, Blitter* reference = nullptr);
+
+    // Set the minimum sizes of blitter from calibration; false, leaving
+    // them as they are, if calibration is not a valid one
+    bool applyBlitCalibration(Blitter& blitter, const BlitCalibration& calibration);
+}
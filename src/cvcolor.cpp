@@ -0,0 +1,293 @@
+#include "cvimgproc.h"
+#include "cvkernels.h"
+#include "cvblit.h"
+#include <algorithm>
+
+namespace cv
+{
+    // Per-format pixel access through opaque ARGB8888
+    template<int Format>
+    struct ColorFormat;
+
+    template<>
+    struct ColorFormat<COLOR_RGB332>
+    {
+        typedef uint8_t value_type;
+        static constexpr int format = COLOR_RGB332;
+
+        static inline uint32_t to_argb(value_type v)
+        {
+            uint32_t r = v >> 5, g = (v >> 2) & 0x07, b = v & 0x03;
+            return 0xFF000000u | (((r << 5) | (r << 2) | (r >> 1)) << 16) | (((g << 5) | (g << 2) | (g >> 1)) << 8) | (b * 0x55);
+        }
+
+        static inline value_type from_argb(uint32_t c)
+        {
+            return value_type(((c >> 16) & 0xE0) | ((c >> 11) & 0x1C) | ((c >> 6) & 0x03));
+        }
+    };
+
+    template<>
+    struct ColorFormat<COLOR_RGB565>
+    {
+        typedef uint16_t value_type;
+        static constexpr int format = COLOR_RGB565;
+
+        static inline uint32_t to_argb(value_type v)
+        {
+            uint32_t r = v >> 11, g = (v >> 5) & 0x3F, b = v & 0x1F;
+            return 0xFF000000u | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+        }
+
+        static inline value_type from_argb(uint32_t c)
+        {
+            return value_type(((c >> 8) & 0xF800) | ((c >> 5) & 0x07E0) | ((c >> 3) & 0x001F));
+        }
+    };
+
+    template<>
+    struct ColorFormat<COLOR_RGB565_SWAPPED>
+    {
+        typedef uint16_t value_type;
+        static constexpr int format = COLOR_RGB565_SWAPPED;
+
+        static inline uint32_t to_argb(value_type v)
+        {
+            return ColorFormat<COLOR_RGB565>::to_argb(value_type((v >> 8) | (v << 8)));
+        }
+
+        static inline value_type from_argb(uint32_t c)
+        {
+            value_type v = ColorFormat<COLOR_RGB565>::from_argb(c);
+            return value_type((v >> 8) | (v << 8));
+        }
+    };
+
+    template<>
+    struct ColorFormat<COLOR_GRAY8>
+    {
+        typedef uint8_t value_type;
+        static constexpr int format = COLOR_GRAY8;
+
+        static inline uint32_t to_argb(value_type v)
+        {
+            return 0xFF000000u | v * 0x010101u;
+        }
+
+        // BT.601 luma, 8-bit fixed point
+        static inline value_type from_argb(uint32_t c)
+        {
+            return value_type((((c >> 16) & 0xFF) * 77 + ((c >> 8) & 0xFF) * 150 + (c & 0xFF) * 29 + 128) >> 8);
+        }
+    };
+
+    template<>
+    struct ColorFormat<COLOR_RGB888>
+    {
+        typedef rgb888_t value_type;
+        static constexpr int format = COLOR_RGB888;
+
+        static inline uint32_t to_argb(value_type v)
+        {
+            return 0xFF000000u | (uint32_t(v.r) << 16) | (uint32_t(v.g) << 8) | v.b;
+        }
+
+        static inline value_type from_argb(uint32_t c)
+        {
+            return value_type{ uint8_t(c), uint8_t(c >> 8), uint8_t(c >> 16) };
+        }
+    };
+
+    template<>
+    struct ColorFormat<COLOR_ARGB8888>
+    {
+        typedef uint32_t value_type;
+        static constexpr int format = COLOR_ARGB8888;
+
+        static inline uint32_t to_argb(value_type v)
+        {
+            return v;
+        }
+
+        static inline value_type from_argb(uint32_t c)
+        {
+            return c;
+        }
+    };
+
+    // Call fn(ColorFormat<format>()), returns false for unknown formats
+    template<typename Fn>
+    static bool dispatch_color_format(int format, Fn&& fn)
+    {
+        switch (format)
+        {
+        case COLOR_RGB332:
+            fn(ColorFormat<COLOR_RGB332>());
+            return true;
+        case COLOR_RGB565:
+            fn(ColorFormat<COLOR_RGB565>());
+            return true;
+        case COLOR_RGB565_SWAPPED:
+            fn(ColorFormat<COLOR_RGB565_SWAPPED>());
+            return true;
+        case COLOR_GRAY8:
+            fn(ColorFormat<COLOR_GRAY8>());
+            return true;
+        case COLOR_RGB888:
+            fn(ColorFormat<COLOR_RGB888>());
+            return true;
+        case COLOR_ARGB8888:
+            fn(ColorFormat<COLOR_ARGB8888>());
+            return true;
+        }
+        return false;
+    }
+
+    // below this many pixels an 8-bit source is converted pixel by pixel
+    // rather than through a table
+    static const int TABLE_MIN_PIXELS = 256;
+
+    template<typename Src, typename Dst>
+    static void convert(const Mat& src, Mat& dst, int rows, int cols)
+    {
+        typedef typename Src::value_type src_type;
+        typedef typename Dst::value_type dst_type;
+        constexpr int src_format = Src::format, dst_format = Dst::format;
+
+        if constexpr ((src_format == COLOR_RGB565 && dst_format == COLOR_RGB565_SWAPPED) ||
+            (src_format == COLOR_RGB565_SWAPPED && dst_format == COLOR_RGB565))
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                swap_bytes_span16(dst.ptr<uint16_t>(y), src.ptr<uint16_t>(y), cols);
+            }
+        }
+        else if constexpr (src_format == COLOR_RGB565 && dst_format == COLOR_ARGB8888)
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                rgb565_to_argb8888_span(dst.ptr<uint32_t>(y), src.ptr<uint16_t>(y), cols);
+            }
+        }
+        else if constexpr (src_format == COLOR_ARGB8888 && dst_format == COLOR_RGB565)
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                argb8888_to_rgb565_span(dst.ptr<uint16_t>(y), src.ptr<uint32_t>(y), cols);
+            }
+        }
+        else if constexpr (sizeof(src_type) == 1)
+        {
+            const dst_type* table = nullptr;
+            dst_type table_data[256];
+            if constexpr (src_format == COLOR_RGB332 && dst_format == COLOR_RGB565)
+            {
+                table = RGB332to565LUT;
+            }
+            else if (rows * cols >= TABLE_MIN_PIXELS)
+            {
+                for (int i = 0; i < 256; i++)
+                {
+                    table_data[i] = Dst::from_argb(Src::to_argb(src_type(i)));
+                }
+                table = table_data;
+            }
+            for (int y = 0; y < rows; y++)
+            {
+                const src_type* s = src.ptr<src_type>(y);
+                dst_type* d = dst.ptr<dst_type>(y);
+                if (table != nullptr)
+                {
+                    for (int x = 0; x < cols; x++)
+                    {
+                        d[x] = table[s[x]];
+                    }
+                }
+                else
+                {
+                    for (int x = 0; x < cols; x++)
+                    {
+                        d[x] = Dst::from_argb(Src::to_argb(s[x]));
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (int y = 0; y < rows; y++)
+            {
+                const src_type* s = src.ptr<src_type>(y);
+                dst_type* d = dst.ptr<dst_type>(y);
+                for (int x = 0; x < cols; x++)
+                {
+                    d[x] = Dst::from_argb(Src::to_argb(s[x]));
+                }
+            }
+        }
+    }
+
+    int colorFormatType(int format)
+    {
+        switch (format)
+        {
+        case COLOR_RGB332:
+        case COLOR_GRAY8:
+            return MONO8;
+        case COLOR_RGB565:
+        case COLOR_RGB565_SWAPPED:
+            return RGB565;
+        case COLOR_RGB888:
+            return RGB888;
+        case COLOR_ARGB8888:
+            return ARGB8888;
+        }
+        return -1;
+    }
+
+    void CpuBlitter::convert(const Mat& src, int src_format, const Mat& dst, int dst_format)
+    {
+        Mat target(dst);
+        dispatch_color_format(src_format, [&](auto src_pf) {
+            dispatch_color_format(dst_format, [&](auto dst_pf) {
+                cv::convert<decltype(src_pf), decltype(dst_pf)>(src, target, dst.rows, dst.cols);
+            });
+        });
+    }
+
+    bool cvtColor(const Mat& src, Mat& dst, int src_format, int dst_format)
+    {
+        const int src_type = colorFormatType(src_format);
+        const int dst_type = colorFormatType(dst_format);
+        if (src_type < 0 || dst_type < 0 || src.type != src_type)
+        {
+            return false;
+        }
+        if (dst.empty())
+        {
+            dst.create(src.size(), dst_type);
+        }
+        if (dst.type != dst_type)
+        {
+            return false;
+        }
+        if (src_format == dst_format)
+        {
+            return src.copyTo(dst);
+        }
+        const int rows = std::min(src.rows, dst.rows);
+        const int cols = std::min(src.cols, dst.cols);
+        if (rows <= 0 || cols <= 0)
+        {
+            return true;
+        }
+        const Mat src_block = src(Rect(0, 0, cols, rows));
+        const Mat dst_block = dst(Rect(0, 0, cols, rows));
+        Blitter* blitter = getBlitter();
+        if (!blitter->supports(BLIT_CONVERT, src_format, dst_format) || !blitter->accepts(BLIT_CONVERT, src_block, dst_block))
+        {
+            blitter = getCpuBlitter();
+        }
+        blitter->convert(src_block, src_format, dst_block, dst_format);
+        return true;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mbed.h"
+#include "cvcore.h"
+
+// Color conversion between the pixel layouts of camera and display buffers.
+// 8-bit sources go through a 256 entry table, RGB565 / ARGB8888 pairs through
+// the span kernels of cvkernels.h. Conversions the current Blitter accepts
+// (see cvblit.h), such as those the DMA2D pixel format converter can
+// produce (RGB565, RGB888 or ARGB8888 output), are offloaded to it.
+// Channels are widened by bit replication and narrowed by truncation, as
+// the DMA2D does, so both paths give the same pixels.
+
+namespace cv
+{
+    // Pixel layouts understood by cvtColor. Two pairs share a Mat type:
+    // COLOR_RGB332 and COLOR_GRAY8 are MONO8 Mats, COLOR_RGB565 and
+    // COLOR_RGB565_SWAPPED (high byte first, as many SPI displays take it)
+    // are RGB565 Mats.
+    enum ColorFormats
+    {
+        COLOR_RGB332,
+        COLOR_RGB565,
+        COLOR_RGB565_SWAPPED,
+        COLOR_GRAY8,
+        COLOR_RGB888,
+        COLOR_ARGB8888
+    };
+
+    // Mat type holding a color format, -1 for an unknown format
+    int colorFormatType(int format);
+
+    // Convert src from src_format to dst_format. An empty dst is created with
+    // the size of src; otherwise the overlapping top-left area is converted
+    // and dst must have the Mat type of dst_format. Alpha is dropped, or set
+    // to 0xFF when converting to ARGB8888. Gray is the BT.601 luma.
+    // src and dst may only be the same pixels for formats of equal size.
+    // Returns false for an unknown format or a Mat of the wrong type.
+    bool cvtColor(const Mat& src, Mat& dst, int src_format, int dst_format);
+}
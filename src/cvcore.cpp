@@ -1,8 +1,11 @@
 #include "cvcore.h"
+#include "cvpixel.h"
+#include "cvblit.h"
 #include <climits>
 #include <utility>
 #include <algorithm>
 #include <cmath>
+#include <new>
 
 namespace cv
 {
@@ -269,6 +272,384 @@ namespace cv
         return Range(INT_MIN, INT_MAX);
     }
 
+    void* HeapAllocator::allocate(size_t size)
+    {
+        return malloc(size);
+    }
+
+    void HeapAllocator::deallocate(void* ptr, size_t)
+    {
+        free(ptr);
+    }
+
+    size_t HeapAllocator::alignment() const
+    {
+        return alignof(std::max_align_t);
+    }
+
+    AlignedAllocator::AlignedAllocator(size_t _alignment)
+        : block_alignment(std::max(_alignment, sizeof(void*)))
+    {
+    }
+
+    void* AlignedAllocator::allocate(size_t size)
+    {
+        // the pointer returned by malloc is kept just below the aligned block
+        uint8_t* raw = reinterpret_cast<uint8_t*>(malloc(size + block_alignment - 1 + sizeof(void*)));
+        if (raw == nullptr)
+        {
+            return nullptr;
+        }
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + block_alignment - 1) & ~uintptr_t(block_alignment - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void AlignedAllocator::deallocate(void* ptr, size_t)
+    {
+        if (ptr != nullptr)
+        {
+            free(reinterpret_cast<void**>(ptr)[-1]);
+        }
+    }
+
+    size_t AlignedAllocator::alignment() const
+    {
+        return block_alignment;
+    }
+
+    ArenaAllocator::ArenaAllocator(void* base, size_t size, size_t _alignment)
+        : block_alignment(std::max(_alignment, sizeof(FreeBlock)))
+    {
+        uintptr_t begin = (reinterpret_cast<uintptr_t>(base) + block_alignment - 1) & ~uintptr_t(block_alignment - 1);
+        uintptr_t end = (reinterpret_cast<uintptr_t>(base) + size) & ~uintptr_t(block_alignment - 1);
+        if (end > begin)
+        {
+            free_list = reinterpret_cast<FreeBlock*>(begin);
+            free_list->size = end - begin;
+            free_list->next = nullptr;
+        }
+    }
+
+    size_t ArenaAllocator::block_size(size_t size) const
+    {
+        return (std::max<size_t>(size, 1) + block_alignment - 1) & ~(block_alignment - 1);
+    }
+
+    void* ArenaAllocator::allocate(size_t size)
+    {
+        size_t n = block_size(size);
+        FreeBlock** link = &free_list;
+        for (FreeBlock* block = free_list; block != nullptr; link = &block->next, block = block->next)
+        {
+            if (block->size >= n)
+            {
+                // block sizes are multiples of the alignment, so the remainder
+                // is either empty or large enough to stay on the free list
+                if (block->size > n)
+                {
+                    FreeBlock* rest = reinterpret_cast<FreeBlock*>(reinterpret_cast<uint8_t*>(block) + n);
+                    rest->size = block->size - n;
+                    rest->next = block->next;
+                    *link = rest;
+                }
+                else
+                {
+                    *link = block->next;
+                }
+                return block;
+            }
+        }
+        return nullptr;
+    }
+
+    void ArenaAllocator::deallocate(void* ptr, size_t size)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+        // the free list is kept sorted by address so neighbours can be merged
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(ptr);
+        block->size = block_size(size);
+        FreeBlock* prev = nullptr;
+        FreeBlock* next = free_list;
+        while (next != nullptr && next < block)
+        {
+            prev = next;
+            next = next->next;
+        }
+        block->next = next;
+        if (next != nullptr && reinterpret_cast<uint8_t*>(block) + block->size == reinterpret_cast<uint8_t*>(next))
+        {
+            block->size += next->size;
+            block->next = next->next;
+        }
+        if (prev != nullptr && reinterpret_cast<uint8_t*>(prev) + prev->size == reinterpret_cast<uint8_t*>(block))
+        {
+            prev->size += block->size;
+            prev->next = block->next;
+        }
+        else if (prev != nullptr)
+        {
+            prev->next = block;
+        }
+        else
+        {
+            free_list = block;
+        }
+    }
+
+    size_t ArenaAllocator::alignment() const
+    {
+        return block_alignment;
+    }
+
+    size_t ArenaAllocator::free_bytes() const
+    {
+        size_t total = 0;
+        for (const FreeBlock* block = free_list; block != nullptr; block = block->next)
+        {
+            total += block->size;
+        }
+        return total;
+    }
+
+    size_t ArenaAllocator::largest_free_block() const
+    {
+        size_t largest = 0;
+        for (const FreeBlock* block = free_list; block != nullptr; block = block->next)
+        {
+            largest = std::max(largest, block->size);
+        }
+        return largest;
+    }
+
+    FrameArena::FrameArena(void* buffer, size_t size)
+        : base(reinterpret_cast<uint8_t*>(buffer)), top(base), end(base + size)
+    {
+    }
+
+    void* FrameArena::allocate(size_t size, size_t alignment)
+    {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(top) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (aligned + size > reinterpret_cast<uintptr_t>(end))
+        {
+            overflows++;
+            return nullptr;
+        }
+        top = reinterpret_cast<uint8_t*>(aligned + size);
+        high_water = std::max(high_water, size_t(top - base));
+        allocations++;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void FrameArena::deallocate(void* ptr, size_t size)
+    {
+        if (reinterpret_cast<uint8_t*>(ptr) + size == top)
+        {
+            top = reinterpret_cast<uint8_t*>(ptr);
+        }
+    }
+
+    bool FrameArena::owns(const void* ptr) const
+    {
+        return ptr >= base && ptr < end;
+    }
+
+    void FrameArena::reset()
+    {
+        top = base;
+    }
+
+    size_t FrameArena::capacity() const
+    {
+        return end - base;
+    }
+
+    size_t FrameArena::used() const
+    {
+        return top - base;
+    }
+
+    size_t FrameArena::high_water_mark() const
+    {
+        return high_water;
+    }
+
+    uint32_t FrameArena::allocation_count() const
+    {
+        return allocations;
+    }
+
+    uint32_t FrameArena::overflow_count() const
+    {
+        return overflows;
+    }
+
+    static MatAllocator* default_allocator = nullptr;
+
+    // bytes covered by cols pixels
+    static size_t row_bytes(size_t bits, int cols)
+    {
+        return (cols * bits + 7) / 8;
+    }
+
+    // offset of the pixel data behind the MatData header
+    static size_t mat_data_offset(const MatAllocator* allocator)
+    {
+        size_t alignment = allocator->alignment();
+        return (sizeof(MatData) + alignment - 1) & ~(alignment - 1);
+    }
+
+    Mat::Mat(const Mat& m)
+        : type(m.type), rows(m.rows), cols(m.cols), data(m.data), u(m.u)
+    {
+        step[0] = m.step[0];
+        step[1] = m.step[1];
+        if (u != nullptr)
+        {
+            u->refcount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Mat::Mat(Mat&& m)
+        : type(m.type), rows(m.rows), cols(m.cols), data(m.data), u(m.u)
+    {
+        step[0] = m.step[0];
+        step[1] = m.step[1];
+        m.u = nullptr;
+        m.release();
+    }
+
+    Mat::Mat(int _rows, int _cols, int _type)
+    {
+        create(_rows, _cols, _type);
+    }
+
+    Mat::Mat(Size size, int _type)
+    {
+        create(size.height, size.width, _type);
+    }
+
+    Mat::~Mat()
+    {
+        release();
+    }
+
+    Mat& Mat::operator = (const Mat& m)
+    {
+        if (this != &m)
+        {
+            if (m.u != nullptr)
+            {
+                m.u->refcount.fetch_add(1, std::memory_order_relaxed);
+            }
+            release();
+            type = m.type;
+            rows = m.rows;
+            cols = m.cols;
+            step[0] = m.step[0];
+            step[1] = m.step[1];
+            data = m.data;
+            u = m.u;
+        }
+        return *this;
+    }
+
+    Mat& Mat::operator = (Mat&& m)
+    {
+        if (this != &m)
+        {
+            release();
+            type = m.type;
+            rows = m.rows;
+            cols = m.cols;
+            step[0] = m.step[0];
+            step[1] = m.step[1];
+            data = m.data;
+            u = m.u;
+            m.u = nullptr;
+            m.release();
+        }
+        return *this;
+    }
+
+    void Mat::create(int _rows, int _cols, int _type, MatAllocator* allocator)
+    {
+        if (allocator == nullptr)
+        {
+            allocator = getDefaultAllocator();
+        }
+        if (u != nullptr && u->allocator == allocator && u->refcount.load(std::memory_order_relaxed) == 1 &&
+            type == _type && rows == _rows && cols == _cols && isContinuous() &&
+            data == reinterpret_cast<uint8_t*>(u) + mat_data_offset(allocator))
+        {
+            return;
+        }
+        release();
+        Mat m(_rows, _cols, _type, nullptr);
+        if (m.empty() || m.elemBits() == 0)
+        {
+            return;
+        }
+        size_t offset = mat_data_offset(allocator);
+        size_t size = offset + m.step[0] * m.rows;
+        void* block = allocator->allocate(size);
+        if (block == nullptr)
+        {
+            return;
+        }
+        m.u = new (block) MatData;
+        m.u->refcount.store(1, std::memory_order_relaxed);
+        m.u->allocator = allocator;
+        m.u->size = size;
+        m.data = reinterpret_cast<uint8_t*>(block) + offset;
+        *this = std::move(m);
+    }
+
+    void Mat::create(Size size, int _type, MatAllocator* allocator)
+    {
+        create(size.height, size.width, _type, allocator);
+    }
+
+    void Mat::release()
+    {
+        if (u != nullptr && u->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            MatAllocator* allocator = u->allocator;
+            size_t size = u->size;
+            u->~MatData();
+            allocator->deallocate(u, size);
+        }
+        u = nullptr;
+        data = nullptr;
+        rows = cols = 0;
+        step[0] = step[1] = 0;
+    }
+
+    Mat Mat::clone(MatAllocator* allocator) const
+    {
+        Mat m;
+        m.create(rows, cols, type, allocator);
+        for (int y = 0; y < m.rows; y++)
+        {
+            memcpy(m.ptr<uint8_t>(y), ptr<uint8_t>(y), row_bytes(elemBits(), cols));
+        }
+        return m;
+    }
+
+    MatAllocator* Mat::getDefaultAllocator()
+    {
+        static HeapAllocator heap_allocator;
+        return default_allocator != nullptr ? default_allocator : &heap_allocator;
+    }
+
+    void Mat::setDefaultAllocator(MatAllocator* allocator)
+    {
+        default_allocator = allocator;
+    }
+
     Mat::Mat(int _rows, int _cols, int _type, void* _data, size_t _step)
         : type(_type), rows(_rows), cols(_cols), data(reinterpret_cast<uint8_t*>(_data))
     {
@@ -276,7 +657,7 @@ namespace cv
         step[1] = elemSize();
         if(_step == 0)
         {
-            step[0] = _cols * step[1];
+            step[0] = row_bytes(elemBits(), _cols);
         }
     }
 
@@ -287,16 +668,28 @@ namespace cv
         step[1] = elemSize();
         if(_step == 0)
         {
-            step[0] = size.width * step[1];
+            step[0] = row_bytes(elemBits(), size.width);
         }
     }
 
     Mat::Mat(const Mat& m, const Rect& roi)
-        : type(m.type), rows(roi.height), cols(roi.width), data(m.data + roi.y*m.step[0])
+        : type(m.type), rows(roi.height), cols(roi.width), data(m.data + roi.y*m.step[0]), u(m.u)
     {
         step[0] = m.step[0];
         step[1] = m.step[1];
-        data += roi.x * m.step[1];
+        data += roi.x * m.elemBits() / 8;
+        // An odd column would land mid-byte, so such L4 ROIs are empty
+        if (type == L4 && (roi.x & 1))
+        {
+            rows = cols = 0;
+            data = nullptr;
+            u = nullptr;
+            step[0] = step[1] = 0;
+        }
+        if (u != nullptr)
+        {
+            u->refcount.fetch_add(1, std::memory_order_relaxed);
+        }
     }
 
     Mat::Mat(const Mat& m, const Range& _rowRange, const Range& _colRange)
@@ -309,8 +702,13 @@ namespace cv
         }
         if( _colRange != Range::all() && _colRange != Range(0,cols) )
         {
+            if (type == L4 && (_colRange.start & 1))
+            {
+                release();
+                return;
+            }
             cols = _colRange.size();
-            data += step[1]*_colRange.start;
+            data += _colRange.start * elemBits() / 8;
         }
     }
 
@@ -334,42 +732,38 @@ namespace cv
         return Mat(*this, Range::all(), Range(startcol, endcol));
     }
 
-    Mat& Mat::operator =(const uint16_t& s)
+    Mat& Mat::operator = (uint32_t s)
     {
-        switch (type)
-        {
-        case MONO8:
+        if (type == L4)
         {
-            uint8_t v = static_cast<uint8_t>(s);
-            if (isContinuous())
-            {
-                memset(ptr<uint8_t>(), v, total());
-            }
-            else
+            // two pixels per byte, an odd width ends in a low nibble
+            uint8_t v = uint8_t((s & 0x0F) * 0x11);
+            for (int y = 0; y < rows; y++)
             {
-                for (int y = 0; y < rows; y++)
+                uint8_t* p = ptr<uint8_t>(y);
+                memset(p, v, cols / 2);
+                if (cols & 1)
                 {
-                    memset(ptr<uint8_t>(y), static_cast<size_t>(cols), v);
+                    p[cols / 2] = uint8_t((p[cols / 2] & 0xF0) | (v & 0x0F));
                 }
             }
-            break;
+            return *this;
         }
-        case RGB565:
-        {
+        dispatch_pixel_format(type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            typename PF::value_type v = PF::from_color(s);
             if (isContinuous())
             {
-                std::fill_n(ptr<uint16_t>(), total(), s);
+                PF::hline(data, 0, int(total()) - 1, v);
             }
             else
             {
                 for (int y = 0; y < rows; y++)
                 {
-                    std::fill_n(ptr<uint16_t>(y), static_cast<size_t>(cols), s);
+                    PF::hline(ptr<uint8_t>(y), 0, cols - 1, v);
                 }
             }
-            break;
-        }
-        }
+        });
         return *this;
     }
 
@@ -380,7 +774,7 @@ namespace cv
 
     bool Mat:: isContinuous() const
     {
-        return step[0] == step[1] * cols;
+        return step[0] == row_bytes(elemBits(), cols);
     }
 
     Size Mat:: size() const
@@ -393,13 +787,24 @@ namespace cv
         switch(type)
         {
             case MONO8:
+            case A8:
                 return 1;
             case RGB565:
+            case ARGB4444:
                 return 2;
+            case RGB888:
+                return 3;
+            case ARGB8888:
+                return 4;
         }
         return 0;
     }
 
+    size_t Mat::elemBits() const
+    {
+        return type == L4 ? 4 : elemSize() * 8;
+    }
+
     bool Mat::empty() const
     {
         return cols <= 0 || rows <= 0;
@@ -410,6 +815,65 @@ namespace cv
         return cols * rows;
     }
 
+    // copy the first cols pixels of a row, keeping the high nibble of the
+    // last byte of an odd L4 row
+    static void copy_row(uint8_t* dst, const uint8_t* src, size_t bits, int cols, bool overlap)
+    {
+        size_t whole_bytes = cols * bits / 8;
+        size_t last = whole_bytes;
+        uint8_t nibble = 0;
+        bool partial = (cols * bits) % 8 != 0;
+        if (partial)
+        {
+            nibble = src[last] & 0x0F;
+        }
+        if (overlap)
+        {
+            memmove(dst, src, whole_bytes);
+        }
+        else
+        {
+            copy_span(dst, src, whole_bytes);
+        }
+        if (partial)
+        {
+            dst[last] = uint8_t((dst[last] & 0xF0) | nibble);
+        }
+    }
+
+    void CpuBlitter::copy(const Mat& src, const Mat& dst)
+    {
+        Mat target(dst);
+        const size_t bits = dst.elemBits();
+        for (int y = 0; y < dst.rows; y++)
+        {
+            copy_row(target.ptr<uint8_t>(y), src.ptr<uint8_t>(y), bits, dst.cols, false);
+        }
+    }
+
+    // whether any of rows rows of row_size bytes at src and dst, both
+    // step bytes apart, share bytes
+    static bool rows_overlap(const uint8_t* src, const uint8_t* dst, size_t step, int rows, size_t row_size)
+    {
+        ptrdiff_t offset = dst - src;
+        ptrdiff_t row_step = ptrdiff_t(step);
+        // dst row j starts offset + (j - i) * step bytes after src row i
+        ptrdiff_t nearest = -offset / row_step;
+        for (ptrdiff_t k = nearest - 1; k <= nearest + 1; k++)
+        {
+            if (k <= -rows || k >= rows)
+            {
+                continue;
+            }
+            ptrdiff_t distance = offset + k * row_step;
+            if (distance < ptrdiff_t(row_size) && -distance < ptrdiff_t(row_size))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool Mat::copyTo(Mat arr) const
     {
         if (type != arr.type)
@@ -418,28 +882,69 @@ namespace cv
         }
         int rows_to_copy = std::min(rows, arr.rows);
         int cols_to_copy = std::min(cols, arr.cols);
-        if (rows_to_copy > 0 && cols_to_copy > 0)
+        if (rows_to_copy <= 0 || cols_to_copy <= 0 || (data == arr.data && step[0] == arr.step[0]))
+        {
+            return true;
+        }
+        const size_t bits = elemBits();
+        const size_t bytes_per_row = row_bytes(bits, cols_to_copy);
+        const uint8_t* src_begin = data;
+        const uint8_t* src_end = ptr<uint8_t>(rows_to_copy - 1) + bytes_per_row;
+        const uint8_t* dst_begin = arr.data;
+        const uint8_t* dst_end = arr.ptr<uint8_t>(rows_to_copy - 1) + bytes_per_row;
+        bool overlap = src_begin < dst_end && dst_begin < src_end;
+        if (overlap && step[0] == arr.step[0])
+        {
+            // interleaved ROIs of one buffer may still be disjoint
+            overlap = rows_overlap(src_begin, dst_begin, step[0], rows_to_copy, bytes_per_row);
+        }
+
+        const Mat src_block = (*this)(Rect(0, 0, cols_to_copy, rows_to_copy));
+        const Mat dst_block = arr(Rect(0, 0, cols_to_copy, rows_to_copy));
+        Blitter& blitter = selectBlitter(BLIT_COPY, src_block, dst_block);
+
+        // continuous and equally wide: one block, padding bits included
+        if (isContinuous() && arr.isContinuous() && cols == arr.cols)
         {
-            switch (type)
+            size_t size = step[0] * rows_to_copy;
+            if (overlap)
             {
-            case MONO8:
+                memmove(arr.data, data, size);
+                return true;
+            }
+            if (&blitter == getCpuBlitter())
             {
-                for (int y = 0; y < rows_to_copy; y++)
+                copy_span(arr.data, data, size);
+                return true;
+            }
+        }
+
+        if (overlap)
+        {
+            // views of one buffer share the row step; copy the rows away
+            // from the destination first
+            if (step[0] != arr.step[0])
+            {
+                return false;
+            }
+            if (dst_begin > src_begin)
+            {
+                for (int y = rows_to_copy - 1; y >= 0; y--)
                 {
-                    std::copy_n(ptr<uint8_t>(), cols_to_copy, arr.ptr<uint8_t>());
+                    copy_row(arr.ptr<uint8_t>(y), ptr<uint8_t>(y), bits, cols_to_copy, true);
                 }
-                break;
             }
-            case RGB565:
+            else
             {
                 for (int y = 0; y < rows_to_copy; y++)
                 {
-                    std::copy_n(ptr<uint16_t>(), cols_to_copy, arr.ptr<uint16_t>());
+                    copy_row(arr.ptr<uint8_t>(y), ptr<uint8_t>(y), bits, cols_to_copy, true);
                 }
-                break;
-            }
             }
+            return true;
         }
+
+        blitter.copy(src_block, dst_block);
         return true;
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "mbed.h"
+#include <atomic>
+#include <vector>
 
 // basic types for image processing
 
@@ -149,30 +151,277 @@ namespace cv
         int start = 0, end = 0;
     };
 
-    enum MatType { MONO8 = 0, RGB332 = 0, RGB565 = 1 };
+    // Pixel values of each type, as passed to Mat::operator= and Painter:
+    // RGB332 0xRRRGGGBB, RGB565 0xRRRRRGGGGGGBBBBB, ARGB8888 0xAARRGGBB,
+    // RGB888 0xRRGGBB, ARGB4444 0xARGB, A8 alpha, L4 palette index 0~15
+    // L4 packs two pixels per byte, the left one in the low nibble, so L4
+    // ROIs must start at an even column; one starting at an odd column
+    // (Rect or colRange) gives an empty Mat
+    enum MatType { MONO8 = 0, RGB332 = 0, RGB565 = 1, ARGB8888 = 2, RGB888 = 3, ARGB4444 = 4, A8 = 5, L4 = 6 };
     constexpr size_t AUTO_STEP = 0;
 
+    // RGB888 pixel in memory order (the layout used by LTDC and DMA2D)
+    #pragma pack(push, 1)
+    typedef struct _rgb888_t
+    {
+        uint8_t b;
+        uint8_t g;
+        uint8_t r;
+    } rgb888_t;
+    #pragma pack(pop)
+
+    // Memory source for owning Mats
+    class MatAllocator
+    {
+    public:
+        virtual ~MatAllocator() = default;
+
+        // returns nullptr when out of memory
+        virtual void* allocate(size_t size) = 0;
+
+        // size is the value passed to allocate()
+        virtual void deallocate(void* ptr, size_t size) = 0;
+
+        // guaranteed alignment of allocated blocks
+        virtual size_t alignment() const = 0;
+    };
+
+    // General heap (malloc/free)
+    class HeapAllocator : public MatAllocator
+    {
+    public:
+        virtual void* allocate(size_t size) override;
+        virtual void deallocate(void* ptr, size_t size) override;
+        virtual size_t alignment() const override;
+    };
+
+    // Heap blocks aligned for SIMD loads/stores or cache line maintenance
+    class AlignedAllocator : public MatAllocator
+    {
+    public:
+        // _alignment must be a power of two
+        AlignedAllocator(size_t _alignment = 32);
+        virtual void* allocate(size_t size) override;
+        virtual void deallocate(void* ptr, size_t size) override;
+        virtual size_t alignment() const override;
+
+    private:
+        size_t block_alignment;
+    };
+
+    // First-fit allocator over a fixed memory region, e.g. a static array,
+    // DTCM/SRAM bank or external SDRAM. Freed blocks are merged with their
+    // neighbours, and the region never touches the heap.
+    // Not thread-safe.
+    class ArenaAllocator : public MatAllocator
+    {
+    public:
+        // _alignment must be a power of two, blocks default to 32 bytes (D-cache line)
+        ArenaAllocator(void* base, size_t size, size_t _alignment = 32);
+        ArenaAllocator(const ArenaAllocator&) = delete;
+        ArenaAllocator& operator = (const ArenaAllocator&) = delete;
+        virtual void* allocate(size_t size) override;
+        virtual void deallocate(void* ptr, size_t size) override;
+        virtual size_t alignment() const override;
+
+        size_t free_bytes() const;
+        size_t largest_free_block() const;
+
+    private:
+        struct FreeBlock
+        {
+            size_t size;
+            FreeBlock* next;
+        };
+        size_t block_size(size_t size) const;
+
+        FreeBlock* free_list = nullptr;
+        size_t block_alignment;
+    };
+
+    // ArenaAllocator over a static array of N bytes
+    template<size_t N>
+    class StaticArenaAllocator : public ArenaAllocator
+    {
+    public:
+        StaticArenaAllocator()
+            : ArenaAllocator(storage, N)
+        {
+        }
+
+    private:
+        alignas(32) uint8_t storage[N];
+    };
+
+    // Bump allocator for short-lived drawing scratch memory (polygon edges,
+    // ellipse points, glyph and text layout data). Allocation is a pointer
+    // increment and memory is only reclaimed by reset(), which the render loop
+    // calls once per frame. No scratch allocation outlives the drawing call
+    // that made it, so reset() is safe between any two calls.
+    // Not thread-safe.
+    class FrameArena
+    {
+    public:
+        FrameArena(void* buffer, size_t size);
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator = (const FrameArena&) = delete;
+
+        // returns nullptr when the arena is exhausted
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        // memory is reclaimed only if ptr is the most recent allocation
+        void deallocate(void* ptr, size_t size);
+
+        bool owns(const void* ptr) const;
+
+        // release every allocation
+        void reset();
+
+        size_t capacity() const;
+        size_t used() const;
+        // largest used() since construction, to size the arena
+        size_t high_water_mark() const;
+        // allocations served, and refused because the arena was full, since construction
+        uint32_t allocation_count() const;
+        uint32_t overflow_count() const;
+
+    private:
+        uint8_t* base;
+        uint8_t* top;
+        uint8_t* end;
+        size_t high_water = 0;
+        uint32_t allocations = 0;
+        uint32_t overflows = 0;
+    };
+
+    // FrameArena over a static array of N bytes
+    template<size_t N>
+    class StaticFrameArena : public FrameArena
+    {
+    public:
+        StaticFrameArena()
+            : FrameArena(storage, N)
+        {
+        }
+
+    private:
+        alignas(8) uint8_t storage[N];
+    };
+
+    // STL allocator drawing from a FrameArena, falling back to the heap when
+    // no arena is set or the arena is full
+    template<typename T>
+    class FrameAllocator
+    {
+    public:
+        using value_type = T;
+
+        FrameAllocator(FrameArena* _arena = nullptr) noexcept
+            : arena(_arena)
+        {
+        }
+
+        template<typename U>
+        FrameAllocator(const FrameAllocator<U>& other) noexcept
+            : arena(other.arena)
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            if (arena != nullptr)
+            {
+                void* p = arena->allocate(n * sizeof(T), alignof(T));
+                if (p != nullptr)
+                {
+                    return static_cast<T*>(p);
+                }
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t n)
+        {
+            if (arena != nullptr && arena->owns(p))
+            {
+                arena->deallocate(p, n * sizeof(T));
+            }
+            else
+            {
+                ::operator delete(p);
+            }
+        }
+
+        FrameArena* arena;
+    };
+
+    template<typename T, typename U>
+    inline bool operator == (const FrameAllocator<T>& a, const FrameAllocator<U>& b)
+    {
+        return a.arena == b.arena;
+    }
+
+    template<typename T, typename U>
+    inline bool operator != (const FrameAllocator<T>& a, const FrameAllocator<U>& b)
+    {
+        return a.arena != b.arena;
+    }
+
+    template<typename T>
+    using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+    // Reference counted buffer of an owning Mat, placed in front of the pixel data
+    struct MatData
+    {
+        std::atomic<int> refcount;
+        MatAllocator* allocator;
+        size_t size;
+    };
+
     class Mat
     {
     public:
         Mat() = default;
-        Mat(const Mat& m) = default;
+        Mat(const Mat& m);
+        Mat(Mat&& m);
+        // Owning Mat allocated from the default allocator
+        Mat(int _rows, int _cols, int _type);
+        Mat(Size size, int _type);
+        // Mat wrapping caller managed data
         Mat(int _rows, int _cols, int _type, void* _data, size_t _step=AUTO_STEP);
         Mat(Size size, int _type, void* _data, size_t _step=AUTO_STEP);
         Mat(const Mat& m, const Rect& roi);
         Mat(const Mat& m, const Range& rowRange, const Range& colRange=Range::all());
-        Mat& operator = (const Mat& m) = default;
+        ~Mat();
+        Mat& operator = (const Mat& m);
+        Mat& operator = (Mat&& m);
+        // Allocate owned, continuous data, from the default allocator if allocator is nullptr
+        // Existing data is kept if the size and type match and it is not shared
+        // The Mat is left empty if the allocator is out of memory
+        void create(int _rows, int _cols, int _type, MatAllocator* allocator = nullptr);
+        void create(Size size, int _type, MatAllocator* allocator = nullptr);
+        // Drop the reference to the data, freeing it if this was the last owner
+        void release();
+        // Deep copy into newly allocated data
+        Mat clone(MatAllocator* allocator = nullptr) const;
         Mat row(int y) const;
         Mat col(int x) const;
         Mat rowRange(int startrow, int endrow) const;
         Mat colRange(int startcol, int endcol) const;
-        Mat& operator = (const uint16_t& s);
+        // Fill with a pixel value of the Mat type
+        Mat& operator = (uint32_t s);
         Mat operator()( const Rect& roi ) const;
         Size size() const;
         bool isContinuous() const;
+        // bytes per pixel, 0 for L4
         size_t elemSize() const;
+        // bits per pixel
+        size_t elemBits() const;
         bool empty() const;
         size_t total() const;
+        // Copy the overlapping top-left area into arr, which must have the
+        // same type. Views of one buffer may overlap (memmove semantics),
+        // other copies go through selectBlitter (see cvblit.h)
         bool copyTo(Mat arr) const;
     
         template<typename _Tp> _Tp* ptr(int row = 0)
@@ -205,10 +454,15 @@ namespace cv
             return *reinterpret_cast<const _Tp*>(data + row * step[0] + col * step[1]);
         }
 
+        static MatAllocator* getDefaultAllocator();
+        static void setDefaultAllocator(MatAllocator* allocator);
+
         int type = 0;
         int rows = 0, cols = 0;
         size_t step[2] = { 0, 0 };
         uint8_t* data = nullptr;
+        // owned buffer, nullptr if the data is managed by the caller
+        MatData* u = nullptr;
     };
 
     inline bool operator == (const Point& a, const Point& b)
@@ -310,6 +564,16 @@ namespace cv
         return a;
     }
 
+    inline Rect operator + (const Rect& a, const Point& b)
+    {
+        return Rect(a.x + b.x, a.y + b.y, a.width, a.height);
+    }
+
+    inline Rect operator - (const Rect& a, const Point& b)
+    {
+        return Rect(a.x - b.x, a.y - b.y, a.width, a.height);
+    }
+
     inline Rect operator & (const Rect& a, const Rect& b)
     {
         Rect c = a;
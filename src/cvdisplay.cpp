@@ -0,0 +1,292 @@
+#include "cvdisplay.h"
+#include "cvimgproc.h"
+
+namespace cv
+{
+#if DEVICE_SPI_ASYNCH
+    SPIDisplaySink::SPIDisplaySink(SPI& _spi, DigitalOut& _dc)
+        : spi(_spi), dc(_dc)
+    {
+    }
+
+    void SPIDisplaySink::command(uint8_t cmd, const uint8_t* params, int count)
+    {
+        dc = 0;
+        spi.write(cmd);
+        dc = 1;
+        for(int i = 0; i < count; i++)
+        {
+            spi.write(params[i]);
+        }
+    }
+
+    void SPIDisplaySink::set_window(const Rect& rect)
+    {
+        wait();
+        int x1 = rect.x + rect.width - 1, y1 = rect.y + rect.height - 1;
+        const uint8_t columns[4] = { uint8_t(rect.x >> 8), uint8_t(rect.x), uint8_t(x1 >> 8), uint8_t(x1) };
+        const uint8_t rows[4] = { uint8_t(rect.y >> 8), uint8_t(rect.y), uint8_t(y1 >> 8), uint8_t(y1) };
+        command(0x2A, columns, 4); // CASET
+        command(0x2B, rows, 4); // RASET
+        command(0x2C, nullptr, 0); // RAMWR, pixel data follows
+    }
+
+    void SPIDisplaySink::send(const uint8_t* data, size_t size)
+    {
+        wait();
+#if defined (__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+        uint32_t aligned_addr = uint32_t(data) & ~0x1F;
+        SCB_CleanDCache_by_Addr((uint32_t*)aligned_addr, size + (uint32_t(data) - aligned_addr));
+#endif
+        busy = true;
+        spi.transfer(data, int(size), (uint8_t*)nullptr, 0, callback(this, &SPIDisplaySink::transfer_done), SPI_EVENT_COMPLETE);
+    }
+
+    void SPIDisplaySink::wait()
+    {
+        while(busy)
+        {
+        }
+    }
+
+    void SPIDisplaySink::transfer_done(int)
+    {
+        busy = false;
+    }
+#endif
+
+    FlushStage::FlushStage(DisplaySink& _sink, uint8_t* buffer0, uint8_t* buffer1, size_t buffer_size)
+        : sink(_sink), buffers{ buffer0, buffer1 }, chunk_pixels(buffer_size / 2)
+    {
+    }
+
+    size_t FlushStage::convert_chunk(uint8_t* buffer)
+    {
+        size_t pixels = 0;
+        while(pixels < chunk_pixels && next_y < area.y + area.height)
+        {
+            int count = int(std::min(size_t(area.x + area.width - next_x), chunk_pixels - pixels));
+            Mat target(1, count, RGB565, buffer + pixels * 2);
+            cvtColor(source(Rect(next_x, next_y, count, 1)), target, source_format, COLOR_RGB565_SWAPPED);
+            pixels += count;
+            next_x += count;
+            if(next_x == area.x + area.width)
+            {
+                next_x = area.x;
+                next_y++;
+            }
+        }
+        return pixels * 2;
+    }
+
+    bool FlushStage::flush(const Mat& mat, Rect rect)
+    {
+        switch(mat.type)
+        {
+        case MONO8:
+            source_format = COLOR_RGB332;
+            break;
+        case RGB565:
+            source_format = COLOR_RGB565;
+            break;
+        case RGB888:
+            source_format = COLOR_RGB888;
+            break;
+        case ARGB8888:
+            source_format = COLOR_ARGB8888;
+            break;
+        default:
+            return false;
+        }
+        rect &= Rect(0, 0, mat.cols, mat.rows);
+        if(rect.empty() || chunk_pixels == 0)
+        {
+            return true;
+        }
+        source = mat;
+        area = rect;
+        next_x = rect.x;
+        next_y = rect.y;
+
+        sink.set_window(rect);
+        int current = 0;
+        size_t size = convert_chunk(buffers[current]);
+        while(size > 0)
+        {
+            sink.send(buffers[current], size);
+            if(buffers[1] != nullptr)
+            {
+                current ^= 1;
+            }
+            else
+            {
+                sink.wait();
+            }
+            // send() returned after the transfer from this buffer completed
+            size = convert_chunk(buffers[current]);
+        }
+        sink.wait();
+        source.release();
+        return true;
+    }
+
+    bool FlushStage::flush(Painter& painter)
+    {
+        bool result = true;
+        Mat mat = painter.get_mat();
+        for(const Rect& rect : painter.get_dirty_region())
+        {
+            result = flush(mat, rect) && result;
+        }
+        painter.reset_dirty_rect();
+        return result;
+    }
+
+#if HAS_DMA2D
+    Dma2dFlushStage::Dma2dFlushStage(DisplaySink& _sink, uint8_t* _buffer, size_t _buffer_size, int _band_lines)
+        : sink(_sink), buffer(_buffer), buffer_size(_buffer_size), band_lines(_band_lines)
+    {
+    }
+
+    bool Dma2dFlushStage::flush(const Mat& mat, Rect rect)
+    {
+        rect &= Rect(0, 0, mat.cols, mat.rows);
+        const size_t row_bytes = size_t(rect.width) * 2;
+        if(mat.type != MONO8 || (!rect.empty() && row_bytes > buffer_size))
+        {
+            return false;
+        }
+        if(rect.empty())
+        {
+            return true;
+        }
+        const int buffer_rows = int(std::min(buffer_size / row_bytes, size_t(0xFFFF)));
+        sink.set_window(rect);
+        for(int y = rect.y; y < rect.y + rect.height; y += buffer_rows)
+        {
+            const int rows = std::min(buffer_rows, rect.y + rect.height - y);
+            // the buffer is free once the sink has sent its last rows
+            sink.wait();
+            const dma2d_fence_t fence = dma2d_submit_flat_rgb332_to_rgb565(mat, Rect(rect.x, y, rect.width, rows), buffer, band_lines);
+            int sent = 0;
+            while(sent < rows)
+            {
+                const int lines = std::min(dma2d_fence_lines(fence), rows);
+                if(lines > sent)
+                {
+                    // waits for the previous lines, the DMA2D converting on
+                    sink.send(buffer + sent * row_bytes, (lines - sent) * row_bytes);
+                    sent = lines;
+                }
+                else
+                {
+                    ThisThread::yield();
+                }
+            }
+        }
+        sink.wait();
+        return true;
+    }
+
+    bool Dma2dFlushStage::flush(Painter& painter)
+    {
+        bool result = true;
+        Mat mat = painter.get_mat();
+        for(const Rect& rect : painter.get_dirty_region())
+        {
+            result = flush(mat, rect) && result;
+        }
+        painter.reset_dirty_rect();
+        return result;
+    }
+#endif
+
+    FrameBufferSet::FrameBufferSet(Size size, int type, int _count, MatAllocator* allocator)
+        : count(std::min(std::max(_count, 1), MAX_BUFFERS))
+    {
+        for(int i = 0; i < count; i++)
+        {
+            buffers[i].create(size, type, allocator);
+        }
+        init();
+    }
+
+    FrameBufferSet::FrameBufferSet(const Mat* _buffers, int _count)
+        : count(std::min(std::max(_count, 1), MAX_BUFFERS))
+    {
+        for(int i = 0; i < count; i++)
+        {
+            buffers[i] = _buffers[i];
+        }
+        init();
+    }
+
+    void FrameBufferSet::init()
+    {
+        Rect whole(0, 0, buffers[0].cols, buffers[0].rows);
+        for(int i = 1; i < count; i++)
+        {
+            stale[i].add(whole);
+        }
+    }
+
+    void FrameBufferSet::present(const DirtyRegion& dirty)
+    {
+        // the back buffer becomes the front, the others fall further behind
+        stale[back_index].clear();
+        for(int i = 0; i < count; i++)
+        {
+            if(i != back_index)
+            {
+                for(const Rect& rect : dirty)
+                {
+                    stale[i].add(rect);
+                }
+            }
+        }
+        const Mat& front_buffer = buffers[back_index];
+        back_index = (back_index + 1) % count;
+        carried_bytes = 0;
+        if(count == 1)
+        {
+            return;
+        }
+        Mat& back_buffer = buffers[back_index];
+        for(const Rect& rect : stale[back_index])
+        {
+            Rect area = rect & Rect(0, 0, back_buffer.cols, back_buffer.rows);
+            if(!area.empty())
+            {
+                front_buffer(area).copyTo(back_buffer(area));
+                carried_bytes += area.area() * back_buffer.elemBits() / 8;
+            }
+        }
+        stale[back_index].clear();
+    }
+
+    void FrameBufferSet::present(Painter& painter)
+    {
+        present(painter.get_dirty_region());
+        painter.reset_dirty_rect();
+    }
+
+    Mat FrameBufferSet::back() const
+    {
+        return buffers[back_index];
+    }
+
+    Mat FrameBufferSet::front() const
+    {
+        return buffers[(back_index + count - 1) % count];
+    }
+
+    int FrameBufferSet::get_count() const
+    {
+        return count;
+    }
+
+    size_t FrameBufferSet::get_carried_bytes() const
+    {
+        return carried_bytes;
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "mbed.h"
+#include "cvimgproc.h"
+
+// Display output: streaming Mat areas to a panel.
+// A DisplaySink moves bytes to the panel, normally by DMA. FlushStage
+// converts the pixels to the byte-swapped RGB565 SPI panels take, one chunk
+// at a time, and overlaps converting the next chunk with sending the
+// previous one. Dma2dFlushStage has the DMA2D convert RGB332 frames for
+// 16-bit panels and sends the lines it finished while it converts the next.
+// FrameBufferSet cycles the framebuffers of a scanned-out (LTDC) display.
+
+namespace cv
+{
+
+    // Receives a flush: an address window, then its pixels in row-major order
+    class DisplaySink
+    {
+    public:
+        virtual ~DisplaySink() = default;
+        // set the panel window the following pixels fill, after the previous
+        // transfer has completed
+        virtual void set_window(const Rect& rect) = 0;
+        // wait for the previous transfer, then start sending size bytes;
+        // data must stay untouched until the transfer has completed
+        virtual void send(const uint8_t* data, size_t size) = 0;
+        // block until the last send has completed
+        virtual void wait() = 0;
+    };
+
+#if DEVICE_SPI_ASYNCH
+    // Sink for SPI panels with MIPI DCS commands (ILI9341, ST7789 and alike):
+    // CASET / RASET / RAMWR set the window, pixel data goes by asynchronous
+    // SPI transfers. The SPI must be in 8-bit mode; dc selects data (1) or
+    // command (0).
+    class SPIDisplaySink : public DisplaySink
+    {
+    public:
+        SPIDisplaySink(SPI& spi, DigitalOut& dc);
+        void set_window(const Rect& rect) override;
+        void send(const uint8_t* data, size_t size) override;
+        void wait() override;
+
+    private:
+        void command(uint8_t cmd, const uint8_t* params, int count);
+        void transfer_done(int event);
+
+        SPI& spi;
+        DigitalOut& dc;
+        volatile bool busy = false;
+    };
+#endif
+
+    // Sends Mat areas (RGB332, RGB565, RGB888 or ARGB8888) to a DisplaySink
+    // as byte-swapped RGB565, in chunks of the given buffers. With a second
+    // buffer the chunks are converted in one buffer while the other is sent;
+    // with one buffer conversion and transfer alternate.
+    // The buffers are caller-managed, 2-byte aligned, of buffer_size bytes.
+    class FlushStage
+    {
+    public:
+        FlushStage(DisplaySink& sink, uint8_t* buffer0, uint8_t* buffer1, size_t buffer_size);
+        // Send rect of mat, clipped to the mat. Returns false for other Mat types
+        bool flush(const Mat& mat, Rect rect);
+        // Send each rect of the dirty region of a Painter, then reset it
+        bool flush(Painter& painter);
+
+    private:
+        // convert the next pixels of the flush into buffer, returns the bytes written
+        size_t convert_chunk(uint8_t* buffer);
+
+        DisplaySink& sink;
+        uint8_t* buffers[2];
+        size_t chunk_pixels;
+        // state of the current flush
+        Mat source;
+        int source_format = 0;
+        Rect area;
+        int next_x = 0, next_y = 0;
+    };
+
+#if HAS_DMA2D
+    // Sends RGB332 Mat areas to a DisplaySink as RGB565 in native byte order
+    // (16-bit parallel panels), converted by the DMA2D into the given buffer,
+    // as many rows at a time as it holds. The DMA2D raises its line-watermark
+    // interrupt every band_lines lines, and the lines converted so far go to
+    // the sink while the next ones convert; 0 band_lines waits for the
+    // conversion of all the rows before sending them.
+    // The buffer is caller-managed, 2-byte aligned, of buffer_size bytes.
+    class Dma2dFlushStage
+    {
+    public:
+        Dma2dFlushStage(DisplaySink& sink, uint8_t* buffer, size_t buffer_size, int band_lines = 16);
+        // Send rect of mat, clipped to the mat. Returns false for other Mat
+        // types and for rows longer than the buffer
+        bool flush(const Mat& mat, Rect rect);
+        // Send each rect of the dirty region of a Painter, then reset it
+        bool flush(Painter& painter);
+
+    private:
+        DisplaySink& sink;
+        uint8_t* buffer;
+        size_t buffer_size;
+        int band_lines;
+    };
+#endif
+
+    // Front and back framebuffers (two, or three for triple buffering).
+    // Frames are drawn into the back buffer; present makes it the front
+    // buffer, which the display shows, and moves on to the next buffer.
+    // That buffer still holds the frame it was last drawn with, so present
+    // copies into it, from the new front buffer, the areas changed by the
+    // frames presented since: the dirty regions passed to present, kept per
+    // buffer. A frame thus only redraws what changes in it, as with a single
+    // framebuffer. Copies go through Mat::copyTo, by DMA2D when available.
+    class FrameBufferSet
+    {
+    public:
+        static constexpr int MAX_BUFFERS = 3;
+
+        // count buffers of size and type from allocator, nullptr for the default
+        FrameBufferSet(Size size, int type, int count = 2, MatAllocator* allocator = nullptr);
+
+        // caller-managed buffers of equal size and type
+        FrameBufferSet(const Mat* buffers, int count);
+
+        // Swap after drawing the back buffer, where dirty holds the areas the
+        // frame changed. Areas a buffer has never been drawn in count as
+        // changed, so the first presents copy whole frames.
+        void present(const DirtyRegion& dirty);
+
+        // present the dirty region of painter, then reset it
+        void present(Painter& painter);
+
+        // the buffer to draw the next frame into
+        Mat back() const;
+
+        // the buffer presented last, shown by the display
+        Mat front() const;
+
+        int get_count() const;
+
+        // bytes copied into the back buffer by the last present
+        size_t get_carried_bytes() const;
+
+    private:
+        void init();
+
+        Mat buffers[MAX_BUFFERS];
+        // areas where each buffer differs from the front buffer
+        DirtyRegion stale[MAX_BUFFERS];
+        int count;
+        int back_index = 0;
+        size_t carried_bytes = 0;
+    };
+}
@@ -1,54 +1,23 @@
 #include "cvfonts.h"
+#include "cvpixel.h"
+#include "cvblit.h"
 #include <algorithm>
 
 namespace cv
 {
 
-    inline uint8_t alpha_blending_channel(uint8_t bg, uint8_t fg, uint8_t alpha)
-    {
-        return (uint8_t) ((uint16_t(fg) * alpha + bg * (7 - alpha)) / 7);
-    }
-
-    static uint8_t alpha_blending(uint8_t bg, uint8_t fg, uint8_t alpha)
-    {
-        // RGB332
-        uint8_t bg_r = uint8_t(bg >> 5);
-        uint8_t bg_g = uint8_t((bg >> 2) & 0x07);
-        uint8_t bg_b = uint8_t(bg & 0x03);
-        uint8_t fg_r = uint8_t(fg >> 5);
-        uint8_t fg_g = uint8_t((fg >> 2) & 0x07);
-        uint8_t fg_b = uint8_t(fg & 0x03);
-        uint8_t result_r = alpha_blending_channel(bg_r, fg_r, alpha);
-        uint8_t result_g = alpha_blending_channel(bg_g, fg_g, alpha);
-        uint8_t result_b = alpha_blending_channel(bg_b, fg_b, alpha);
-        uint8_t result = (result_r << 5) + (result_g << 2) + result_b;
-        return result;
-    }
-
-    static uint16_t alpha_blending(uint16_t bg, uint16_t fg, uint8_t alpha)
-    {
-        // RGB565
-        uint8_t bg_r = uint8_t(bg >> 11);
-        uint8_t bg_g = uint8_t((bg >> 5) & 0x3F);
-        uint8_t bg_b = uint8_t(bg & 0x1F);
-        uint8_t fg_r = uint8_t(fg >> 11);
-        uint8_t fg_g = uint8_t((fg >> 5) & 0x3F);
-        uint8_t fg_b = uint8_t(fg & 0x1F);
-        uint8_t result_r = alpha_blending_channel(bg_r, fg_r, alpha);
-        uint8_t result_g = alpha_blending_channel(bg_g, fg_g, alpha);
-        uint8_t result_b = alpha_blending_channel(bg_b, fg_b, alpha);
-        uint16_t result = (uint16_t(result_r) << 11) + (uint16_t(result_g) << 5) + result_b;
-        return result;
-    }
-
-    template<typename value_type>
-    static void decode_char_direct(const std::vector<uint8_t>& char_data, uint8_t width, uint8_t height, cv::Mat result, value_type text_color)
+    // decode a glyph into a Mat of pixel format PF, anti-aliased pixels are
+    // blended over the existing content with 8 alpha levels by
+    // blend(bg, text_color, level)
+    template<typename PF, typename Blend>
+    static void decode_char_direct(const uint8_t* char_data, size_t char_data_size, uint8_t width, cv::Mat result, typename PF::value_type text_color, const Blend& blend)
     {
+        typedef typename PF::value_type value_type;
         int x = 0, y = 0;
         value_type* p_row = result.ptr<value_type>(y);
         if (char_data[0] == 1)
         {
-            for (size_t index = 1; index < char_data.size(); index++)
+            for (size_t index = 1; index < char_data_size; index++)
             {
                 uint8_t char_byte = char_data[index];
                 uint8_t op_type = char_byte >> 5;
@@ -193,7 +162,7 @@ namespace cv
         }
         else if (char_data[0] == 3)
         {
-            for (size_t index = 1; index < char_data.size(); index++)
+            for (size_t index = 1; index < char_data_size; index++)
             {
                 uint8_t char_byte = char_data[index];
                 uint8_t op_type = char_byte >> 5;
@@ -269,7 +238,7 @@ namespace cv
                         y++;
                     }
                     p_row = result.ptr<value_type>(y);
-                    p_row[x] = alpha_blending(p_row[x], text_color, op_param2);
+                    p_row[x] = blend(p_row[x], text_color, op_param2);
                     if (++x >= width) {
                         p_row = result.ptr<value_type>(++y);
                         x = 0;
@@ -282,12 +251,12 @@ namespace cv
                     // 2͸
                     uint8_t op_param1 = (char_byte >> 3) & 7;
                     uint8_t op_param2 = char_byte & 7;
-                    p_row[x] = alpha_blending(p_row[x], text_color, op_param1);
+                    p_row[x] = blend(p_row[x], text_color, op_param1);
                     if (++x >= width) {
                         p_row = result.ptr<value_type>(++y);
                         x = 0;
                     }
-                    p_row[x] = alpha_blending(p_row[x], text_color, op_param2);
+                    p_row[x] = blend(p_row[x], text_color, op_param2);
                     if (++x >= width) {
                         p_row = result.ptr<value_type>(++y);
                         x = 0;
@@ -298,6 +267,194 @@ namespace cv
         }
     }
 
+    // alpha of anti-aliasing level 0~7 in a glyph mask, as decoded by
+    // PixelFormat<A8>::blend; alpha >> 5 gives the level back
+    static constexpr uint32_t glyph_level_alpha(int level)
+    {
+        return 255 * level / 7;
+    }
+
+    // 8-bit channels (r, g, b) of a pixel of an opaque type, widened by bit
+    // replication as the DMA2D reads them
+    template<int Type>
+    static inline void read_channels(const uint8_t* p, uint32_t c[3])
+    {
+        if constexpr (Type == RGB565)
+        {
+            uint16_t v;
+            memcpy(&v, p, 2);
+            uint32_t r = v >> 11, g = (v >> 5) & 0x3F, b = v & 0x1F;
+            c[0] = (r << 3) | (r >> 2);
+            c[1] = (g << 2) | (g >> 4);
+            c[2] = (b << 3) | (b >> 2);
+        }
+        else if constexpr (Type == RGB888)
+        {
+            c[0] = p[2];
+            c[1] = p[1];
+            c[2] = p[0];
+        }
+        else
+        {
+            uint32_t r = p[0] >> 5, g = (p[0] >> 2) & 0x07, b = p[0] & 0x03;
+            c[0] = (r << 5) | (r << 2) | (r >> 1);
+            c[1] = (g << 5) | (g << 2) | (g >> 1);
+            c[2] = b * 0x55;
+        }
+    }
+
+    // and narrowed by truncation as the DMA2D writes them
+    template<int Type>
+    static inline void write_channels(uint8_t* p, const uint32_t c[3])
+    {
+        if constexpr (Type == RGB565)
+        {
+            uint16_t v = uint16_t(((c[0] & 0xF8) << 8) | ((c[1] & 0xFC) << 3) | (c[2] >> 3));
+            memcpy(p, &v, 2);
+        }
+        else if constexpr (Type == RGB888)
+        {
+            p[0] = uint8_t(c[2]);
+            p[1] = uint8_t(c[1]);
+            p[2] = uint8_t(c[0]);
+        }
+        else
+        {
+            p[0] = uint8_t((c[0] & 0xE0) | ((c[1] >> 3) & 0x1C) | (c[2] >> 6));
+        }
+    }
+
+    template<typename PF>
+    static inline typename PF::value_type blend_levels(typename PF::value_type bg, typename PF::value_type fg, uint8_t level)
+    {
+        return PF::blend(bg, fg, level, 7);
+    }
+
+    // Blend of the text color over pixels of an opaque type at the 8 levels
+    // of anti-aliased glyphs, with the arithmetic of the DMA2D blender on a
+    // glyph mask. The color's share and the background weight of each level
+    // come from a table.
+    template<typename PF>
+    class GlyphBlend
+    {
+    public:
+        typedef typename PF::value_type value_type;
+
+        GlyphBlend(value_type text_color)
+        {
+            uint32_t color[3];
+            read_channels<PF::type>(reinterpret_cast<const uint8_t*>(&text_color), color);
+            for (int level = 0; level < 8; level++)
+            {
+                const uint32_t alpha = glyph_level_alpha(level);
+                for (int i = 0; i < 3; i++)
+                {
+                    table[level].color[i] = color[i] * alpha;
+                }
+                table[level].background = 255 - alpha;
+            }
+        }
+
+        inline value_type operator()(value_type bg, value_type, uint8_t level) const
+        {
+            const auto& entry = table[level];
+            uint32_t c[3];
+            read_channels<PF::type>(reinterpret_cast<const uint8_t*>(&bg), c);
+            for (int i = 0; i < 3; i++)
+            {
+                c[i] = (entry.color[i] + c[i] * entry.background) / 255;
+            }
+            value_type result;
+            write_channels<PF::type>(reinterpret_cast<uint8_t*>(&result), c);
+            return result;
+        }
+
+    private:
+        struct
+        {
+            uint32_t color[3];
+            uint32_t background;
+        } table[8];
+    };
+
+    // Bit fields (shift, bits) of the channels of the packed opaque types
+    template<int Type>
+    struct ChannelFields;
+
+    template<>
+    struct ChannelFields<RGB565>
+    {
+        static constexpr int shift[3] = { 11, 5, 0 };
+        static constexpr int bits[3] = { 5, 6, 5 };
+        static constexpr int offset[3] = { 0, 32, 96 };
+        static constexpr int entries = 128;
+    };
+
+    template<>
+    struct ChannelFields<RGB332>
+    {
+        static constexpr int shift[3] = { 5, 2, 0 };
+        static constexpr int bits[3] = { 3, 3, 2 };
+        static constexpr int offset[3] = { 0, 8, 16 };
+        static constexpr int entries = 20;
+    };
+
+    // GlyphBlend of packed types by lookup: the channels blend on their own,
+    // so each level holds the blended field of every value of each channel
+    // and a pixel takes three lookups instead of widening, blending and
+    // narrowing its channels.
+    template<typename PF>
+    class GlyphBlendTable
+    {
+    public:
+        typedef typename PF::value_type value_type;
+        typedef ChannelFields<PF::type> Fields;
+
+        explicit GlyphBlendTable(const uint16_t* _table)
+            : table(_table)
+        {
+        }
+
+        // 8 levels of Fields::entries values
+        static void build(value_type text_color, uint16_t* table)
+        {
+            const GlyphBlend<PF> blend(text_color);
+            for (int level = 0; level < 8; level++)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    const uint32_t mask = (1u << Fields::bits[i]) - 1;
+                    for (uint32_t v = 0; v <= mask; v++)
+                    {
+                        const value_type out = blend(value_type(v << Fields::shift[i]), text_color, uint8_t(level));
+                        table[level * Fields::entries + Fields::offset[i] + v] = uint16_t(out & (mask << Fields::shift[i]));
+                    }
+                }
+            }
+        }
+
+        inline value_type operator()(value_type bg, value_type, uint8_t level) const
+        {
+            const uint16_t* t = table + level * Fields::entries;
+            uint32_t result = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                result |= t[Fields::offset[i] + ((bg >> Fields::shift[i]) & ((1u << Fields::bits[i]) - 1))];
+            }
+            return value_type(result);
+        }
+
+    private:
+        const uint16_t* table;
+    };
+
+    // blend a glyph mask into the top left of result
+    static void blend_glyph(const cv::Mat& mask, cv::Mat result, uint32_t text_color)
+    {
+        cv::Mat target = result(cv::Rect(0, 0, mask.cols, mask.rows));
+        selectBlitter(BLIT_BLEND, mask, target).blend(mask, target, 255, text_color);
+    }
+
 #if defined(MBED_CONF_FILESYSTEM_PRESENT) && (MBED_CONF_FILESYSTEM_PRESENT == 1)
     FontBase::FontBase(FileSystem *fs, const char *path)
         : font_file(fs, path)
@@ -319,7 +476,7 @@ namespace cv
         font_map_address = data_address + font_header->length_of_description;
     }
 
-    cv::Size FontBase::get_char_bitmap(uint16_t char_code, cv::Mat result, uint16_t text_color, uint16_t bg_color)
+    cv::Size FontBase::get_char_bitmap(uint16_t char_code, cv::Mat result, uint32_t text_color, uint32_t bg_color)
     {
         char_data_info_t addr = get_char_data_address(char_code);
         if(text_color != bg_color)
@@ -330,18 +487,10 @@ namespace cv
         return cv::Size(addr.width, addr.height);
     }
 
-    cv::Mat FontBase::get_char_bitmap(uint16_t char_code, uint16_t text_color, uint16_t bg_color, int type, std::vector<uint8_t>& buffer)
+    cv::Mat FontBase::get_char_bitmap(uint16_t char_code, uint32_t text_color, uint32_t bg_color, int type, std::vector<uint8_t>& buffer)
     {
         char_data_info_t addr = get_char_data_address(char_code);
-        switch (type)
-        {
-        case cv::MONO8:
-            buffer.resize(addr.height * addr.width);
-            break;
-        case cv::RGB565:
-            buffer.resize(addr.height * addr.width * 2);
-            break;
-        }
+        buffer.resize(cv::Mat(addr.height, addr.width, type, nullptr).step[0] * addr.height);
         cv::Mat result(addr.height, addr.width, type, &buffer[0]);
         if(text_color != bg_color)
         {
@@ -351,13 +500,27 @@ namespace cv
         return result;
     }
 
-    get_text_bitmap_result_t FontBase::get_text_bitmap(std::string_view text, cv::Mat result, uint16_t text_color, uint16_t bg_color, uint16_t wrap_width)
+    cv::Mat FontBase::get_char_bitmap(uint16_t char_code, uint32_t text_color, uint32_t bg_color, int type, MatAllocator* allocator)
     {
-        std::vector<char_data_info_t> addrs;
+        char_data_info_t addr = get_char_data_address(char_code);
+        cv::Mat result;
+        result.create(addr.height, addr.width, type, allocator);
+        if(!result.empty())
+        {
+            result = bg_color;
+            decode_char(addr, result, text_color);
+        }
+        return result;
+    }
+
+    get_text_bitmap_result_t FontBase::get_text_bitmap(std::string_view text, cv::Mat result, uint32_t text_color, uint32_t bg_color, uint16_t wrap_width)
+    {
+        FrameVector<char_data_info_t> addrs(FrameAllocator<char_data_info_t>{frame_arena});
         get_text_chars_info(text, addrs);
         cv::Size text_size = get_text_size(addrs, wrap_width);
         cv::Rect text_rc(0, 0, text_size.width, text_size.height);
         if(text_rc.height > result.rows) text_rc.height = result.rows;
+        if(text_rc.width > result.cols) text_rc.width = result.cols;
         if(text_color != bg_color)
         {
             result(text_rc) = bg_color;
@@ -386,26 +549,40 @@ namespace cv
         return get_text_bitmap_result_t{ text_size, decoded_chars };
     }
 
-    cv::Mat FontBase::get_text_bitmap(std::string_view text, int type, uint16_t text_color, uint16_t bg_color, std::vector<uint8_t>& buffer, uint16_t wrap_width)
+    cv::Mat FontBase::get_text_bitmap(std::string_view text, int type, uint32_t text_color, uint32_t bg_color, std::vector<uint8_t>& buffer, uint16_t wrap_width)
     {
-        std::vector<char_data_info_t> addrs;
+        FrameVector<char_data_info_t> addrs(FrameAllocator<char_data_info_t>{frame_arena});
         get_text_chars_info(text, addrs);
         cv::Size text_size = get_text_size(addrs, wrap_width);
-        switch (type)
+        buffer.resize(cv::Mat(text_size, type, nullptr).step[0] * text_size.height);
+        cv::Mat result(text_size.height, text_size.width, type, &buffer[0]);
+        result = bg_color;
+        int x = 0, y = 0;
+        for (const auto& addr : addrs)
         {
-        case cv::MONO8:
-            buffer.assign(text_size.area(), uint8_t(bg_color));
-            break;
-        case cv::RGB565:
-            buffer.resize(text_size.area() * 2);
-            std::fill_n(reinterpret_cast<uint16_t*>(&buffer[0]), text_size.area(), bg_color);
-            break;
+            if (wrap_width != 0 && x + addr.width > wrap_width)
+            {
+                y += addr.height;
+                x = 0;
+            }
+            decode_char(addr, result(cv::Rect(x, y, addr.width, addr.height)), text_color);
+            x += addr.width;
         }
-        cv::Mat result(text_size.height, text_size.width, type, &buffer[0]);
-        if(text_color != bg_color)
+        return result;
+    }
+
+    cv::Mat FontBase::get_text_bitmap(std::string_view text, int type, uint32_t text_color, uint32_t bg_color, uint16_t wrap_width, MatAllocator* allocator)
+    {
+        FrameVector<char_data_info_t> addrs(FrameAllocator<char_data_info_t>{frame_arena});
+        get_text_chars_info(text, addrs);
+        cv::Size text_size = get_text_size(addrs, wrap_width);
+        cv::Mat result;
+        result.create(text_size, type, allocator);
+        if(result.empty())
         {
-            result = bg_color;
+            return result;
         }
+        result = bg_color;
         int x = 0, y = 0;
         for (const auto& addr : addrs)
         {
@@ -422,15 +599,17 @@ namespace cv
 
     cv::Size FontBase::get_text_size(std::string_view text, uint16_t wrap_width)
     {
-        std::vector<char_data_info_t> addrs;
+        FrameVector<char_data_info_t> addrs(FrameAllocator<char_data_info_t>{frame_arena});
         get_text_chars_info(text, addrs);
         return get_text_size(addrs, wrap_width);
     }
 
-    cv::Size FontBase::get_text_size(const std::vector<char_data_info_t>& addrs, uint16_t wrap_width)
+    cv::Size FontBase::get_text_size(const FrameVector<char_data_info_t>& addrs, uint16_t wrap_width)
     {
+        // only the width of the last row and the row count are needed
         uint16_t row_height = 0;
-        std::vector<uint16_t> row_widths{ 0 };
+        uint16_t row_width = 0;
+        int row_count = 1;
         for (const auto& addr : addrs)
         {
             if (addr.width > 0)
@@ -439,69 +618,165 @@ namespace cv
                 {
                     row_height = addr.height;
                 }
-                uint16_t new_width = *row_widths.crbegin() + addr.width;
+                uint16_t new_width = row_width + addr.width;
                 if (wrap_width != 0 && wrap_width > addr.width && new_width > wrap_width)
                 {
-                    row_widths.push_back(addr.width);
+                    row_width = addr.width;
+                    row_count++;
                 }
                 else
                 {
-                    *row_widths.rbegin() += addr.width;
+                    row_width += addr.width;
                 }
             }
         }
-        if (row_widths.empty())
+        if (row_count == 1)
         {
-            return cv::Size();
-        }
-        else if (row_widths.size() == 1)
-        {
-            return cv::Size(row_widths[0], row_height);
+            return cv::Size(row_width, row_height);
         }
         else
         {
-            return cv::Size(wrap_width, int(row_height * row_widths.size()));
+            return cv::Size(wrap_width, int(row_height * row_count));
         }
     }
 
-    void FontBase::decode_char(char_data_info_t char_addr, cv::Mat result, uint16_t text_color)
+    void FontBase::decode_char(char_data_info_t char_addr, cv::Mat result, uint32_t text_color)
     {
-        std::vector<uint8_t> char_data(char_addr.length);
+        // glyphs in memory are decoded in place, only file fonts need a copy
+        const uint8_t *char_data = nullptr;
+        if(char_addr.length == 0)
+        {
+            return;
+        }
+        // Anti-aliased glyphs blend as the Blitter does: with a mask cache
+        // from cached masks on the current Blitter, otherwise while decoding
+        // by GlyphBlend; masks decoded before need no glyph data. The CPU
+        // keeps the alpha of ARGB8888 Mats, which takes the masks too.
+        const bool blended = getCpuBlitter()->supports(BLIT_BLEND, A8, result.type);
+        const bool cached = blended && glyph_mask_cache_size > 0;
+        auto masked = [&]() {
+            return result.type == ARGB8888 || &selectBlitter(BLIT_BLEND, cv::Mat(char_addr.height, char_addr.width, A8, nullptr),
+                result(cv::Rect(0, 0, char_addr.width, char_addr.height))) != getCpuBlitter();
+        };
+        if(cached && !glyph_masks.empty())
+        {
+            cv::Mat mask = get_glyph_mask(char_addr, nullptr);
+            if(!mask.empty() && masked())
+            {
+                blend_glyph(mask, result, text_color);
+                return;
+            }
+        }
         if(char_addr.cached)
         {
-            std::copy_n(&cached_char_data[char_addr.address], char_addr.length, char_data.begin());
+            char_data = &cached_char_data[char_addr.address];
         }
-        else
+        else if(font_data != nullptr)
         {
-            if(font_data != nullptr)
+            char_data = font_data + char_addr.address;
+        }
+#if defined(MBED_CONF_FILESYSTEM_PRESENT) && (MBED_CONF_FILESYSTEM_PRESENT == 1)
+        FrameVector<uint8_t> char_data_buffer(FrameAllocator<uint8_t>{frame_arena});
+        if(char_data == nullptr)
+        {
+            char_data_buffer.resize(char_addr.length);
+            font_file.seek(char_addr.address);
+            font_file.read(reinterpret_cast<char*>(&char_data_buffer[0]), char_addr.length);
+            char_data = &char_data_buffer[0];
+        }
+#endif
+        if(char_data == nullptr)
+        {
+            return;
+        }
+        if(cached && char_data[0] == 3 && masked())
+        {
+            cv::Mat mask = get_glyph_mask(char_addr, char_data);
+            if(!mask.empty())
             {
-                const uint8_t *p_char_data = font_data + char_addr.address;
-                std::copy_n(p_char_data, char_addr.length, char_data.begin());
+                blend_glyph(mask, result, text_color);
+                return;
             }
-#if defined(MBED_CONF_FILESYSTEM_PRESENT) && (MBED_CONF_FILESYSTEM_PRESENT == 1)
-            else
+        }
+        dispatch_pixel_format(result.type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            if constexpr (PF::type == RGB565 || PF::type == RGB332)
             {
-                font_file.seek(char_addr.address);
-                font_file.read(reinterpret_cast<char*>(&char_data[0]), char_addr.length);
+                if(blended)
+                {
+                    if(glyph_blend_type != PF::type || glyph_blend_color != text_color)
+                    {
+                        glyph_blend_table.resize(8 * ChannelFields<PF::type>::entries);
+                        GlyphBlendTable<PF>::build(PF::from_color(text_color), glyph_blend_table.data());
+                        glyph_blend_type = PF::type;
+                        glyph_blend_color = text_color;
+                    }
+                    decode_char_direct<PF>(char_data, char_addr.length, char_addr.width, result, PF::from_color(text_color), GlyphBlendTable<PF>(glyph_blend_table.data()));
+                    return;
+                }
             }
-#endif
+            else if constexpr (PF::type == RGB888)
+            {
+                if(blended)
+                {
+                    decode_char_direct<PF>(char_data, char_addr.length, char_addr.width, result, PF::from_color(text_color), GlyphBlend<PF>(PF::from_color(text_color)));
+                    return;
+                }
+            }
+            decode_char_direct<PF>(char_data, char_addr.length, char_addr.width, result, PF::from_color(text_color), blend_levels<PF>);
+        });
+    }
+
+    cv::Mat FontBase::get_glyph_mask(char_data_info_t char_addr, const uint8_t* char_data)
+    {
+        auto it = std::lower_bound(glyph_masks.begin(), glyph_masks.end(), char_addr.char_code,
+            [](const glyph_mask_t& mask, uint16_t char_code) { return mask.char_code < char_code; });
+        if(it != glyph_masks.end() && it->char_code == char_addr.char_code)
+        {
+            return cv::Mat(it->height, it->width, A8, &glyph_mask_data[it->offset]);
         }
-        switch (result.type)
+        const size_t size = size_t(char_addr.width) * char_addr.height;
+        if(char_data == nullptr || size == 0 || size > glyph_mask_cache_size)
         {
-        case cv::MONO8:
-            decode_char_direct<uint8_t>(char_data, char_addr.width, char_addr.height, result, uint8_t(text_color));
-            break;
-        case cv::RGB565:
-            decode_char_direct<uint16_t>(char_data, char_addr.width, char_addr.height, result, text_color);
-            break;
+            return cv::Mat();
         }
+        if(glyph_mask_data.size() + size > glyph_mask_cache_size)
+        {
+            glyph_masks.clear();
+            glyph_mask_data.clear();
+            it = glyph_masks.begin();
+        }
+        // reserved once, so masks handed out stay put until the cache is cleared
+        glyph_mask_data.reserve(glyph_mask_cache_size);
+        glyph_mask_t entry{ char_addr.char_code, char_addr.width, char_addr.height, uint32_t(glyph_mask_data.size()) };
+        glyph_masks.insert(it, entry);
+        // zeroed: transparent
+        glyph_mask_data.resize(entry.offset + size);
+        cv::Mat mask(entry.height, entry.width, A8, &glyph_mask_data[entry.offset]);
+        decode_char_direct<PixelFormat<A8>>(char_data, char_addr.length, entry.width, mask, 255, blend_levels<PixelFormat<A8>>);
+        return mask;
+    }
+
+    void FontBase::set_glyph_mask_cache_size(size_t bytes)
+    {
+        glyph_mask_cache_size = bytes;
+        glyph_masks.clear();
+        glyph_mask_data.clear();
+        glyph_mask_data.shrink_to_fit();
+    }
+
+    size_t FontBase::get_glyph_mask_cache_size() const
+    {
+        return glyph_mask_cache_size;
     }
 
     void FontBase::cache_chars(std::string_view text)
     {
         cached_chars.clear();
         cached_char_data.clear();
-        get_text_chars_info(text, cached_chars);
+        FrameVector<char_data_info_t> chars_info(FrameAllocator<char_data_info_t>{frame_arena});
+        get_text_chars_info(text, chars_info);
+        cached_chars.assign(chars_info.begin(), chars_info.end());
         std::sort(cached_chars.begin(), cached_chars.end());
         cached_chars.erase(std::unique(cached_chars.begin(), cached_chars.end()), cached_chars.end());
         size_t total_char_data_length = 0;
@@ -553,13 +828,25 @@ namespace cv
         return character;
     }
 
+    void FontBase::set_frame_arena(FrameArena* arena)
+    {
+        frame_arena = arena;
+    }
+
+    FrameArena* FontBase::get_frame_arena() const
+    {
+        return frame_arena;
+    }
+
     uint8_t FontBase::get_character_code_width(uint16_t character) const
     {
         return character < 128 ? 1: 2;
     }
 
-    void FontBase::get_text_chars_info(const std::string_view& text, std::vector<char_data_info_t>& chars_info)
+    void FontBase::get_text_chars_info(const std::string_view& text, FrameVector<char_data_info_t>& chars_info)
     {
+        // every character takes at least one byte of text
+        chars_info.reserve(chars_info.size() + text.size());
         size_t index = 0;
         while(index < text.size())
         {
@@ -95,22 +95,32 @@ namespace cv
         FontBase(const uint8_t *_font_data);
 
         // Get the bitmap of a given character and store the bitmap into the given Mat object
-        Size get_char_bitmap(uint16_t char_code, Mat result, uint16_t text_color, uint16_t bg_color);
+        Size get_char_bitmap(uint16_t char_code, Mat result, uint32_t text_color, uint32_t bg_color);
 
         // Get the bitmap of a given character
         // Actual bitmap data are stored in the given buffer
         // Size of the buffer can be adjusted automatically
-        // 'type' param can be either MONO8 or RGB565
-        Mat get_char_bitmap(uint16_t char_code, uint16_t text_color, uint16_t bg_color, int type, std::vector<uint8_t>& buffer);
+        // 'type' param can be any Mat type except L4
+        Mat get_char_bitmap(uint16_t char_code, uint32_t text_color, uint32_t bg_color, int type, std::vector<uint8_t>& buffer);
+
+        // Get the bitmap of a given character as an owning Mat
+        // The bitmap is allocated from the given allocator, or the default allocator if nullptr
+        // 'type' param can be any Mat type except L4
+        Mat get_char_bitmap(uint16_t char_code, uint32_t text_color, uint32_t bg_color, int type, MatAllocator* allocator = nullptr);
 
         // Get the bitmap of a given text string and store the bitmap into the given Mat object
-        get_text_bitmap_result_t get_text_bitmap(std::string_view text, Mat result, uint16_t text_color, uint16_t bg_color, uint16_t wrap_width = 0);
+        get_text_bitmap_result_t get_text_bitmap(std::string_view text, Mat result, uint32_t text_color, uint32_t bg_color, uint16_t wrap_width = 0);
 
         // Get the bitmap of a given text string
         // Actual bitmap data are stored in the given buffer
         // Size of the buffer can be adjusted automatically
-        // 'type' param can be either MONO8 or RGB565
-        Mat get_text_bitmap(std::string_view text, int type, uint16_t text_color, uint16_t bg_color, std::vector<uint8_t>& buffer, uint16_t wrap_width = 0);
+        // 'type' param can be any Mat type except L4
+        Mat get_text_bitmap(std::string_view text, int type, uint32_t text_color, uint32_t bg_color, std::vector<uint8_t>& buffer, uint16_t wrap_width = 0);
+
+        // Get the bitmap of a given text string as an owning Mat
+        // The bitmap is allocated from the given allocator, or the default allocator if nullptr
+        // 'type' param can be any Mat type except L4
+        Mat get_text_bitmap(std::string_view text, int type, uint32_t text_color, uint32_t bg_color, uint16_t wrap_width = 0, MatAllocator* allocator = nullptr);
 
         // Get required bitmap size of a given text string
         Size get_text_size(std::string_view text, uint16_t wrap_width = 0);
@@ -118,6 +128,24 @@ namespace cv
         // Cache commonly used character data in memory
         void cache_chars(std::string_view text);
 
+        // Scratch memory for text layout, nullptr to use the heap
+        // The arena is not reset by FontBase; reset it once per frame
+        void set_frame_arena(FrameArena* arena);
+
+        FrameArena* get_frame_arena() const;
+
+        // Anti-aliased glyphs on RGB565, RGB332 and RGB888 Mats blend with
+        // the arithmetic of the DMA2D blender: on the CPU while decoding,
+        // RGB565 and RGB332 through a table of each level and channel value
+        // built for the text color. With a cache of up to bytes they are
+        // also decoded once to A8 masks the current Blitter (see cvblit.h)
+        // blends. A full cache is cleared before the next mask is added.
+        // 0, the default, keeps no masks; a few KB hold the glyphs of a
+        // typical screen.
+        void set_glyph_mask_cache_size(size_t bytes);
+
+        size_t get_glyph_mask_cache_size() const;
+
     protected:
         // get next character from text
         virtual uint16_t get_next_character(const std::string_view& text, size_t& index) const;
@@ -128,11 +156,23 @@ namespace cv
         // get the width of character code(1 or 2 bytes)
         virtual uint8_t get_character_code_width(uint16_t character) const;
 
-        void get_text_chars_info(const std::string_view& text, std::vector<char_data_info_t>& chars_info);
+        void get_text_chars_info(const std::string_view& text, FrameVector<char_data_info_t>& chars_info);
+
+        Size get_text_size(const FrameVector<char_data_info_t>& addrs, uint16_t wrap_width = 0);
+
+        void decode_char(char_data_info_t char_addr, Mat result, uint32_t text_color);
 
-        Size get_text_size(const std::vector<char_data_info_t>& addrs, uint16_t wrap_width = 0);
+        // the cached mask of an anti-aliased glyph, decoding char_data into
+        // the cache if needed; an empty Mat if the glyph does not fit
+        Mat get_glyph_mask(char_data_info_t char_addr, const uint8_t* char_data);
 
-        void decode_char(char_data_info_t char_addr, Mat result, uint16_t text_color);
+        struct glyph_mask_t
+        {
+            uint16_t char_code;
+            uint8_t width;
+            uint8_t height;
+            uint32_t offset;
+        };
 
     protected:
         uint32_t data_address = 0;
@@ -144,6 +184,15 @@ namespace cv
         const uint8_t *font_data = nullptr;
         std::vector<char_data_info_t> cached_chars;
         std::vector<uint8_t> cached_char_data;
+        FrameArena* frame_arena = nullptr;
+        // sorted by char_code, masks packed in glyph_mask_data
+        std::vector<glyph_mask_t> glyph_masks;
+        std::vector<uint8_t> glyph_mask_data;
+        size_t glyph_mask_cache_size = 0;
+        // blended channel values of the last text color and type, see GlyphBlendTable
+        std::vector<uint16_t> glyph_blend_table;
+        int glyph_blend_type = -1;
+        uint32_t glyph_blend_color = 0;
     };
 
     // ASCII font
@@ -1,4 +1,6 @@
 #include "cvimgproc.h"
+#include "cvpixel.h"
+#include "cvrender.h"
 #include <cmath>
 
 namespace cv
@@ -124,57 +126,142 @@ namespace cv
         return p;
     }
 
-    static void CollectPolyEdges(Mat& img, const Point* v, int npts, std::vector<PolyEdge>& edges, const uint16_t color, int shift = 0);
+    // The rasterizers below are instantiated once per PixelFormat, colors are
+    // already converted to the pixel value of the format.
 
-    static void FillEdgeCollection(Mat& img, std::vector<PolyEdge>& edges, uint16_t color);
+    template<typename PF>
+    static void CollectPolyEdges(Mat& img, const Point* v, int npts, FrameVector<PolyEdge>& edges, typename PF::value_type color, int shift = 0);
 
-    static void PolyLine(Mat& img, const Point* v, int npts, bool closed, uint16_t color, int thickness, int shift = 0);
+    template<typename PF>
+    static void FillEdgeCollection(Mat& img, FrameVector<PolyEdge>& edges, typename PF::value_type color);
 
-    static void FillConvexPoly(Mat& img, const Point* v, int npts, uint16_t color, int shift = 0);
+    template<typename PF>
+    static void PolyLine(Mat& img, const Point* v, int npts, bool closed, typename PF::value_type color, int thickness, int shift = 0);
 
-    static inline void ICV_HLINE(uint8_t* ptr, int xl, int xr, uint16_t color, int pix_size)
+    template<typename PF>
+    static void FillConvexPoly(Mat& img, const Point* v, int npts, typename PF::value_type color, int shift = 0);
+
+    template<typename PF>
+    static inline void ICV_HLINE(uint8_t* ptr, int xl, int xr, typename PF::value_type color)
     {
-        uint8_t* hline_min_ptr = (uint8_t*)(ptr) + (xl)*(pix_size);
-        uint8_t* hline_end_ptr = (uint8_t*)(ptr) + (xr+1)*(pix_size);
-        uint8_t* hline_ptr = hline_min_ptr;
-        if (pix_size == 1)
-            memset(hline_min_ptr, color, hline_end_ptr-hline_min_ptr);
-        else//if (pix_size != 1)
+        PF::hline(ptr, xl, xr, color);
+    }
+
+    // first step k >= 0 of a line moving from start by dir (1 or -1) per step
+    // that lies inside [0, size), and the last one; first > last if none
+    static void clip_steps(int start, int dir, int size, int& first, int& last)
+    {
+        if(dir > 0)
         {
-            if (hline_min_ptr < hline_end_ptr)
-            {
-                memcpy(hline_ptr, &color, pix_size);
-                hline_ptr += pix_size;
-            }//end if (hline_min_ptr < hline_end_ptr)
-            size_t sizeToCopy = pix_size;
-            while(hline_ptr < hline_end_ptr)
+            first = std::max(first, -start);
+            last = std::min(last, size - 1 - start);
+        }
+        else
+        {
+            first = std::max(first, start - (size - 1));
+            last = std::min(last, start);
+        }
+    }
+
+    static int64_t floor_div(int64_t a, int64_t b)
+    {
+        int64_t q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    // narrow [first, last] to the steps k at which the fixed point coordinate
+    // start + k * step lies inside [0, size); first > last if none
+    static void clip_fixed_steps(int64_t start, int64_t step, int size, int& first, int& last)
+    {
+        const int64_t limit = (int64_t(size) << XY_SHIFT) - 1;
+        if(step == 0)
+        {
+            if(start < 0 || start > limit)
             {
-                memcpy(hline_ptr, hline_min_ptr, sizeToCopy);
-                hline_ptr += sizeToCopy;
-                sizeToCopy = std::min(2*sizeToCopy, static_cast<size_t>(hline_end_ptr-hline_ptr));
-            }//end while(hline_ptr < hline_end_ptr)
-        }//end if (pix_size != 1)
+                last = first - 1;
+            }
+            return;
+        }
+        int64_t lo, hi;
+        if(step > 0)
+        {
+            lo = -floor_div(start, step);
+            hi = floor_div(limit - start, step);
+        }
+        else
+        {
+            lo = -floor_div(limit - start, -step);
+            hi = floor_div(start, -step);
+        }
+        first = int(std::max<int64_t>(first, lo));
+        last = int(std::min<int64_t>(last, hi));
     }
 
-    static void Line(Mat& img, Point pt1, Point pt2, uint16_t _color)
+    // 8-connected Bresenham line, left to right as LineIterator draws it.
+    // Instead of clipping the end points, which moves the pixels of a cut
+    // line, the steps outside the image are skipped: the minor coordinate of
+    // step k is ceil((2k*minor - major) / (2*major)) minor steps from the
+    // start. A line thus draws the same pixels whichever part of the frame
+    // the image shows, as band and tile rendering need.
+    template<typename PF>
+    static void Line(Mat& img, Point pt1, Point pt2, typename PF::value_type color)
     {
-        constexpr int connectivity = 8;
-        LineIterator iterator(img, pt1, pt2, connectivity, true);
-        int i, count = iterator.count;
-        int pix_size = (int)img.elemSize();
-        const uint8_t* color = (const uint8_t*)&_color;
-        for( i = 0; i < count; i++, ++iterator )
+        if(pt2.x < pt1.x)
         {
-            uint8_t* ptr = *iterator;
-            if(pix_size == 1)
-                ptr[0] = color[0];
-            else
-                memcpy(*iterator, color, pix_size);
+            std::swap(pt1, pt2);
+        }
+        int dx = pt2.x - pt1.x, dy = pt2.y - pt1.y;
+        int dir_y = dy < 0 ? -1 : 1;
+        dy = std::abs(dy);
+        bool vert = dy > dx;
+        int major = vert ? dy : dx, minor = vert ? dx : dy;
+        int major_start = vert ? pt1.y : pt1.x, minor_start = vert ? pt1.x : pt1.y;
+        int major_dir = vert ? dir_y : 1, minor_dir = vert ? 1 : dir_y;
+        int major_size = vert ? img.rows : img.cols, minor_size = vert ? img.cols : img.rows;
+
+        if( (minor_dir > 0 ? minor_start + minor : minor_start) < 0 ||
+            (minor_dir > 0 ? minor_start : minor_start - minor) >= minor_size )
+        {
+            return;
+        }
+        int first = 0, last = major;
+        clip_steps(major_start, major_dir, major_size, first, last);
+        if(first > last)
+        {
+            return;
+        }
+        int64_t num = int64_t(2) * first * minor - major;
+        int m = num <= 0 ? 0 : int((num + 2 * int64_t(major) - 1) / (2 * int64_t(major)));
+        int err = int(major - 2 * int64_t(minor) - 2 * int64_t(first) * minor + 2 * int64_t(m) * major);
+        int major_pos = major_start + first * major_dir;
+        int minor_pos = minor_start + m * minor_dir;
+        uint8_t* ptr = img.ptr<uint8_t>();
+        size_t step = img.step[0];
+        for(int k = first; k <= last; k++)
+        {
+            if((unsigned)minor_pos < (unsigned)minor_size)
+            {
+                int x = vert ? minor_pos : major_pos, y = vert ? major_pos : minor_pos;
+                PF::store(ptr + y * step + x * PF::pixel_size, color);
+            }
+            else if((minor_pos < 0) == (minor_dir < 0))
+            {
+                // moving away from the image
+                break;
+            }
+            if(err < 0)
+            {
+                err += 2 * major;
+                minor_pos += minor_dir;
+            }
+            err -= 2 * minor;
+            major_pos += major_dir;
         }
     }
 
-    static void CollectPolyEdges(Mat& img, const Point* v, int count, std::vector<PolyEdge>& edges,
-                    uint16_t color, int shift)
+    template<typename PF>
+    static void CollectPolyEdges(Mat& img, const Point* v, int count, FrameVector<PolyEdge>& edges,
+                    typename PF::value_type color, int shift)
     {
         int i, delta = (1 << shift) >> 1;
         Point pt0 = v[count-1], pt1;
@@ -195,7 +282,7 @@ namespace cv
             t0.y = pt0.y; t1.y = pt1.y;
             t0.x = (pt0.x + (XY_ONE >> 1)) >> XY_SHIFT;
             t1.x = (pt1.x + (XY_ONE >> 1)) >> XY_SHIFT;
-            Line( img, t0, t1, color);
+            Line<PF>( img, t0, t1, color);
 
             if( pt0.y == pt1.y )
                 continue;
@@ -228,7 +315,8 @@ namespace cv
 
     /**************** helper macros and functions for sequence/contour processing ***********/
 
-    static void FillEdgeCollection(Mat& img, std::vector<PolyEdge>& edges, uint16_t color)
+    template<typename PF>
+    static void FillEdgeCollection(Mat& img, FrameVector<PolyEdge>& edges, typename PF::value_type color)
     {
         PolyEdge tmp;
         int i, y, total = (int)edges.size();
@@ -236,7 +324,6 @@ namespace cv
         PolyEdge* e;
         int y_max = INT_MIN, y_min = INT_MAX;
         int x_max = INT_MAX, x_min = INT_MIN;
-        int pix_size = (int)img.elemSize();
 
         if( total < 2 )
             return;
@@ -330,7 +417,7 @@ namespace cv
                                 x1 = 0;
                             if( x2 >= size.width )
                                 x2 = size.width - 1;
-                            ICV_HLINE( timg, x1, x2, color, pix_size );
+                            ICV_HLINE<PF>( timg, x1, x2, color );
                         }
                     }
                     keep_prelast->x += keep_prelast->dx;
@@ -523,7 +610,8 @@ namespace cv
         }
     }
 
-    static void Line2(Mat& img, Point pt1, Point pt2, uint16_t color)
+    template<typename PF>
+    static void Line2(Mat& img, Point pt1, Point pt2, typename PF::value_type color)
     {
         int64_t dx, dy;
         int ecount;
@@ -531,13 +619,14 @@ namespace cv
         int64_t i, j;
         int x, y;
         int x_step, y_step;
-        int pix_size = (int)img.elemSize();
-        uint8_t *ptr = img.ptr<uint8_t>(), *tptr;
+        uint8_t *ptr = img.ptr<uint8_t>();
         size_t step = img.step[0];
         Size size = img.size();
 
-        Size sizeScaled(size.width << XY_SHIFT, size.height << XY_SHIFT);
-        if( !clipLine( sizeScaled, pt1, pt2 ))
+        // the end points are not clipped, steps outside the image are skipped
+        // below, so the pixels do not depend on the part of the frame shown
+        if( std::max(pt1.x, pt2.x) >> XY_SHIFT < -1 || std::min(pt1.x, pt2.x) >> XY_SHIFT > size.width ||
+            std::max(pt1.y, pt2.y) >> XY_SHIFT < -1 || std::min(pt1.y, pt2.y) >> XY_SHIFT > size.height )
             return;
 
         dx = pt2.x - pt1.x;
@@ -580,103 +669,63 @@ namespace cv
         pt1.x += (XY_ONE >> 1);
         pt1.y += (XY_ONE >> 1);
 
-        if( pix_size == 1 )
-        {
-            #define  ICV_PUT_POINT(_x,_y) \
-            x = (_x); y = (_y);           \
-            if( 0 <= x && x < size.width && \
-                0 <= y && y < size.height ) \
-            {                           \
-                tptr = ptr + y*step + x;\
-                tptr[0] = (uint8_t)color;    \
-            }
+        #define  ICV_PUT_POINT(_x,_y) \
+        x = (_x); y = (_y);           \
+        if( 0 <= x && x < size.width && \
+            0 <= y && y < size.height ) \
+        {                           \
+            PF::store(ptr + y*step + x*PF::pixel_size, color); \
+        }
 
-            ICV_PUT_POINT((int)((pt2.x + (XY_ONE >> 1)) >> XY_SHIFT),
-                        (int)((pt2.y + (XY_ONE >> 1)) >> XY_SHIFT));
+        ICV_PUT_POINT((int)((pt2.x + (XY_ONE >> 1)) >> XY_SHIFT),
+                    (int)((pt2.y + (XY_ONE >> 1)) >> XY_SHIFT));
 
-            if( ax > ay )
+        if( ax > ay )
+        {
+            int x0 = pt1.x >> XY_SHIFT;
+            int first = 0, last = ecount;
+            clip_steps(x0, 1, size.width, first, last);
+            clip_fixed_steps(pt1.y, y_step, size.height, first, last);
+            int64_t fy = pt1.y + int64_t(first) * y_step;
+
+            // both coordinates inside the image from first to last
+            for( int k = first; k <= last; k++ )
             {
-                pt1.x >>= XY_SHIFT;
-
-                while( ecount >= 0 )
-                {
-                    ICV_PUT_POINT((int)(pt1.x), (int)(pt1.y >> XY_SHIFT));
-                    pt1.x++;
-                    pt1.y += y_step;
-                    ecount--;
-                }
+                PF::store(ptr + (int)(fy >> XY_SHIFT)*step + (x0 + k)*PF::pixel_size, color);
+                fy += y_step;
             }
-            else
-            {
-                pt1.y >>= XY_SHIFT;
-
-                while( ecount >= 0 )
-                {
-                    ICV_PUT_POINT((int)(pt1.x >> XY_SHIFT), (int)(pt1.y));
-                    pt1.x += x_step;
-                    pt1.y++;
-                    ecount--;
-                }
-            }
-
-            #undef ICV_PUT_POINT
         }
         else
         {
-            #define  ICV_PUT_POINT(_x,_y)   \
-            x = (_x); y = (_y);             \
-            if( 0 <= x && x < size.width && \
-                0 <= y && y < size.height ) \
-            {                               \
-                tptr = ptr + y*step + x*pix_size;\
-                for( j = 0; j < pix_size; j++ ) \
-                    tptr[j] = ((uint8_t*)&color)[j]; \
-            }
+            int y0 = pt1.y >> XY_SHIFT;
+            int first = 0, last = ecount;
+            clip_steps(y0, 1, size.height, first, last);
+            clip_fixed_steps(pt1.x, x_step, size.width, first, last);
+            int64_t fx = pt1.x + int64_t(first) * x_step;
 
-           ICV_PUT_POINT((int)((pt2.x + (XY_ONE >> 1)) >> XY_SHIFT), (int)((pt2.y + (XY_ONE >> 1)) >> XY_SHIFT));
-
-            if( ax > ay )
-            {
-                pt1.x >>= XY_SHIFT;
-
-                while( ecount >= 0 )
-                {
-                    ICV_PUT_POINT((int)(pt1.x), (int)(pt1.y >> XY_SHIFT));
-                    pt1.x++;
-                    pt1.y += y_step;
-                    ecount--;
-                }
-            }
-            else
+            for( int k = first; k <= last; k++ )
             {
-                pt1.y >>= XY_SHIFT;
-
-                while( ecount >= 0 )
-                {
-                    ICV_PUT_POINT((int)(pt1.x >> XY_SHIFT), (int)(pt1.y));
-                    pt1.x += x_step;
-                    pt1.y++;
-                    ecount--;
-                }
+                PF::store(ptr + (y0 + k)*step + (int)(fx >> XY_SHIFT)*PF::pixel_size, color);
+                fx += x_step;
             }
-
-            #undef ICV_PUT_POINT
         }
+
+        #undef ICV_PUT_POINT
     }
 
     /* draws simple or filled circle */
-    static void Circle( Mat& img, Point center, int radius, uint16_t color, int fill )
+    template<typename PF>
+    static void Circle( Mat& img, Point center, int radius, typename PF::value_type color, int fill )
     {
         Size size = img.size();
         size_t step = img.step[0];
-        int pix_size = (int)img.elemSize();
         uint8_t* ptr = img.ptr<uint8_t>();
         int err = 0, dx = radius, dy = 0, plus = 1, minus = (radius << 1) - 1;
         int inside = center.x >= radius && center.x < size.width - radius &&
             center.y >= radius && center.y < size.height - radius;
 
         #define ICV_PUT_POINT( ptr, x )     \
-            memcpy( ptr + (x)*pix_size, &color, pix_size );
+            PF::store( ptr + (x)*PF::pixel_size, color );
 
         while( dx >= dy )
         {
@@ -698,8 +747,8 @@ namespace cv
                 }
                 else
                 {
-                    ICV_HLINE( tptr0, x11, x12, color, pix_size );
-                    ICV_HLINE( tptr1, x11, x12, color, pix_size );
+                    ICV_HLINE<PF>( tptr0, x11, x12, color );
+                    ICV_HLINE<PF>( tptr1, x11, x12, color );
                 }
 
                 tptr0 = ptr + y21 * step;
@@ -714,8 +763,8 @@ namespace cv
                 }
                 else
                 {
-                    ICV_HLINE( tptr0, x21, x22, color, pix_size );
-                    ICV_HLINE( tptr1, x21, x22, color, pix_size );
+                    ICV_HLINE<PF>( tptr0, x21, x22, color );
+                    ICV_HLINE<PF>( tptr1, x21, x22, color );
                 }
             }
             else if( x11 < size.width && x12 >= 0 && y21 < size.height && y22 >= 0 )
@@ -738,7 +787,7 @@ namespace cv
                             ICV_PUT_POINT( tptr, x12 );
                     }
                     else
-                        ICV_HLINE( tptr, x11, x12, color, pix_size );
+                        ICV_HLINE<PF>( tptr, x11, x12, color );
                 }
 
                 if( (unsigned)y12 < (unsigned)size.height )
@@ -753,7 +802,7 @@ namespace cv
                             ICV_PUT_POINT( tptr, x12 );
                     }
                     else
-                        ICV_HLINE( tptr, x11, x12, color, pix_size );
+                        ICV_HLINE<PF>( tptr, x11, x12, color );
                 }
 
                 if( x21 < size.width && x22 >= 0 )
@@ -776,7 +825,7 @@ namespace cv
                                 ICV_PUT_POINT( tptr, x22 );
                         }
                         else
-                            ICV_HLINE( tptr, x21, x22, color, pix_size );
+                            ICV_HLINE<PF>( tptr, x21, x22, color );
                     }
 
                     if( (unsigned)y22 < (unsigned)size.height )
@@ -791,7 +840,7 @@ namespace cv
                                 ICV_PUT_POINT( tptr, x22 );
                         }
                         else
-                            ICV_HLINE( tptr, x21, x22, color, pix_size );
+                            ICV_HLINE<PF>( tptr, x21, x22, color );
                     }
                 }
             }
@@ -809,7 +858,8 @@ namespace cv
         #undef  ICV_PUT_POINT
     }
 
-    static void ThickLine(Mat& img, Point p0, Point p1, uint16_t color,
+    template<typename PF>
+    static void ThickLine(Mat& img, Point p0, Point p1, typename PF::value_type color,
             int thickness, int flags, int shift = 0)
     {
         static const float INV_XY_ONE = 1.f/XY_ONE;
@@ -819,6 +869,13 @@ namespace cv
         p1.x <<= XY_SHIFT - shift;
         p1.y <<= XY_SHIFT - shift;
 
+        // skip segments wholly outside, as the pieces of an outline are when
+        // a frame is drawn in bands
+        int margin = thickness + 2;
+        if( std::max(p0.x, p1.x) >> XY_SHIFT < -margin || std::min(p0.x, p1.x) >> XY_SHIFT >= img.cols + margin ||
+            std::max(p0.y, p1.y) >> XY_SHIFT < -margin || std::min(p0.y, p1.y) >> XY_SHIFT >= img.rows + margin )
+            return;
+
         if( thickness <= 1 )
         {
             if(shift == 0 )
@@ -827,10 +884,10 @@ namespace cv
                 p0.y = (p0.y + (XY_ONE>>1)) >> XY_SHIFT;
                 p1.x = (p1.x + (XY_ONE>>1)) >> XY_SHIFT;
                 p1.y = (p1.y + (XY_ONE>>1)) >> XY_SHIFT;
-                Line(img, p0, p1, color);
+                Line<PF>(img, p0, p1, color);
             }
             else
-                Line2(img, p0, p1, color);
+                Line2<PF>(img, p0, p1, color);
         }
         else
         {
@@ -855,7 +912,7 @@ namespace cv
                 pt[3].x = p1.x + dp.x;
                 pt[3].y = p1.y + dp.y;
 
-                FillConvexPoly( img, pt, 4, color, XY_SHIFT );
+                FillConvexPoly<PF>( img, pt, 4, color, XY_SHIFT );
             }
 
             for( i = 0; i < 2; i++ )
@@ -865,14 +922,15 @@ namespace cv
                     Point center;
                     center.x = (int)((p0.x + (XY_ONE>>1)) >> XY_SHIFT);
                     center.y = (int)((p0.y + (XY_ONE>>1)) >> XY_SHIFT);
-                    Circle( img, center, (thickness + (XY_ONE>>1)) >> XY_SHIFT, color, 1 );
+                    Circle<PF>( img, center, (thickness + (XY_ONE>>1)) >> XY_SHIFT, color, 1 );
                 }
                 p0 = p1;
             }
         }
     }
 
-    static void FillConvexPoly(Mat& img, const Point* v, int npts, uint16_t color, int shift)
+    template<typename PF>
+    static void FillConvexPoly(Mat& img, const Point* v, int npts, typename PF::value_type color, int shift)
     {
         struct
         {
@@ -888,7 +946,6 @@ namespace cv
         int xmin, xmax, ymin, ymax;
         uint8_t* ptr = img.ptr<uint8_t>();
         Size size = img.size();
-        int pix_size = (int)img.elemSize();
         Point p0;
         int delta1, delta2;
         delta1 = delta2 = XY_ONE >> 1;
@@ -923,10 +980,10 @@ namespace cv
                 pt0.y = (int)(p0.y >> XY_SHIFT);
                 pt1.x = (int)(p.x >> XY_SHIFT);
                 pt1.y = (int)(p.y >> XY_SHIFT);
-                Line( img, pt0, pt1, color);
+                Line<PF>( img, pt0, pt1, color);
             }
             else
-                Line2(img, p0, p, color);
+                Line2<PF>(img, p0, p, color);
 
             p0 = p;
         }
@@ -1008,7 +1065,7 @@ namespace cv
                         xx1 = 0;
                     if( xx2 >= size.width )
                         xx2 = size.width - 1;
-                    ICV_HLINE(ptr, xx1, xx2, color, pix_size);
+                    ICV_HLINE<PF>(ptr, xx1, xx2, color);
                 }
             }
             else
@@ -1111,7 +1168,7 @@ namespace cv
 
     void ellipse2Poly( Point2f center, Size2f axes, int angle,
                    int arc_start, int arc_end,
-                   int delta, std::vector<Point2f>& pts )
+                   int delta, FrameVector<Point2f>& pts )
     {
         float alpha, beta;
         int i;
@@ -1168,19 +1225,25 @@ namespace cv
         }
     }
 
+    template<typename PF>
     static void EllipseEx(Mat& img, Point center, Size axes,
-            int angle, int arc_start, int arc_end, uint16_t color, int thickness)
+            int angle, int arc_start, int arc_end, typename PF::value_type color, int thickness, FrameArena* arena)
     {
         axes.width = std::abs(axes.width), axes.height = std::abs(axes.height);
         int delta = (int)((std::max(axes.width,axes.height)+(XY_ONE>>1))>>XY_SHIFT);
         delta = delta < 3 ? 90 : delta < 10 ? 30 : delta < 15 ? 18 : 5;
 
-        std::vector<Point2f> _v;
-        ellipse2Poly(Point2f((float)center.x, (float)center.y), Size2f((float)axes.width, (float)axes.height), angle, arc_start, arc_end, delta, _v );
+        // ellipse2Poly emits at most 360/delta + 2 points, plus the center for filled arcs
+        const size_t max_points = 360 / delta + 3;
+        FrameVector<Point2f> _v(FrameAllocator<Point2f>{arena});
+        _v.reserve(max_points);
+        // the points are computed around the origin and moved in integers, so
+        // the outline does not depend on float precision at the position
+        ellipse2Poly(Point2f(0, 0), Size2f((float)axes.width, (float)axes.height), angle, arc_start, arc_end, delta, _v );
 
-        std::vector<Point> v;
+        FrameVector<Point> v(FrameAllocator<Point>{arena});
+        v.reserve(max_points);
         Point prevPt(INT_MAX, INT_MAX);
-        v.resize(0);
         for (unsigned int i = 0; i < _v.size(); ++i)
         {
             Point pt;
@@ -1188,6 +1251,7 @@ namespace cv
             pt.y = cvRound(_v[i].y / XY_ONE) << XY_SHIFT;
             pt.x += cvRound(_v[i].x - pt.x);
             pt.y += cvRound(_v[i].y - pt.y);
+            pt += center;
             if (pt != prevPt) {
                 v.push_back(pt);
                 prevPt = pt;
@@ -1200,19 +1264,22 @@ namespace cv
         }
 
         if( thickness >= 0 )
-            PolyLine( img, &v[0], (int)v.size(), false, color, thickness, XY_SHIFT);
+            PolyLine<PF>( img, &v[0], (int)v.size(), false, color, thickness, XY_SHIFT);
         else if( arc_end - arc_start >= 360 )
-            FillConvexPoly( img, &v[0], (int)v.size(), color, XY_SHIFT);
+            FillConvexPoly<PF>( img, &v[0], (int)v.size(), color, XY_SHIFT);
         else
         {
             v.push_back(center);
-            std::vector<PolyEdge> edges;
-            CollectPolyEdges(img,  &v[0], (int)v.size(), edges, color, XY_SHIFT);
-            FillEdgeCollection(img, edges, color);
+            // one edge per vertex plus the sentinel added by FillEdgeCollection
+            FrameVector<PolyEdge> edges(FrameAllocator<PolyEdge>{arena});
+            edges.reserve(v.size() + 1);
+            CollectPolyEdges<PF>(img,  &v[0], (int)v.size(), edges, color, XY_SHIFT);
+            FillEdgeCollection<PF>(img, edges, color);
         }
     }
 
-    static void ellipse(Mat& img, Point center, Size axes, float angle, float startAngle, float endAngle, uint16_t color, int thickness)
+    template<typename PF>
+    static void ellipse(Mat& img, Point center, Size axes, float angle, float startAngle, float endAngle, typename PF::value_type color, int thickness, FrameArena* arena)
     {
         int _angle = cvRound(angle);
         int _start_angle = cvRound(startAngle);
@@ -1221,10 +1288,11 @@ namespace cv
         center.y <<= XY_SHIFT;
         axes.width <<= XY_SHIFT;
         axes.height <<= XY_SHIFT;
-        EllipseEx(img, center, axes, _angle, _start_angle, _end_angle, color, thickness);
+        EllipseEx<PF>(img, center, axes, _angle, _start_angle, _end_angle, color, thickness, arena);
     }
 
-    static void ellipse(Mat& img, const RotatedRect& box, uint16_t color, int thickness)
+    template<typename PF>
+    static void ellipse(Mat& img, const RotatedRect& box, typename PF::value_type color, int thickness, FrameArena* arena)
     {
         int _angle = cvRound(box.angle);
         Point center(cvRound(box.center.x), cvRound(box.center.y));
@@ -1233,11 +1301,12 @@ namespace cv
         Size axes(cvRound(box.size.width), cvRound(box.size.height));
         axes.width  = (axes.width  << (XY_SHIFT - 1)) + cvRound((box.size.width - axes.width)*(XY_ONE>>1));
         axes.height = (axes.height << (XY_SHIFT - 1)) + cvRound((box.size.height - axes.height)*(XY_ONE>>1));
-        EllipseEx(img, center, axes, _angle, 0, 360, color, thickness);
+        EllipseEx<PF>(img, center, axes, _angle, 0, 360, color, thickness, arena);
     }
 
+    template<typename PF>
     static void PolyLine(Mat& img, const Point* v, int count, bool is_closed,
-          uint16_t color, int thickness, int shift)
+          typename PF::value_type color, int thickness, int shift)
     {
         if( !v || count <= 0 )
             return;
@@ -1249,34 +1318,223 @@ namespace cv
         for( i = !is_closed; i < count; i++ )
         {
             Point p = v[i];
-            ThickLine( img, p0, p, color, thickness, flags, shift);
+            ThickLine<PF>( img, p0, p, color, thickness, flags, shift);
             p0 = p;
             flags = 2;
         }
     }
 
-    static void polyline(Mat& img, const std::vector<Point>& contour, uint16_t color, int thickness)
+    // open polyline through the points of contour, moved by -offset
+    template<typename PF>
+    static void polyline(Mat& img, const std::vector<Point>& contour, Point offset, typename PF::value_type color, int thickness)
     {
-        PolyLine(img, &contour[0], int(contour.size()), false, color, thickness, 0);
+        if(contour.empty())
+            return;
+
+        int flags = 3;
+        Point p0 = contour[0] - offset;
+        for(size_t i = 1; i < contour.size(); i++)
+        {
+            Point p = contour[i] - offset;
+            ThickLine<PF>(img, p0, p, color, thickness, flags, 0);
+            p0 = p;
+            flags = 2;
+        }
+    }
+
+    DirtyRegion::DirtyRegion(int _merge_percent)
+        : merge_percent(_merge_percent)
+    {
+    }
+
+    int DirtyRegion::merge_cost(const Rect& a, const Rect& b)
+    {
+        return (a | b).area() - a.area() - b.area() + (a & b).area();
+    }
+
+    void DirtyRegion::remove(int i)
+    {
+        rects[i] = rects[--count];
+    }
+
+    void DirtyRegion::add(const Rect& rc)
+    {
+        if(rc.empty())
+        {
+            return;
+        }
+        Rect current = rc;
+        // merge as long as a cheap partner exists, a merged rect may have
+        // new ones
+        bool merged = true;
+        while(merged)
+        {
+            merged = false;
+            int best = -1, best_cost = 0;
+            for(int i = 0; i < count; i++)
+            {
+                if((rects[i] & current) == current)
+                {
+                    // already covered, as are the rects merged into current
+                    return;
+                }
+                int cost = merge_cost(rects[i], current);
+                int covered = rects[i].area() + current.area() - (rects[i] & current).area();
+                if(cost * 100 <= covered * merge_percent && (best < 0 || cost < best_cost))
+                {
+                    best = i;
+                    best_cost = cost;
+                }
+            }
+            if(!merged && best >= 0)
+            {
+                current |= rects[best];
+                remove(best);
+                merged = true;
+            }
+        }
+        if(count == MAX_RECTS)
+        {
+            // full: merge the pair that wastes the least, which may include the new rect
+            int best_i = 0, best_j = -1, best_cost = merge_cost(rects[0], current);
+            for(int i = 0; i < count; i++)
+            {
+                for(int j = i + 1; j < count; j++)
+                {
+                    int cost = merge_cost(rects[i], rects[j]);
+                    if(cost < best_cost)
+                    {
+                        best_i = i;
+                        best_j = j;
+                        best_cost = cost;
+                    }
+                }
+                int cost = merge_cost(rects[i], current);
+                if(cost < best_cost)
+                {
+                    best_i = i;
+                    best_j = -1;
+                    best_cost = cost;
+                }
+            }
+            if(best_j < 0)
+            {
+                current |= rects[best_i];
+                remove(best_i);
+            }
+            else
+            {
+                Rect pair = rects[best_i] | rects[best_j];
+                remove(best_j);
+                remove(best_i);
+                add(pair);
+            }
+            add(current);
+            return;
+        }
+        rects[count++] = current;
+    }
+
+    void DirtyRegion::clear()
+    {
+        count = 0;
+    }
+
+    Rect DirtyRegion::bounds() const
+    {
+        Rect result;
+        for(int i = 0; i < count; i++)
+        {
+            result |= rects[i];
+        }
+        return result;
+    }
+
+    int DirtyRegion::area() const
+    {
+        int result = 0;
+        for(int i = 0; i < count; i++)
+        {
+            result += rects[i].area();
+        }
+        return result;
+    }
+
+    void DirtyRegion::set_merge_percent(int percent)
+    {
+        merge_percent = percent;
+    }
+
+    int DirtyRegion::get_merge_percent() const
+    {
+        return merge_percent;
+    }
+
+    // pixels from pt1 to pt2, both included
+    static Rect points_rect(Point pt1, Point pt2)
+    {
+        Rect rc(pt1, pt2);
+        rc.width++;
+        rc.height++;
+        return rc;
+    }
+
+    // grow the bounds of a shape's centerline by half its stroke width
+    static Rect stroke_rect(Rect rc, int thickness)
+    {
+        if(thickness > 1)
+        {
+            int margin = (thickness + 1) / 2;
+            rc.x -= margin;
+            rc.y -= margin;
+            rc.width += margin * 2;
+            rc.height += margin * 2;
+        }
+        return rc;
     }
 
      Painter::Painter(const Mat& _mat)
-        : mat(_mat)
+        : mat(_mat), clip(0, 0, _mat.cols, _mat.rows), clip_mat(_mat)
     {
     }
 
-    void Painter::fill(uint16_t color)
+    Painter::Painter(DisplayList& list)
+        : display_list(&list), clip(Point(), list.get_frame_size())
     {
-#if HAS_DMA2D
-        dma2d_fill(mat, color);
-#else
-        mat = color;
-#endif
-        update_dirty_rect(Rect(0, 0, mat.cols, mat.rows));
     }
 
-    void Painter::rectangle(Point pt1, Point pt2, uint16_t color, int thickness)
+    void Painter::fill(uint32_t color)
     {
+        Rect bounds = clip;
+        if(bounds.empty())
+        {
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_fill(clip, color);
+            update_dirty_rect(bounds);
+            return;
+        }
+        selectBlitter(BLIT_FILL, clip_mat, clip_mat).fill(clip_mat, color);
+        update_dirty_rect(bounds);
+    }
+
+    void Painter::rectangle(Point pt1, Point pt2, uint32_t color, int thickness)
+    {
+        Rect bounds = stroke_rect(points_rect(pt1, pt2), thickness);
+        if((bounds & clip).empty())
+        {
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_shape(DisplayList::RECTANGLE, bounds, clip, color, thickness, pt1, pt2);
+            update_dirty_rect(bounds);
+            return;
+        }
+        pt1 -= clip.tl();
+        pt2 -= clip.tl();
         if(thickness >= 0)
         {
             Point pt[4];
@@ -1286,174 +1544,330 @@ namespace cv
             pt[2] = pt2;
             pt[3].x = pt1.x;
             pt[3].y = pt2.y;
-            PolyLine(mat, pt, 4, true, color, thickness);
+            dispatch_pixel_format(mat.type, [&](auto pf) {
+                typedef decltype(pf) PF;
+                PolyLine<PF>(clip_mat, pt, 4, true, PF::from_color(color), thickness);
+            });
         }
         else
         {
-#if HAS_DMA2D
-        dma2d_fill(mat(Rect(pt1, pt2)), color);
-#else
-        Point pt[4];
-        pt[0] = pt1;
-        pt[1].x = pt2.x;
-        pt[1].y = pt1.y;
-        pt[2] = pt2;
-        pt[3].x = pt1.x;
-        pt[3].y = pt2.y;
-        FillConvexPoly(mat, pt, 4, color);
-#endif
-        }
-        Rect current_dirty_rect(pt1, pt2);
-        if(thickness > 0)
-        {
-            current_dirty_rect.x -= thickness / 2;
-            current_dirty_rect.y -= thickness / 2;
-            current_dirty_rect.width += thickness;
-            current_dirty_rect.height += thickness;
+            // pt2 is inside the rectangle
+            Rect fill_rect = Rect(Point(std::min(pt1.x, pt2.x), std::min(pt1.y, pt2.y)), Point(std::max(pt1.x, pt2.x) + 1, std::max(pt1.y, pt2.y) + 1)) &
+                Rect(0, 0, clip_mat.cols, clip_mat.rows);
+            if(mat.type != L4 && !fill_rect.empty())
+            {
+                Mat target = clip_mat(fill_rect);
+                selectBlitter(BLIT_FILL, target, target).fill(target, color);
+            }
         }
-        update_dirty_rect(current_dirty_rect);
+        update_dirty_rect(bounds);
     }
 
-    void Painter::line(Point pt1, Point pt2, uint16_t color, int thickness)
+    void Painter::line(Point pt1, Point pt2, uint32_t color, int thickness)
     {
-        ThickLine(mat, pt1, pt2, color, thickness, 3);
-        Rect current_dirty_rect(pt1, pt2);
-        if(thickness > 0)
+        Rect bounds = stroke_rect(points_rect(pt1, pt2), thickness);
+        if((bounds & clip).empty())
         {
-            current_dirty_rect.x -= thickness / 2;
-            current_dirty_rect.y -= thickness / 2;
-            current_dirty_rect.width += thickness;
-            current_dirty_rect.height += thickness;
+            return;
         }
-        update_dirty_rect(current_dirty_rect);
+        if(display_list != nullptr)
+        {
+            display_list->record_shape(DisplayList::LINE, bounds, clip, color, thickness, pt1, pt2);
+            update_dirty_rect(bounds);
+            return;
+        }
+        dispatch_pixel_format(mat.type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            ThickLine<PF>(clip_mat, pt1 - clip.tl(), pt2 - clip.tl(), PF::from_color(color), thickness, 3);
+        });
+        update_dirty_rect(bounds);
     }
 
-    void Painter::circle(Point center, int radius, uint16_t color, int thickness)
+    void Painter::circle(Point center, int radius, uint32_t color, int thickness)
     {
-        if(thickness > 1)
+        Rect bounds = stroke_rect(Rect(center.x - radius, center.y - radius, radius * 2 + 1, radius * 2 + 1), thickness);
+        if((bounds & clip).empty())
         {
-            Point _center(center);
-            int _radius(radius);
-            _center.x <<= XY_SHIFT;
-            _center.y <<= XY_SHIFT;
-            _radius <<= XY_SHIFT;
-            EllipseEx(mat, _center, Size(_radius, _radius), 0, 0, 360, color, thickness);
+            return;
         }
-        else
-            Circle(mat, center, radius, color, thickness < 0);
-        Rect current_dirty_rect(center.x - radius, center.y - radius, radius * 2, radius * 2);
-        if(thickness > 0)
+        if(display_list != nullptr)
         {
-            current_dirty_rect.x -= thickness / 2;
-            current_dirty_rect.y -= thickness / 2;
-            current_dirty_rect.width += thickness;
-            current_dirty_rect.height += thickness;
+            display_list->record_shape(DisplayList::CIRCLE, bounds, clip, color, thickness, center, Point(radius, 0));
+            update_dirty_rect(bounds);
+            return;
         }
-        update_dirty_rect(current_dirty_rect);
+        center -= clip.tl();
+        dispatch_pixel_format(mat.type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            if(thickness > 1)
+            {
+                Point _center(center);
+                int _radius(radius);
+                _center.x <<= XY_SHIFT;
+                _center.y <<= XY_SHIFT;
+                _radius <<= XY_SHIFT;
+                EllipseEx<PF>(clip_mat, _center, Size(_radius, _radius), 0, 0, 360, PF::from_color(color), thickness, frame_arena);
+            }
+            else
+                Circle<PF>(clip_mat, center, radius, PF::from_color(color), thickness < 0);
+        });
+        update_dirty_rect(bounds);
     }
 
-    void Painter::polyline(const std::vector<Point>& contour, uint16_t color, int thickness)
+    void Painter::polyline(const std::vector<Point>& contour, uint32_t color, int thickness)
     {
-        ::cv::polyline(mat, contour, color, thickness);
-        Rect current_dirty_rect = boundingRect(contour);
-        if(thickness > 0)
+        Rect bounds = stroke_rect(boundingRect(contour), thickness);
+        if((bounds & clip).empty())
         {
-            current_dirty_rect.x -= thickness / 2;
-            current_dirty_rect.y -= thickness / 2;
-            current_dirty_rect.width += thickness;
-            current_dirty_rect.height += thickness;
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_polyline(bounds, clip, color, thickness, contour);
+            update_dirty_rect(bounds);
+            return;
         }
-        update_dirty_rect(current_dirty_rect);
+        dispatch_pixel_format(mat.type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            ::cv::polyline<PF>(clip_mat, contour, clip.tl(), PF::from_color(color), thickness);
+        });
+        update_dirty_rect(bounds);
     }
 
-    void Painter::ellipse(Point center, Size axes, float angle, float startAngle, float endAngle, uint16_t color, int thickness)
+    void Painter::ellipse(Point center, Size axes, float angle, float startAngle, float endAngle, uint32_t color, int thickness)
     {
-        ::cv::ellipse(mat, center, axes, angle, startAngle, endAngle, color, thickness);
-        Rect current_dirty_rect(center.x - axes.width, center.y - axes.height, axes.width * 2 + 1, axes.height * 2 + 1);
-        if(thickness > 0)
+        // half extents of the rotated ellipse, plus a pixel for rounding
+        double alpha = angle * CV_PI / 180;
+        double ca = std::cos(alpha), sa = std::sin(alpha);
+        int half_width = cvCeil(std::sqrt(axes.width * ca * axes.width * ca + axes.height * sa * axes.height * sa)) + 1;
+        int half_height = cvCeil(std::sqrt(axes.width * sa * axes.width * sa + axes.height * ca * axes.height * ca)) + 1;
+        Rect bounds = stroke_rect(Rect(center.x - half_width, center.y - half_height, half_width * 2 + 1, half_height * 2 + 1), thickness);
+        if((bounds & clip).empty())
         {
-            current_dirty_rect.x -= thickness / 2;
-            current_dirty_rect.y -= thickness / 2;
-            current_dirty_rect.width += thickness;
-            current_dirty_rect.height += thickness;
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_ellipse(bounds, clip, color, thickness, center, axes, angle, startAngle, endAngle);
+            update_dirty_rect(bounds);
+            return;
         }
-        update_dirty_rect(current_dirty_rect);
+        dispatch_pixel_format(mat.type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            ::cv::ellipse<PF>(clip_mat, center - clip.tl(), axes, angle, startAngle, endAngle, PF::from_color(color), thickness, frame_arena);
+        });
+        update_dirty_rect(bounds);
     }
 
-    void Painter::ellipse(const RotatedRect& box, uint16_t color, int thickness)
+    void Painter::ellipse(const RotatedRect& box, uint32_t color, int thickness)
     {
-        ::cv::ellipse(mat, box, color, thickness);
-        Rect current_dirty_rect = box.boundingRect();
-        if(thickness > 0)
+        Rect bounds = stroke_rect(box.boundingRect(), thickness);
+        if((bounds & clip).empty())
         {
-            current_dirty_rect.x -= thickness / 2;
-            current_dirty_rect.y -= thickness / 2;
-            current_dirty_rect.width += thickness;
-            current_dirty_rect.height += thickness;
+            return;
         }
-        update_dirty_rect(current_dirty_rect);
+        if(display_list != nullptr)
+        {
+            display_list->record_ellipse(bounds, clip, color, thickness, box);
+            update_dirty_rect(bounds);
+            return;
+        }
+        RotatedRect clip_box(Point2f(box.center.x - clip.x, box.center.y - clip.y), box.size, box.angle);
+        dispatch_pixel_format(mat.type, [&](auto pf) {
+            typedef decltype(pf) PF;
+            ::cv::ellipse<PF>(clip_mat, clip_box, PF::from_color(color), thickness, frame_arena);
+        });
+        update_dirty_rect(bounds);
     }
 
-    void Painter::putText(std::string_view text, Point org, FontBase& font, uint16_t text_color, uint16_t bg_color, bool word_wrap, int *consumed_chars)
+    void Painter::putText(std::string_view text, Point org, FontBase& font, uint32_t text_color, uint32_t bg_color, bool word_wrap, int *consumed_chars)
     {
-        Rect text_rect(org.x, org.y, mat.cols - org.x, mat.rows - org.y);
-        Mat subMat(mat, text_rect);
-        get_text_bitmap_result_t rc = font.get_text_bitmap(text, subMat, text_color, bg_color, word_wrap ? text_rect.width: 0);
-        text_rect.width = rc.text_size.width;
-        text_rect.height = rc.text_size.height;
+        if(consumed_chars != nullptr)
+        {
+            *consumed_chars = 0;
+        }
+        // text extends right and down from org
+        if(org.x >= clip.x + clip.width || org.y >= clip.y + clip.height)
+        {
+            return;
+        }
+        Size size = get_mat_size();
+        uint16_t wrap_width = word_wrap ? uint16_t(size.width - org.x) : 0;
+        Rect text_rect(org.x, org.y, size.width - org.x, size.height - org.y);
+        if(display_list != nullptr || (text_rect & clip) != text_rect)
+        {
+            // may cross the clip rect, measure it
+            Size text_size = font.get_text_size(text, wrap_width);
+            text_rect &= Rect(org, text_size);
+            if((text_rect & clip).empty())
+            {
+                return;
+            }
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_text(text_rect, clip, text, org, font, text_color, bg_color, word_wrap);
+            if(consumed_chars != nullptr)
+            {
+                *consumed_chars = int(text.length());
+            }
+            update_dirty_rect(text_rect);
+            return;
+        }
+        get_text_bitmap_result_t rc = draw_text(text, text_rect, font, text_color, bg_color, wrap_width);
         if(consumed_chars != nullptr)
         {
             *consumed_chars = rc.consumed_chars;
         }
-        update_dirty_rect(text_rect);
+        update_dirty_rect(Rect(org, rc.text_size));
     }
 
-    void Painter::putText(std::wstring_view text, Point org, UnicodeFont& font, uint16_t text_color, uint16_t bg_color, bool word_wrap, int *consumed_chars)
+    void Painter::putText(std::wstring_view text, Point org, UnicodeFont& font, uint32_t text_color, uint32_t bg_color, bool word_wrap, int *consumed_chars)
     {
         putText(std::string_view(reinterpret_cast<const char*>(text.data()), text.length() * 2), org, font, text_color, bg_color, word_wrap, consumed_chars);
     }
 
-    void Painter::drawBitmap(const Mat& bitmap, Point org)
+    get_text_bitmap_result_t Painter::draw_text(std::string_view text, Rect text_rect, FontBase& font, uint32_t text_color, uint32_t bg_color, uint16_t wrap_width)
     {
-        if(bitmap.type != mat.type)
+        Rect target = text_rect & clip;
+        if(target == text_rect)
         {
-            return;
+            return font.get_text_bitmap(text, clip_mat(text_rect - clip.tl()), text_color, bg_color, wrap_width);
         }
-        Rect target_rect(org.x, org.y, bitmap.cols, bitmap.rows);
-        target_rect &= Rect(0, 0, mat.cols, mat.rows);
-        Rect src_rect(0, 0, target_rect.width, target_rect.height);
-        if(org.x < 0) src_rect.x = -org.x;
-        if(org.y < 0) src_rect.y = -org.y;
-        if(!target_rect.empty())
-        {
-#if HAS_DMA2D
-            dma2d_copy(bitmap, src_rect, mat, target_rect.tl());
-#else
-            switch(bitmap.type)
+        // partly visible: render the whole text into scratch memory holding
+        // the visible pixels, so anti-aliasing and transparent backgrounds
+        // blend over them, then copy those back
+        FrameVector<uint8_t> scratch_data(FrameAllocator<uint8_t>{frame_arena});
+        Mat scratch(text_rect.size(), mat.type, nullptr);
+        scratch_data.resize(scratch.step[0] * scratch.rows);
+        scratch.data = scratch_data.data();
+        Rect visible = target - text_rect.tl();
+        Mat dest = clip_mat(target - clip.tl());
+        dest.copyTo(scratch(visible));
+        get_text_bitmap_result_t rc = font.get_text_bitmap(text, scratch, text_color, bg_color, wrap_width);
+        scratch(visible).copyTo(dest);
+        return rc;
+    }
+
+    // copy src_rect of bitmap to dest_pos of mat, both of the same type
+    static void copy_bitmap(const Mat& bitmap, Rect src_rect, Mat& mat, Point dest_pos)
+    {
+        if(bitmap.type == L4)
+        {
+            for(int row = 0; row < src_rect.height; row++)
             {
-            case MONO8:
-                for(int row = 0; row < src_rect.height; row++)
-                {
-                    const uint8_t *p_src = bitmap.ptr<uint8_t>(src_rect.y + row, src_rect.x);
-                    uint8_t *p_target = mat.ptr<uint8_t>(target_rect.y + row, target_rect.x);
-                    std::copy_n(p_src, src_rect.width, p_target);
-                }
-                break;
-            case RGB565:
-                for(int row = 0; row < src_rect.height; row++)
+                const uint8_t *p_src = bitmap.ptr<uint8_t>(src_rect.y + row);
+                uint8_t *p_target = mat.ptr<uint8_t>(dest_pos.y + row);
+                for(int col = 0; col < src_rect.width; col++)
                 {
-                    const uint16_t *p_src = bitmap.ptr<uint16_t>(src_rect.y + row, src_rect.x);
-                    uint16_t *p_target = mat.ptr<uint16_t>(target_rect.y + row, target_rect.x);
-                    std::copy_n(p_src, src_rect.width, p_target);
+                    int src_x = src_rect.x + col, target_x = dest_pos.x + col;
+                    int shift = (target_x & 1) * 4;
+                    uint8_t index = (p_src[src_x / 2] >> ((src_x & 1) * 4)) & 0x0F;
+                    p_target[target_x / 2] = uint8_t((p_target[target_x / 2] & ~(0x0F << shift)) | (index << shift));
                 }
-                break;
             }
-#endif
-            update_dirty_rect(target_rect);
+            return;
+        }
+        size_t row_size = src_rect.width * bitmap.elemSize();
+        for(int row = 0; row < src_rect.height; row++)
+        {
+            copy_span(mat.ptr<uint8_t>(dest_pos.y + row, dest_pos.x), bitmap.ptr<uint8_t>(src_rect.y + row, src_rect.x), row_size);
         }
     }
 
-    void Painter::drawMarker(Point position, uint16_t color, int markerType, int markerSize, int thickness)
+    void Painter::drawBitmap(const Mat& bitmap, Point org)
+    {
+        Rect bounds(org.x, org.y, bitmap.cols, bitmap.rows);
+        if((bounds & clip).empty())
+        {
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            if(bitmap.type == display_list->get_type())
+            {
+                display_list->record_bitmap(bounds, clip, bitmap, org);
+                update_dirty_rect(bounds);
+            }
+            return;
+        }
+        if(bitmap.type != mat.type)
+        {
+            return;
+        }
+        Rect target_rect = (bounds & clip) - clip.tl();
+        Rect src_rect = target_rect - (org - clip.tl());
+        // L4 ROIs must start at an even column
+        if(bitmap.type != L4 || ((src_rect.x | target_rect.x) & 1) == 0)
+        {
+            Mat source = bitmap(src_rect), target = clip_mat(target_rect);
+            selectBlitter(BLIT_COPY, source, target).copy(source, target);
+        }
+        else
+        {
+            copy_bitmap(bitmap, src_rect, clip_mat, target_rect.tl());
+        }
+        update_dirty_rect(bounds);
+    }
+
+    void Painter::drawBitmap(const Mat& bitmap, Point org, uint8_t alpha, uint32_t color)
+    {
+        Rect bounds(org.x, org.y, bitmap.cols, bitmap.rows);
+        const int type = display_list != nullptr ? display_list->get_type() : mat.type;
+        if((bounds & clip).empty() || alpha == 0 || !getCpuBlitter()->supports(BLIT_BLEND, bitmap.type, type))
+        {
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_bitmap(bounds, clip, bitmap, org, true, alpha, color);
+            update_dirty_rect(bounds);
+            return;
+        }
+        Rect target_rect = (bounds & clip) - clip.tl();
+        Rect src_rect = target_rect - (org - clip.tl());
+        Mat source = bitmap(src_rect), target = clip_mat(target_rect);
+        selectBlitter(BLIT_BLEND, source, target).blend(source, target, alpha, color);
+        update_dirty_rect(bounds);
+    }
+
+    void Painter::drawBitmap(const Mat& bitmap, Point org, const uint32_t* palette, bool blend)
+    {
+        Rect bounds(org.x, org.y, bitmap.cols, bitmap.rows);
+        const int type = display_list != nullptr ? display_list->get_type() : mat.type;
+        if((bounds & clip).empty() || palette == nullptr || !getCpuBlitter()->supports(BLIT_EXPAND, bitmap.type, type))
+        {
+            return;
+        }
+        if(display_list != nullptr)
+        {
+            display_list->record_bitmap(bounds, clip, bitmap, org, blend, 255, 0, palette);
+            update_dirty_rect(bounds);
+            return;
+        }
+        Rect target_rect = (bounds & clip) - clip.tl();
+        Rect src_rect = target_rect - (org - clip.tl());
+        Mat target = clip_mat(target_rect);
+        if(bitmap.type != L4 || (src_rect.x & 1) == 0)
+        {
+            Mat source = bitmap(src_rect);
+            selectBlitter(BLIT_EXPAND, source, target).expand(source, target, palette, blend);
+        }
+        else
+        {
+            // L4 ROIs must start at an even column: move the indices to
+            // scratch memory that starts with the first visible one
+            FrameVector<uint8_t> scratch_data(FrameAllocator<uint8_t>{frame_arena});
+            Mat scratch(src_rect.size(), L4, nullptr);
+            scratch_data.resize(scratch.step[0] * scratch.rows);
+            scratch.data = scratch_data.data();
+            copy_bitmap(bitmap, src_rect, scratch, Point(0, 0));
+            selectBlitter(BLIT_EXPAND, scratch, target).expand(scratch, target, palette, blend);
+        }
+        update_dirty_rect(bounds);
+    }
+
+    void Painter::drawMarker(Point position, uint32_t color, int markerType, int markerSize, int thickness)
     {
         switch(markerType)
         {
@@ -1516,18 +1930,70 @@ namespace cv
 
     Rect Painter::get_dirty_rect() const
     {
-        return dirty_rect;
+        return dirty_region.bounds();
+    }
+
+    const DirtyRegion& Painter::get_dirty_region() const
+    {
+        return dirty_region;
+    }
+
+    void Painter::set_dirty_merge_percent(int percent)
+    {
+        dirty_region.set_merge_percent(percent);
     }
 
     void Painter::update_dirty_rect(Rect rc)
     {
-        dirty_rect |= rc;
-        dirty_rect &= Rect(0, 0, mat.cols, mat.rows);
+        dirty_region.add(rc & clip);
     }
 
     void Painter::reset_dirty_rect()
     {
-        dirty_rect = Rect();
+        dirty_region.clear();
+    }
+
+    void Painter::set_frame_arena(FrameArena* arena)
+    {
+        frame_arena = arena;
+    }
+
+    FrameArena* Painter::get_frame_arena() const
+    {
+        return frame_arena;
+    }
+
+    bool Painter::push_clip(const Rect& rc)
+    {
+        if(clip_depth == MAX_CLIP_DEPTH)
+        {
+            return false;
+        }
+        clip_stack[clip_depth++] = clip;
+        set_clip(clip & rc);
+        return true;
+    }
+
+    void Painter::pop_clip()
+    {
+        if(clip_depth > 0)
+        {
+            set_clip(clip_stack[--clip_depth]);
+        }
+    }
+
+    Rect Painter::get_clip() const
+    {
+        return clip;
+    }
+
+    void Painter::set_clip(const Rect& rc)
+    {
+        clip = rc;
+        if(display_list == nullptr)
+        {
+            clip_mat = clip.empty() ? Mat() : mat(clip);
+        }
     }
 
     Mat Painter::get_mat() const
@@ -1537,6 +2003,10 @@ namespace cv
 
     Size Painter::get_mat_size() const
     {
+        if(display_list != nullptr)
+        {
+            return display_list->get_frame_size();
+        }
         return Size(mat.cols, mat.rows);
     }
 
@@ -3,6 +3,8 @@
 #include "mbed.h"
 #include "cvcore.h"
 #include "cvfonts.h"
+#include "cvcolor.h"
+#include "cvblit.h"
 #include "dma2d.h"
 #include <vector>
 
@@ -28,6 +30,35 @@ namespace cv
     constexpr uint8_t RGB332_YELLOW = 0xFC;
     constexpr uint8_t RGB332_WHITE = 0xFF;
 
+    constexpr uint32_t ARGB8888_TRANSPARENT = 0x00000000;
+    constexpr uint32_t ARGB8888_BLACK = 0xFF000000;
+    constexpr uint32_t ARGB8888_BLUE = 0xFF0000FF;
+    constexpr uint32_t ARGB8888_RED = 0xFFFF0000;
+    constexpr uint32_t ARGB8888_GREEN = 0xFF00FF00;
+    constexpr uint32_t ARGB8888_CYAN = 0xFF00FFFF;
+    constexpr uint32_t ARGB8888_MAGENTA = 0xFFFF00FF;
+    constexpr uint32_t ARGB8888_YELLOW = 0xFFFFFF00;
+    constexpr uint32_t ARGB8888_WHITE = 0xFFFFFFFF;
+
+    constexpr uint32_t RGB888_BLACK = 0x000000;
+    constexpr uint32_t RGB888_BLUE = 0x0000FF;
+    constexpr uint32_t RGB888_RED = 0xFF0000;
+    constexpr uint32_t RGB888_GREEN = 0x00FF00;
+    constexpr uint32_t RGB888_CYAN = 0x00FFFF;
+    constexpr uint32_t RGB888_MAGENTA = 0xFF00FF;
+    constexpr uint32_t RGB888_YELLOW = 0xFFFF00;
+    constexpr uint32_t RGB888_WHITE = 0xFFFFFF;
+
+    constexpr uint16_t ARGB4444_TRANSPARENT = 0x0000;
+    constexpr uint16_t ARGB4444_BLACK = 0xF000;
+    constexpr uint16_t ARGB4444_BLUE = 0xF00F;
+    constexpr uint16_t ARGB4444_RED = 0xFF00;
+    constexpr uint16_t ARGB4444_GREEN = 0xF0F0;
+    constexpr uint16_t ARGB4444_CYAN = 0xF0FF;
+    constexpr uint16_t ARGB4444_MAGENTA = 0xFF0F;
+    constexpr uint16_t ARGB4444_YELLOW = 0xFFF0;
+    constexpr uint16_t ARGB4444_WHITE = 0xFFFF;
+
     /** Possible set of marker types used for the cv::drawMarker function
     @ingroup imgproc_draw
     */
@@ -42,46 +73,156 @@ namespace cv
         MARKER_TRIANGLE_DOWN = 6    //!< A downwards pointing triangle marker shape
     };
 
+    // Areas changed since the last flush, as a short list of rects.
+    // A new rect merges into an existing one when the union wastes no more
+    // than merge_percent of the area they cover; when the list is full the
+    // cheapest pair is merged. Widely separated updates (a clock in one
+    // corner, a gauge in another) thus stay separate, close ones coalesce.
+    class DirtyRegion
+    {
+    public:
+        static constexpr int MAX_RECTS = 8;
+
+        explicit DirtyRegion(int merge_percent = 25);
+
+        void add(const Rect& rc);
+
+        void clear();
+
+        bool empty() const { return count == 0; }
+
+        int size() const { return count; }
+
+        const Rect* begin() const { return rects; }
+
+        const Rect* end() const { return rects + count; }
+
+        const Rect& operator[](int i) const { return rects[i]; }
+
+        // union of the rects
+        Rect bounds() const;
+
+        // sum of the rect areas; rects may overlap where merging them would waste more
+        int area() const;
+
+        void set_merge_percent(int percent);
+
+        int get_merge_percent() const;
+
+    private:
+        // pixels the union of a and b adds to the area they cover
+        static int merge_cost(const Rect& a, const Rect& b);
+
+        void remove(int i);
+
+        Rect rects[MAX_RECTS];
+        int count = 0;
+        int merge_percent;
+    };
+
+    class DisplayList;
+
+    // Colors are pixel values of the Mat type (see MatType)
+    // L4 Mats support fill and drawBitmap only
     class Painter
     {
     public:
         Painter(const Mat& _mat);
 
-        void fill(uint16_t color);
+        // Record mode: draw calls are appended to list instead of drawn, and
+        // get_mat returns an empty Mat. Text is laid out but not rendered, so
+        // consumed_chars reports the whole text.
+        explicit Painter(DisplayList& list);
+
+        void fill(uint32_t color);
 
-        void rectangle(Point pt1, Point pt2, uint16_t color, int thickness=1);
+        void rectangle(Point pt1, Point pt2, uint32_t color, int thickness=1);
 
-        void line(Point pt1, Point pt2, uint16_t color, int thickness=1);
+        void line(Point pt1, Point pt2, uint32_t color, int thickness=1);
 
-        void circle(Point center, int radius, uint16_t color, int thickness=1);
+        void circle(Point center, int radius, uint32_t color, int thickness=1);
 
-        void ellipse(const RotatedRect& box, uint16_t color, int thickness=1);
+        void ellipse(const RotatedRect& box, uint32_t color, int thickness=1);
 
-        void ellipse(Point center, Size axes, float angle, float startAngle, float endAngle, uint16_t color, int thickness=1);
+        void ellipse(Point center, Size axes, float angle, float startAngle, float endAngle, uint32_t color, int thickness=1);
 
-        void polyline(const std::vector<Point>& contour, uint16_t color, int thickness=1);
+        void polyline(const std::vector<Point>& contour, uint32_t color, int thickness=1);
 
-        void putText(std::string_view text, Point org, FontBase& font, uint16_t text_color, uint16_t bg_color, bool word_wrap = false, int *consumed_chars = nullptr);
+        void putText(std::string_view text, Point org, FontBase& font, uint32_t text_color, uint32_t bg_color, bool word_wrap = false, int *consumed_chars = nullptr);
 
-        void putText(std::wstring_view text, Point org, UnicodeFont& font, uint16_t text_color, uint16_t bg_color, bool word_wrap = false, int *consumed_chars = nullptr);
+        void putText(std::wstring_view text, Point org, UnicodeFont& font, uint32_t text_color, uint32_t bg_color, bool word_wrap = false, int *consumed_chars = nullptr);
 
         void drawBitmap(const Mat& bitmap, Point org);
 
-        void drawMarker(Point position, uint16_t color, int markerType, int markerSize, int thickness);
+        // Blend an ARGB8888, ARGB4444 or A8 bitmap over the Mat, its alpha
+        // scaled by alpha; A8 bitmaps are masks painted in color. Into
+        // RGB565, RGB332, RGB888 and ARGB8888 Mats only.
+        void drawBitmap(const Mat& bitmap, Point org, uint8_t alpha, uint32_t color = 0);
+
+        // Expand an L4 or 8-bit bitmap of palette indices through palette,
+        // 16 or 256 ARGB8888 colors; with blend the palette alpha blends the
+        // colors over the Mat, so transparent entries leave it unchanged.
+        // Into RGB565, RGB332, RGB888 and ARGB8888 Mats only. The palette
+        // must stay valid while a recorded DisplayList may be replayed.
+        void drawBitmap(const Mat& bitmap, Point org, const uint32_t* palette, bool blend = false);
+
+        void drawMarker(Point position, uint32_t color, int markerType, int markerSize, int thickness);
 
         Mat get_mat() const;
 
         Size get_mat_size() const;
 
+        // Bounding rect of the dirty region
         Rect get_dirty_rect() const;
 
+        const DirtyRegion& get_dirty_region() const;
+
+        // see DirtyRegion
+        void set_dirty_merge_percent(int percent);
+
         void update_dirty_rect(Rect rc);
 
         void reset_dirty_rect();
 
+        // Scratch memory for polygon edges and ellipse points, nullptr to use the heap
+        // The arena is not reset by Painter; reset it once per frame
+        void set_frame_arena(FrameArena* arena);
+
+        FrameArena* get_frame_arena() const;
+
+        // Restrict drawing to rc within the current clip rect, until the
+        // matching pop_clip. Draw calls whose bounds miss the clip rect return
+        // before any rasterizer setup, the others draw into the clip rect's
+        // ROI, where the rasterizers clip whole spans. Returns false if
+        // MAX_CLIP_DEPTH clip rects are pushed already.
+        bool push_clip(const Rect& rc);
+
+        void pop_clip();
+
+        // the current clip rect, the whole frame if none is pushed
+        Rect get_clip() const;
+
+        static constexpr int MAX_CLIP_DEPTH = 8;
+
     private:
+        friend class DisplayList;
+
+        void set_clip(const Rect& rc);
+
+        // Draw text laid out at text_rect.tl() with wrap_width, where
+        // text_rect is its size cut at the frame edges. Text crossing the
+        // clip rect is rendered in scratch memory and its visible part copied.
+        get_text_bitmap_result_t draw_text(std::string_view text, Rect text_rect, FontBase& font, uint32_t text_color, uint32_t bg_color, uint16_t wrap_width);
+
         Mat mat;
-        Rect dirty_rect { 0, 0, 0, 0 };
+        DisplayList* display_list = nullptr;
+        DirtyRegion dirty_region;
+        FrameArena* frame_arena = nullptr;
+        // clip rect and the ROI of mat it shows, and the clip rects pushed
+        Rect clip;
+        Mat clip_mat;
+        Rect clip_stack[MAX_CLIP_DEPTH];
+        int clip_depth = 0;
     };
 
     extern const uint16_t RGB332to565LUT[256];
@@ -0,0 +1,381 @@
+#include "cvkernels.h"
+#include <cstring>
+#include <algorithm>
+
+#if !defined(CV_SPAN_KERNELS_SWAR) && defined(__ARM_FEATURE_MVE)
+#include <arm_mve.h>
+#define CV_SPAN_MVE 1
+#elif !defined(CV_SPAN_KERNELS_SWAR) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CV_SPAN_NEON 1
+#elif !defined(CV_SPAN_KERNELS_SWAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define CV_SPAN_AVX2 1
+#elif !defined(CV_SPAN_KERNELS_SWAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CV_SPAN_SSE2 1
+#endif
+
+namespace cv
+{
+    // One vector register of the selected implementation, and its loads and
+    // stores. vec_store_aligned needs a vec_bytes aligned address.
+#if defined(CV_SPAN_MVE) || defined(CV_SPAN_NEON)
+    typedef uint8x16_t vec_t;
+    static constexpr size_t vec_bytes = 16;
+
+    static inline vec_t vec_load(const void* p)
+    {
+        return vld1q_u8(static_cast<const uint8_t*>(p));
+    }
+
+    static inline void vec_store(void* p, vec_t v)
+    {
+        vst1q_u8(static_cast<uint8_t*>(p), v);
+    }
+
+    static inline void vec_store_aligned(void* p, vec_t v)
+    {
+        vst1q_u8(static_cast<uint8_t*>(p), v);
+    }
+#elif defined(CV_SPAN_AVX2)
+    typedef __m256i vec_t;
+    static constexpr size_t vec_bytes = 32;
+
+    static inline vec_t vec_load(const void* p)
+    {
+        return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+    }
+
+    static inline void vec_store(void* p, vec_t v)
+    {
+        _mm256_storeu_si256(static_cast<__m256i*>(p), v);
+    }
+
+    static inline void vec_store_aligned(void* p, vec_t v)
+    {
+        _mm256_store_si256(static_cast<__m256i*>(p), v);
+    }
+#elif defined(CV_SPAN_SSE2)
+    typedef __m128i vec_t;
+    static constexpr size_t vec_bytes = 16;
+
+    static inline vec_t vec_load(const void* p)
+    {
+        return _mm_loadu_si128(static_cast<const __m128i*>(p));
+    }
+
+    static inline void vec_store(void* p, vec_t v)
+    {
+        _mm_storeu_si128(static_cast<__m128i*>(p), v);
+    }
+
+    static inline void vec_store_aligned(void* p, vec_t v)
+    {
+        _mm_store_si128(static_cast<__m128i*>(p), v);
+    }
+#else
+    // SWAR: a 64-bit word, stored with STRD on Cortex-M7
+    typedef uint64_t vec_t;
+    static constexpr size_t vec_bytes = 8;
+
+    static inline vec_t vec_load(const void* p)
+    {
+        vec_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline void vec_store(void* p, vec_t v)
+    {
+        memcpy(p, &v, sizeof(v));
+    }
+
+    static inline void vec_store_aligned(void* p, vec_t v)
+    {
+        memcpy(__builtin_assume_aligned(p, vec_bytes), &v, sizeof(v));
+    }
+#endif
+
+    // Byte fills and copies at least this long go to memset / memcpy: the C
+    // library versions use the widest stores and cache hints of the target
+    // and win on long runs, the kernels win on the short spans of a drawing
+    static constexpr size_t libc_span_bytes = 256;
+
+    // a vector with value in every lane
+    template<typename T>
+    static inline vec_t vec_splat(T value)
+    {
+        alignas(32) T lanes[vec_bytes / sizeof(T)];
+        std::fill_n(lanes, vec_bytes / sizeof(T), value);
+        return vec_load(lanes);
+    }
+
+    // Fill count elements of a 1, 2 or 4 byte pixel type. The first and
+    // last vectors are stored unaligned, the ones in between aligned and
+    // four at a time; overlapping stores write the same pixels again.
+    template<typename T>
+    static inline void fill_lanes(T* dst, T value, size_t count)
+    {
+        constexpr size_t lanes = vec_bytes / sizeof(T);
+        if (count < lanes)
+        {
+#if defined(CV_SPAN_MVE)
+            vst1q_p_u8(reinterpret_cast<uint8_t*>(dst), vec_splat(value), vctp8q(count * sizeof(T)));
+#else
+            while (count-- > 0)
+            {
+                *dst++ = value;
+            }
+#endif
+            return;
+        }
+        const vec_t pattern = vec_splat(value);
+        uint8_t* p = reinterpret_cast<uint8_t*>(dst);
+        uint8_t* end = p + count * sizeof(T);
+        vec_store(p, pattern);
+        vec_store(end - vec_bytes, pattern);
+        if (reinterpret_cast<uintptr_t>(p) % sizeof(T) != 0)
+        {
+            // misaligned pixels, aligned vectors would be out of phase
+            for (p += vec_bytes; p + vec_bytes <= end; p += vec_bytes)
+            {
+                vec_store(p, pattern);
+            }
+            return;
+        }
+        p = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(p) + vec_bytes) & ~uintptr_t(vec_bytes - 1));
+        for (; p + vec_bytes * 4 <= end; p += vec_bytes * 4)
+        {
+            vec_store_aligned(p, pattern);
+            vec_store_aligned(p + vec_bytes, pattern);
+            vec_store_aligned(p + vec_bytes * 2, pattern);
+            vec_store_aligned(p + vec_bytes * 3, pattern);
+        }
+        for (; p + vec_bytes <= end; p += vec_bytes)
+        {
+            vec_store_aligned(p, pattern);
+        }
+    }
+
+    const char* span_kernels_isa()
+    {
+#if defined(CV_SPAN_MVE)
+        return "MVE";
+#elif defined(CV_SPAN_NEON)
+        return "NEON";
+#elif defined(CV_SPAN_AVX2)
+        return "AVX2";
+#elif defined(CV_SPAN_SSE2)
+        return "SSE2";
+#else
+        return "SWAR";
+#endif
+    }
+
+    void fill_span8(uint8_t* dst, uint8_t value, size_t count)
+    {
+        if (count >= libc_span_bytes)
+        {
+            memset(dst, value, count);
+            return;
+        }
+        fill_lanes(dst, value, count);
+    }
+
+    void fill_span16(uint16_t* dst, uint16_t value, size_t count)
+    {
+        fill_lanes(dst, value, count);
+    }
+
+    void fill_span24(rgb888_t* dst, rgb888_t value, size_t count)
+    {
+        // vec_bytes pixels span exactly three vectors
+        if (count < vec_bytes)
+        {
+            std::fill_n(dst, count, value);
+            return;
+        }
+        rgb888_t lanes[vec_bytes];
+        std::fill_n(lanes, vec_bytes, value);
+        const uint8_t* pattern = reinterpret_cast<const uint8_t*>(lanes);
+        const vec_t p0 = vec_load(pattern);
+        const vec_t p1 = vec_load(pattern + vec_bytes);
+        const vec_t p2 = vec_load(pattern + vec_bytes * 2);
+        uint8_t* p = reinterpret_cast<uint8_t*>(dst);
+        uint8_t* end = p + count * 3;
+        for (; p + vec_bytes * 3 <= end; p += vec_bytes * 3)
+        {
+            vec_store(p, p0);
+            vec_store(p + vec_bytes, p1);
+            vec_store(p + vec_bytes * 2, p2);
+        }
+        if (p < end)
+        {
+            // the last vec_bytes pixels, overlapping the pixels already stored
+            p = end - vec_bytes * 3;
+            vec_store(p, p0);
+            vec_store(p + vec_bytes, p1);
+            vec_store(p + vec_bytes * 2, p2);
+        }
+    }
+
+    void fill_span32(uint32_t* dst, uint32_t value, size_t count)
+    {
+        fill_lanes(dst, value, count);
+    }
+
+    void copy_span(void* dst, const void* src, size_t size)
+    {
+        uint8_t* d = static_cast<uint8_t*>(dst);
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        if (size >= libc_span_bytes)
+        {
+            memcpy(d, s, size);
+            return;
+        }
+        if (size < vec_bytes)
+        {
+            while (size-- > 0)
+            {
+                *d++ = *s++;
+            }
+            return;
+        }
+        // the last vector is copied first, overlapping the body
+        vec_store(d + size - vec_bytes, vec_load(s + size - vec_bytes));
+        for (; size >= vec_bytes * 4; size -= vec_bytes * 4, d += vec_bytes * 4, s += vec_bytes * 4)
+        {
+            vec_t v0 = vec_load(s);
+            vec_t v1 = vec_load(s + vec_bytes);
+            vec_t v2 = vec_load(s + vec_bytes * 2);
+            vec_t v3 = vec_load(s + vec_bytes * 3);
+            vec_store(d, v0);
+            vec_store(d + vec_bytes, v1);
+            vec_store(d + vec_bytes * 2, v2);
+            vec_store(d + vec_bytes * 3, v3);
+        }
+        for (; size >= vec_bytes; size -= vec_bytes, d += vec_bytes, s += vec_bytes)
+        {
+            vec_store(d, vec_load(s));
+        }
+    }
+
+    static inline uint32_t rgb565_to_argb8888(uint16_t v)
+    {
+        uint32_t r = v >> 11, g = (v >> 5) & 0x3F, b = v & 0x1F;
+        return 0xFF000000u | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+    }
+
+    static inline uint16_t argb8888_to_rgb565(uint32_t v)
+    {
+        return uint16_t(((v >> 8) & 0xF800) | ((v >> 5) & 0x07E0) | ((v >> 3) & 0x001F));
+    }
+
+    void swap_bytes_span16(uint16_t* dst, const uint16_t* src, size_t count)
+    {
+        size_t x = 0;
+#if defined(CV_SPAN_NEON)
+        for (; x + 8 <= count; x += 8)
+        {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(src + x));
+            vst1q_u8(reinterpret_cast<uint8_t*>(dst + x), vrev16q_u8(v));
+        }
+#elif defined(CV_SPAN_SSE2) || defined(CV_SPAN_AVX2)
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+        }
+#elif !defined(CV_SPAN_MVE)
+        for (; x + 4 <= count; x += 4)
+        {
+            uint64_t v = vec_load(src + x);
+            vec_store(dst + x, ((v >> 8) & 0x00FF00FF00FF00FFull) | ((v << 8) & 0xFF00FF00FF00FF00ull));
+        }
+#endif
+        for (; x < count; x++)
+        {
+            dst[x] = uint16_t((src[x] >> 8) | (src[x] << 8));
+        }
+    }
+
+    void rgb565_to_argb8888_span(uint32_t* dst, const uint16_t* src, size_t count)
+    {
+        size_t x = 0;
+#if defined(CV_SPAN_NEON)
+        for (; x + 8 <= count; x += 8)
+        {
+            uint16x8_t v = vld1q_u16(src + x);
+            uint16x8_t r = vshrq_n_u16(v, 11);
+            uint16x8_t g = vandq_u16(vshrq_n_u16(v, 5), vdupq_n_u16(0x3F));
+            uint16x8_t b = vandq_u16(v, vdupq_n_u16(0x1F));
+            uint8x8x4_t out;
+            out.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+            out.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4)));
+            out.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)));
+            out.val[3] = vdup_n_u8(0xFF);
+            vst4_u8(reinterpret_cast<uint8_t*>(dst + x), out);
+        }
+#elif defined(CV_SPAN_SSE2) || defined(CV_SPAN_AVX2)
+        const __m128i mask5 = _mm_set1_epi16(0x1F);
+        const __m128i mask6 = _mm_set1_epi16(0x3F);
+        const __m128i alpha = _mm_set1_epi16(short(0xFF00));
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            __m128i r = _mm_srli_epi16(v, 11);
+            __m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+            __m128i b = _mm_and_si128(v, mask5);
+            r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+            g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+            b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+            // 16-bit halves of each pixel: G:B low, A:R high
+            __m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+            __m128i ar = _mm_or_si128(alpha, r);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_unpacklo_epi16(gb, ar));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + 4), _mm_unpackhi_epi16(gb, ar));
+        }
+#endif
+        for (; x < count; x++)
+        {
+            dst[x] = rgb565_to_argb8888(src[x]);
+        }
+    }
+
+    void argb8888_to_rgb565_span(uint16_t* dst, const uint32_t* src, size_t count)
+    {
+        size_t x = 0;
+#if defined(CV_SPAN_NEON)
+        for (; x + 8 <= count; x += 8)
+        {
+            uint8x8x4_t v = vld4_u8(reinterpret_cast<const uint8_t*>(src + x));
+            uint16x8_t r = vshlq_n_u16(vmovl_u8(vshr_n_u8(v.val[2], 3)), 11);
+            uint16x8_t g = vshlq_n_u16(vmovl_u8(vshr_n_u8(v.val[1], 2)), 5);
+            uint16x8_t b = vmovl_u8(vshr_n_u8(v.val[0], 3));
+            vst1q_u16(dst + x, vorrq_u16(vorrq_u16(r, g), b));
+        }
+#elif defined(CV_SPAN_SSE2) || defined(CV_SPAN_AVX2)
+        const __m128i mask_r = _mm_set1_epi32(0xF800);
+        const __m128i mask_g = _mm_set1_epi32(0x07E0);
+        const __m128i mask_b = _mm_set1_epi32(0x001F);
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i v[2];
+            for (int i = 0; i < 2; i++)
+            {
+                __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + i * 4));
+                __m128i c = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 8), mask_r),
+                    _mm_and_si128(_mm_srli_epi32(p, 5), mask_g)), _mm_and_si128(_mm_srli_epi32(p, 3), mask_b));
+                // sign extend so the signed pack keeps all 16 bits
+                v[i] = _mm_srai_epi32(_mm_slli_epi32(c, 16), 16);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packs_epi32(v[0], v[1]));
+        }
+#endif
+        for (; x < count; x++)
+        {
+            dst[x] = argb8888_to_rgb565(src[x]);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mbed.h"
+#include "cvcore.h"
+
+// Span kernels: fill and copy runs of pixels.
+// The implementation is selected at build time from the target's vector
+// extension: ARM MVE (Helium), ARM NEON, x86 AVX2 or x86 SSE2. Without one,
+// portable SWAR code fills with aligned 64-bit stores. Define
+// CV_SPAN_KERNELS_SWAR to force the portable code.
+
+namespace cv
+{
+    // name of the selected implementation: "MVE", "NEON", "AVX2", "SSE2" or "SWAR"
+    const char* span_kernels_isa();
+
+    // set count pixels starting at dst to value
+    void fill_span8(uint8_t* dst, uint8_t value, size_t count);
+    void fill_span16(uint16_t* dst, uint16_t value, size_t count);
+    void fill_span24(rgb888_t* dst, rgb888_t value, size_t count);
+    void fill_span32(uint32_t* dst, uint32_t value, size_t count);
+
+    // copy size bytes, the ranges must not overlap
+    void copy_span(void* dst, const void* src, size_t size);
+
+    // Pixel conversions of count pixels; swap_bytes_span16 may run in place.
+    // swap the two bytes of every 16-bit pixel (RGB565 <-> byte-swapped RGB565)
+    void swap_bytes_span16(uint16_t* dst, const uint16_t* src, size_t count);
+    // RGB565 to opaque ARGB8888, widening channels by bit replication like the DMA2D
+    void rgb565_to_argb8888_span(uint32_t* dst, const uint16_t* src, size_t count);
+    // ARGB8888 to RGB565, truncating channels like the DMA2D
+    void argb8888_to_rgb565_span(uint16_t* dst, const uint32_t* src, size_t count);
+}
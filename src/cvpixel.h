@@ -0,0 +1,261 @@
+#pragma once
+
+#include "mbed.h"
+#include "cvcore.h"
+#include "cvkernels.h"
+#include <cstring>
+#include <algorithm>
+
+// Compile-time pixel format traits.
+// Rasterizers are templates on a PixelFormat, so each one is instantiated
+// once per format with typed stores instead of branching on the pixel size.
+
+namespace cv
+{
+    // blend one channel field of a packed pixel:
+    // (fg * alpha + bg * (alpha_max - alpha)) / alpha_max
+    inline uint32_t blend_field(uint32_t bg, uint32_t fg, int shift, uint32_t mask, uint32_t alpha, uint32_t alpha_max)
+    {
+        uint32_t b = (bg >> shift) & mask;
+        uint32_t f = (fg >> shift) & mask;
+        return ((f * alpha + b * (alpha_max - alpha)) / alpha_max) << shift;
+    }
+
+    template<int Type>
+    struct PixelFormat;
+
+    // 8-bit formats (MONO8 / RGB332)
+    template<>
+    struct PixelFormat<MONO8>
+    {
+        typedef uint8_t value_type;
+        static constexpr int type = MONO8;
+        static constexpr int pixel_size = 1;
+
+        static inline value_type from_color(uint32_t color)
+        {
+            return static_cast<value_type>(color);
+        }
+
+        static inline void store(uint8_t* ptr, value_type color)
+        {
+            *ptr = color;
+        }
+
+        // fill pixels xl..xr (inclusive) of a row
+        static inline void hline(uint8_t* row, int xl, int xr, value_type color)
+        {
+            if (xr >= xl)
+            {
+                fill_span8(row + xl, color, xr - xl + 1);
+            }
+        }
+
+        // blend as RGB332, alpha in 0~alpha_max
+        static inline value_type blend(value_type bg, value_type fg, uint8_t alpha, uint8_t alpha_max)
+        {
+            return static_cast<value_type>(blend_field(bg, fg, 5, 0x07, alpha, alpha_max) |
+                blend_field(bg, fg, 2, 0x07, alpha, alpha_max) | blend_field(bg, fg, 0, 0x03, alpha, alpha_max));
+        }
+    };
+
+    // 16-bit RGB565
+    template<>
+    struct PixelFormat<RGB565>
+    {
+        typedef uint16_t value_type;
+        static constexpr int type = RGB565;
+        static constexpr int pixel_size = 2;
+
+        static inline value_type from_color(uint32_t color)
+        {
+            return static_cast<value_type>(color);
+        }
+
+        static inline void store(uint8_t* ptr, value_type color)
+        {
+            *reinterpret_cast<value_type*>(ptr) = color;
+        }
+
+        // fill pixels xl..xr (inclusive) of a row
+        static inline void hline(uint8_t* row, int xl, int xr, value_type color)
+        {
+            if (xr >= xl)
+            {
+                fill_span16(reinterpret_cast<value_type*>(row) + xl, color, xr - xl + 1);
+            }
+        }
+
+        static inline value_type blend(value_type bg, value_type fg, uint8_t alpha, uint8_t alpha_max)
+        {
+            return static_cast<value_type>(blend_field(bg, fg, 11, 0x1F, alpha, alpha_max) |
+                blend_field(bg, fg, 5, 0x3F, alpha, alpha_max) | blend_field(bg, fg, 0, 0x1F, alpha, alpha_max));
+        }
+    };
+
+    // 32-bit ARGB8888
+    template<>
+    struct PixelFormat<ARGB8888>
+    {
+        typedef uint32_t value_type;
+        static constexpr int type = ARGB8888;
+        static constexpr int pixel_size = 4;
+
+        static inline value_type from_color(uint32_t color)
+        {
+            return color;
+        }
+
+        static inline void store(uint8_t* ptr, value_type color)
+        {
+            *reinterpret_cast<value_type*>(ptr) = color;
+        }
+
+        // fill pixels xl..xr (inclusive) of a row
+        static inline void hline(uint8_t* row, int xl, int xr, value_type color)
+        {
+            if (xr >= xl)
+            {
+                fill_span32(reinterpret_cast<value_type*>(row) + xl, color, xr - xl + 1);
+            }
+        }
+
+        static inline value_type blend(value_type bg, value_type fg, uint8_t alpha, uint8_t alpha_max)
+        {
+            return blend_field(bg, fg, 24, 0xFF, alpha, alpha_max) | blend_field(bg, fg, 16, 0xFF, alpha, alpha_max) |
+                blend_field(bg, fg, 8, 0xFF, alpha, alpha_max) | blend_field(bg, fg, 0, 0xFF, alpha, alpha_max);
+        }
+    };
+
+    // 24-bit RGB888
+    template<>
+    struct PixelFormat<RGB888>
+    {
+        typedef rgb888_t value_type;
+        static constexpr int type = RGB888;
+        static constexpr int pixel_size = 3;
+
+        static inline value_type from_color(uint32_t color)
+        {
+            return value_type{ uint8_t(color), uint8_t(color >> 8), uint8_t(color >> 16) };
+        }
+
+        static inline void store(uint8_t* ptr, value_type color)
+        {
+            *reinterpret_cast<value_type*>(ptr) = color;
+        }
+
+        // fill pixels xl..xr (inclusive) of a row
+        static inline void hline(uint8_t* row, int xl, int xr, value_type color)
+        {
+            if (xr >= xl)
+            {
+                fill_span24(reinterpret_cast<value_type*>(row) + xl, color, xr - xl + 1);
+            }
+        }
+
+        static inline value_type blend(value_type bg, value_type fg, uint8_t alpha, uint8_t alpha_max)
+        {
+            return value_type{ uint8_t(blend_field(bg.b, fg.b, 0, 0xFF, alpha, alpha_max)),
+                uint8_t(blend_field(bg.g, fg.g, 0, 0xFF, alpha, alpha_max)),
+                uint8_t(blend_field(bg.r, fg.r, 0, 0xFF, alpha, alpha_max)) };
+        }
+    };
+
+    // 16-bit ARGB4444
+    template<>
+    struct PixelFormat<ARGB4444>
+    {
+        typedef uint16_t value_type;
+        static constexpr int type = ARGB4444;
+        static constexpr int pixel_size = 2;
+
+        static inline value_type from_color(uint32_t color)
+        {
+            return static_cast<value_type>(color);
+        }
+
+        static inline void store(uint8_t* ptr, value_type color)
+        {
+            *reinterpret_cast<value_type*>(ptr) = color;
+        }
+
+        // fill pixels xl..xr (inclusive) of a row
+        static inline void hline(uint8_t* row, int xl, int xr, value_type color)
+        {
+            if (xr >= xl)
+            {
+                fill_span16(reinterpret_cast<value_type*>(row) + xl, color, xr - xl + 1);
+            }
+        }
+
+        static inline value_type blend(value_type bg, value_type fg, uint8_t alpha, uint8_t alpha_max)
+        {
+            return static_cast<value_type>(blend_field(bg, fg, 12, 0x0F, alpha, alpha_max) | blend_field(bg, fg, 8, 0x0F, alpha, alpha_max) |
+                blend_field(bg, fg, 4, 0x0F, alpha, alpha_max) | blend_field(bg, fg, 0, 0x0F, alpha, alpha_max));
+        }
+    };
+
+    // 8-bit alpha (coverage masks)
+    template<>
+    struct PixelFormat<A8>
+    {
+        typedef uint8_t value_type;
+        static constexpr int type = A8;
+        static constexpr int pixel_size = 1;
+
+        static inline value_type from_color(uint32_t color)
+        {
+            return static_cast<value_type>(color);
+        }
+
+        static inline void store(uint8_t* ptr, value_type color)
+        {
+            *ptr = color;
+        }
+
+        // fill pixels xl..xr (inclusive) of a row
+        static inline void hline(uint8_t* row, int xl, int xr, value_type color)
+        {
+            if (xr >= xl)
+            {
+                fill_span8(row + xl, color, xr - xl + 1);
+            }
+        }
+
+        static inline value_type blend(value_type bg, value_type fg, uint8_t alpha, uint8_t alpha_max)
+        {
+            return static_cast<value_type>(blend_field(bg, fg, 0, 0xFF, alpha, alpha_max));
+        }
+    };
+
+    // Call fn(PixelFormat<type>()) for the pixel format of a Mat type
+    // Returns false for unsupported types, including L4, whose pixels are
+    // not byte addressable
+    template<typename Fn>
+    inline bool dispatch_pixel_format(int type, Fn&& fn)
+    {
+        switch (type)
+        {
+        case MONO8:
+            fn(PixelFormat<MONO8>());
+            return true;
+        case RGB565:
+            fn(PixelFormat<RGB565>());
+            return true;
+        case ARGB8888:
+            fn(PixelFormat<ARGB8888>());
+            return true;
+        case RGB888:
+            fn(PixelFormat<RGB888>());
+            return true;
+        case ARGB4444:
+            fn(PixelFormat<ARGB4444>());
+            return true;
+        case A8:
+            fn(PixelFormat<A8>());
+            return true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,609 @@
+#include "cvrender.h"
+
+namespace cv
+{
+    // fill a record with zeros first, so padding compares equal in diff
+    template<typename T>
+    static T zeroed()
+    {
+        T record;
+        memset(&record, 0, sizeof(record));
+        return record;
+    }
+
+    template<typename T>
+    static T load(const uint8_t* data)
+    {
+        T record;
+        memcpy(&record, data, sizeof(record));
+        return record;
+    }
+
+    DisplayList::DisplayList(Size _frame_size, int _type)
+        : frame_size(_frame_size), type(_type)
+    {
+    }
+
+    void DisplayList::clear()
+    {
+        buffer.clear();
+        offsets.clear();
+        culled.clear();
+        culled_area = 0;
+    }
+
+    bool DisplayList::empty() const
+    {
+        return offsets.empty();
+    }
+
+    int DisplayList::size() const
+    {
+        return int(offsets.size());
+    }
+
+    size_t DisplayList::byte_size() const
+    {
+        return buffer.size();
+    }
+
+    Size DisplayList::get_frame_size() const
+    {
+        return frame_size;
+    }
+
+    int DisplayList::get_type() const
+    {
+        return type;
+    }
+
+    uint8_t* DisplayList::append(CommandType cmd_type, const Rect& bounds, const Rect& clip, size_t payload_size, uint8_t flags)
+    {
+        Rect visible = bounds & clip;
+        Header hdr = zeroed<Header>();
+        hdr.type = cmd_type;
+        hdr.flags = flags | (visible != bounds ? CLIPPED : 0);
+        hdr.size = uint16_t(payload_size);
+        hdr.x = int16_t(visible.x);
+        hdr.y = int16_t(visible.y);
+        hdr.width = int16_t(visible.width);
+        hdr.height = int16_t(visible.height);
+        size_t offset = buffer.size();
+        offsets.push_back(uint32_t(offset));
+        buffer.resize(offset + sizeof(Header) + payload_size);
+        memcpy(&buffer[offset], &hdr, sizeof(Header));
+        return &buffer[offset + sizeof(Header)];
+    }
+
+    void DisplayList::record_fill(const Rect& clip, uint32_t color)
+    {
+        memcpy(append(FILL, Rect(Point(), frame_size), clip, sizeof(color)), &color, sizeof(color));
+    }
+
+    void DisplayList::record_shape(CommandType cmd_type, const Rect& bounds, const Rect& clip, uint32_t color, int thickness, Point pt1, Point pt2)
+    {
+        Shape shape = zeroed<Shape>();
+        shape.color = color;
+        shape.thickness = int16_t(thickness);
+        shape.x1 = int16_t(pt1.x);
+        shape.y1 = int16_t(pt1.y);
+        shape.x2 = int16_t(pt2.x);
+        shape.y2 = int16_t(pt2.y);
+        memcpy(append(cmd_type, bounds, clip, sizeof(shape)), &shape, sizeof(shape));
+    }
+
+    void DisplayList::record_ellipse(const Rect& bounds, const Rect& clip, uint32_t color, int thickness, Point center, Size axes, float angle, float start_angle, float end_angle)
+    {
+        Arc arc = zeroed<Arc>();
+        arc.color = color;
+        arc.thickness = int16_t(thickness);
+        arc.x = int16_t(center.x);
+        arc.y = int16_t(center.y);
+        arc.axis_x = int16_t(axes.width);
+        arc.axis_y = int16_t(axes.height);
+        arc.angle = angle;
+        arc.start_angle = start_angle;
+        arc.end_angle = end_angle;
+        memcpy(append(ELLIPSE, bounds, clip, sizeof(arc)), &arc, sizeof(arc));
+    }
+
+    void DisplayList::record_ellipse(const Rect& bounds, const Rect& clip, uint32_t color, int thickness, const RotatedRect& rotated_rect)
+    {
+        Box box = zeroed<Box>();
+        box.color = color;
+        box.thickness = int16_t(thickness);
+        box.x = rotated_rect.center.x;
+        box.y = rotated_rect.center.y;
+        box.width = rotated_rect.size.width;
+        box.height = rotated_rect.size.height;
+        box.angle = rotated_rect.angle;
+        memcpy(append(ELLIPSE_BOX, bounds, clip, sizeof(box)), &box, sizeof(box));
+    }
+
+    void DisplayList::record_polyline(const Rect& bounds, const Rect& clip, uint32_t color, int thickness, const std::vector<Point>& contour)
+    {
+        Poly poly = zeroed<Poly>();
+        poly.color = color;
+        poly.thickness = int16_t(thickness);
+        poly.count = uint16_t(contour.size());
+        uint8_t* data = append(POLYLINE, bounds, clip, sizeof(poly) + poly.count * 4);
+        memcpy(data, &poly, sizeof(poly));
+        data += sizeof(poly);
+        for(int i = 0; i < poly.count; i++)
+        {
+            int16_t xy[2] = { int16_t(contour[i].x), int16_t(contour[i].y) };
+            memcpy(data + i * 4, xy, 4);
+        }
+    }
+
+    void DisplayList::record_text(const Rect& bounds, const Rect& clip, std::string_view str, Point org, FontBase& font, uint32_t color, uint32_t bg_color, bool word_wrap)
+    {
+        Text text = zeroed<Text>();
+        text.color = color;
+        text.bg_color = bg_color;
+        text.x = int16_t(org.x);
+        text.y = int16_t(org.y);
+        text.width = int16_t(bounds.width);
+        text.height = int16_t(bounds.height);
+        text.length = uint16_t(std::min(str.length(), size_t(UINT16_MAX - sizeof(Text))));
+        text.font = &font;
+        uint8_t* data = append(TEXT, bounds, clip, sizeof(text) + text.length, word_wrap ? WORD_WRAP : 0);
+        memcpy(data, &text, sizeof(text));
+        memcpy(data + sizeof(text), str.data(), text.length);
+    }
+
+    void DisplayList::record_bitmap(const Rect& bounds, const Rect& clip, const Mat& mat, Point org, bool blend, uint8_t alpha, uint32_t color, const uint32_t* palette)
+    {
+        Bitmap bitmap = zeroed<Bitmap>();
+        bitmap.x = int16_t(org.x);
+        bitmap.y = int16_t(org.y);
+        bitmap.rows = int16_t(mat.rows);
+        bitmap.cols = int16_t(mat.cols);
+        bitmap.type = mat.type;
+        bitmap.step = uint32_t(mat.step[0]);
+        bitmap.data = mat.data;
+        if(blend)
+        {
+            bitmap.color = color;
+            bitmap.alpha = alpha;
+        }
+        bitmap.palette = palette;
+        const uint8_t flags = (blend ? BLEND : 0) | (palette != nullptr ? INDEXED : 0);
+        memcpy(append(BITMAP, bounds, clip, sizeof(bitmap), flags), &bitmap, sizeof(bitmap));
+    }
+
+    DisplayList::Header DisplayList::header(int index) const
+    {
+        return load<Header>(&buffer[offsets[index]]);
+    }
+
+    const uint8_t* DisplayList::payload(int index) const
+    {
+        return &buffer[offsets[index] + sizeof(Header)];
+    }
+
+    Rect DisplayList::bounds(int index) const
+    {
+        Header hdr = header(index);
+        return Rect(hdr.x, hdr.y, hdr.width, hdr.height);
+    }
+
+    Rect DisplayList::opaque_rect(int index) const
+    {
+        Header hdr = header(index);
+        Rect cmd_bounds(hdr.x, hdr.y, hdr.width, hdr.height);
+        const uint8_t* data = payload(index);
+        switch(hdr.type)
+        {
+        case FILL:
+            return cmd_bounds;
+        case RECTANGLE:
+        {
+            Shape shape = load<Shape>(data);
+            // the filled rectangle includes both corners; L4 Mats do not
+            // draw rectangles
+            if(shape.thickness >= 0 || type == L4)
+            {
+                return Rect();
+            }
+            return Rect(Point(std::min(shape.x1, shape.x2), std::min(shape.y1, shape.y2)),
+                       Point(std::max(shape.x1, shape.x2) + 1, std::max(shape.y1, shape.y2) + 1)) & cmd_bounds;
+        }
+        case BITMAP:
+        {
+            if(hdr.flags & BLEND)
+            {
+                return Rect();
+            }
+            Bitmap bitmap = load<Bitmap>(data);
+            return Rect(bitmap.x, bitmap.y, bitmap.cols, bitmap.rows) & cmd_bounds;
+        }
+        }
+        return Rect();
+    }
+
+    bool DisplayList::is_culled(int index) const
+    {
+        return index < int(culled.size()) && culled[index];
+    }
+
+    int DisplayList::cull()
+    {
+        // walk back from the last command, collecting the opaque rects of
+        // the commands drawn after the current one
+        Rect occluders[MAX_OCCLUDERS];
+        int occluder_count = 0;
+        int culled_count = 0;
+        culled.assign(size(), 0);
+        culled_area = 0;
+        for(int i = size() - 1; i >= 0; i--)
+        {
+            Rect cmd_bounds = bounds(i);
+            for(int k = 0; k < occluder_count && !culled[i]; k++)
+            {
+                culled[i] = !cmd_bounds.empty() && (cmd_bounds & occluders[k]) == cmd_bounds;
+            }
+            if(culled[i])
+            {
+                culled_count++;
+                culled_area += cmd_bounds.area();
+                continue;
+            }
+            Rect rc = opaque_rect(i);
+            if(rc.empty())
+            {
+                continue;
+            }
+            if(occluder_count < MAX_OCCLUDERS)
+            {
+                occluders[occluder_count++] = rc;
+                continue;
+            }
+            // replace the smallest occluder
+            int smallest = 0;
+            for(int k = 1; k < occluder_count; k++)
+            {
+                if(occluders[k].area() < occluders[smallest].area())
+                {
+                    smallest = k;
+                }
+            }
+            if(rc.area() > occluders[smallest].area())
+            {
+                occluders[smallest] = rc;
+            }
+        }
+        return culled_count;
+    }
+
+    int DisplayList::get_culled_area() const
+    {
+        return culled_area;
+    }
+
+    std::string_view DisplayList::command_bytes(int index) const
+    {
+        return std::string_view(reinterpret_cast<const char*>(&buffer[offsets[index]]), sizeof(Header) + header(index).size);
+    }
+
+    void DisplayList::replay_text(Painter& painter, const Header& hdr, const uint8_t* data, Point offset) const
+    {
+        Text text = load<Text>(data);
+        std::string_view str(reinterpret_cast<const char*>(data + sizeof(Text)), text.length);
+        // wrap as drawing into the whole frame would
+        uint16_t wrap_width = (hdr.flags & WORD_WRAP) ? uint16_t(frame_size.width - text.x) : 0;
+        painter.draw_text(str, Rect(text.x, text.y, text.width, text.height) - offset, *text.font, text.color, text.bg_color, wrap_width);
+    }
+
+    void DisplayList::replay(Painter& painter, Point offset) const
+    {
+        Rect area = painter.get_clip() + offset;
+        std::vector<Point> contour;
+        for(int i = 0; i < size(); i++)
+        {
+            if(!is_culled(i) && !(bounds(i) & area).empty())
+            {
+                replay_command(painter, i, offset, contour);
+            }
+        }
+    }
+
+    void DisplayList::replay_command(Painter& painter, int index, Point offset, std::vector<Point>& contour) const
+    {
+        Header hdr = header(index);
+        const uint8_t* data = payload(index);
+        Rect cmd_bounds = Rect(hdr.x, hdr.y, hdr.width, hdr.height) - offset;
+        Rect painter_clip = painter.get_clip();
+        if(hdr.flags & CLIPPED)
+        {
+            // the bounds are cut to the clip rect it was drawn under
+            painter.set_clip(painter_clip & cmd_bounds);
+        }
+        switch(hdr.type)
+        {
+        case FILL:
+            painter.fill(load<uint32_t>(data));
+            break;
+        case RECTANGLE:
+        case LINE:
+        case CIRCLE:
+        {
+            Shape shape = load<Shape>(data);
+            Point pt1 = Point(shape.x1, shape.y1) - offset, pt2 = Point(shape.x2, shape.y2) - offset;
+            if(hdr.type == RECTANGLE)
+            {
+                painter.rectangle(pt1, pt2, shape.color, shape.thickness);
+            }
+            else if(hdr.type == LINE)
+            {
+                painter.line(pt1, pt2, shape.color, shape.thickness);
+            }
+            else
+            {
+                painter.circle(pt1, shape.x2, shape.color, shape.thickness);
+            }
+            break;
+        }
+        case ELLIPSE:
+        {
+            Arc arc = load<Arc>(data);
+            painter.ellipse(Point(arc.x, arc.y) - offset, Size(arc.axis_x, arc.axis_y), arc.angle, arc.start_angle, arc.end_angle,
+                arc.color, arc.thickness);
+            break;
+        }
+        case ELLIPSE_BOX:
+        {
+            Box box = load<Box>(data);
+            RotatedRect rotated_rect(Point2f(box.x - offset.x, box.y - offset.y), Size2f(box.width, box.height), box.angle);
+            painter.ellipse(rotated_rect, box.color, box.thickness);
+            break;
+        }
+        case POLYLINE:
+        {
+            Poly poly = load<Poly>(data);
+            contour.resize(poly.count);
+            for(int j = 0; j < poly.count; j++)
+            {
+                int16_t xy[2];
+                memcpy(xy, data + sizeof(Poly) + j * 4, 4);
+                contour[j] = Point(xy[0], xy[1]) - offset;
+            }
+            painter.polyline(contour, poly.color, poly.thickness);
+            break;
+        }
+        case TEXT:
+            replay_text(painter, hdr, data, offset);
+            painter.update_dirty_rect(cmd_bounds);
+            break;
+        case BITMAP:
+        {
+            Bitmap bitmap = load<Bitmap>(data);
+            Mat mat(bitmap.rows, bitmap.cols, bitmap.type, bitmap.data, bitmap.step);
+            if(hdr.flags & INDEXED)
+            {
+                painter.drawBitmap(mat, Point(bitmap.x, bitmap.y) - offset, bitmap.palette, (hdr.flags & BLEND) != 0);
+            }
+            else if(hdr.flags & BLEND)
+            {
+                painter.drawBitmap(mat, Point(bitmap.x, bitmap.y) - offset, bitmap.alpha, bitmap.color);
+            }
+            else
+            {
+                painter.drawBitmap(mat, Point(bitmap.x, bitmap.y) - offset);
+            }
+            break;
+        }
+        }
+        if(hdr.flags & CLIPPED)
+        {
+            painter.set_clip(painter_clip);
+        }
+    }
+
+    void DisplayList::redraw(Painter& painter, const DirtyRegion& damage) const
+    {
+        Mat mat = painter.get_mat();
+        for(const Rect& rect : damage)
+        {
+            Rect area = rect & painter.get_clip();
+            if(area.empty())
+            {
+                continue;
+            }
+            Painter area_painter(mat(area));
+            area_painter.set_frame_arena(painter.get_frame_arena());
+            replay(area_painter, area.tl());
+            painter.update_dirty_rect(area);
+        }
+    }
+
+    // FNV-1a, to compare commands before their bytes
+    static uint32_t command_hash(std::string_view bytes)
+    {
+        uint32_t hash = 2166136261u;
+        for(char c : bytes)
+        {
+            hash = (hash ^ uint8_t(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    void DisplayList::diff(const DisplayList& previous, const DisplayList& current, DirtyRegion& damage)
+    {
+        if(previous.frame_size != current.frame_size || previous.type != current.type)
+        {
+            damage.add(Rect(Point(), current.frame_size));
+            return;
+        }
+        std::vector<uint32_t> previous_hashes(previous.size()), current_hashes(current.size());
+        for(int i = 0; i < previous.size(); i++)
+        {
+            previous_hashes[i] = command_hash(previous.command_bytes(i));
+        }
+        for(int j = 0; j < current.size(); j++)
+        {
+            current_hashes[j] = command_hash(current.command_bytes(j));
+        }
+        auto same = [&](int i, int j) {
+            return previous_hashes[i] == current_hashes[j] && previous.command_bytes(i) == current.command_bytes(j);
+        };
+
+        // Match the lists in order, skipping the commands removed from
+        // previous or inserted into current. Outside the bounds of the
+        // unmatched commands both lists draw the same commands in the same
+        // order, so the pixels there are equal.
+        int i = 0, j = 0;
+        while(i < previous.size() && j < current.size())
+        {
+            if(same(i, j))
+            {
+                i++;
+                j++;
+                continue;
+            }
+            // distance to the next match of current[j] in previous, and of
+            // previous[i] in current
+            int removed = 0, inserted = 0;
+            for(int k = 1; k <= DIFF_WINDOW && i + k < previous.size() && removed == 0; k++)
+            {
+                removed = same(i + k, j) ? k : 0;
+            }
+            for(int k = 1; k <= DIFF_WINDOW && j + k < current.size() && inserted == 0; k++)
+            {
+                inserted = same(i, j + k) ? k : 0;
+            }
+            if(removed > 0 && (inserted == 0 || removed <= inserted))
+            {
+                for(; removed > 0; removed--)
+                {
+                    damage.add(previous.bounds(i++));
+                }
+            }
+            else if(inserted > 0)
+            {
+                for(; inserted > 0; inserted--)
+                {
+                    damage.add(current.bounds(j++));
+                }
+            }
+            else
+            {
+                // changed in place
+                damage.add(previous.bounds(i++));
+                damage.add(current.bounds(j++));
+            }
+        }
+        for(; i < previous.size(); i++)
+        {
+            damage.add(previous.bounds(i));
+        }
+        for(; j < current.size(); j++)
+        {
+            damage.add(current.bounds(j));
+        }
+    }
+
+    bool render_bands(const DisplayList& list, const Mat& band, Callback<void(const Mat& band, int y)> output, FrameArena* arena)
+    {
+        Size frame_size = list.get_frame_size();
+        if(band.type != list.get_type() || band.cols != frame_size.width || band.rows <= 0)
+        {
+            return false;
+        }
+        for(int y = 0; y < frame_size.height; y += band.rows)
+        {
+            Mat current = band(Rect(0, 0, band.cols, std::min(band.rows, frame_size.height - y)));
+            Painter painter(current);
+            painter.set_frame_arena(arena);
+            list.replay(painter, Point(0, y));
+            output(current, y);
+        }
+        return true;
+    }
+
+    TileRenderer::TileRenderer(const Mat& _tile)
+        : tile(_tile)
+    {
+    }
+
+    bool TileRenderer::render(const DisplayList& list, const Mat& frame, FrameArena* arena)
+    {
+        Size frame_size = list.get_frame_size();
+        if(frame.type != list.get_type() || tile.type != list.get_type() || frame.size() != frame_size || tile.empty())
+        {
+            return false;
+        }
+        const int tiles_x = (frame_size.width + tile.cols - 1) / tile.cols;
+        const int tiles_y = (frame_size.height + tile.rows - 1) / tile.rows;
+        const Rect frame_rect(Point(), frame_size);
+
+        // count the commands of every tile, turn the counts into the ends of
+        // the bins, then fill the bins back to front, which leaves bin_start
+        // at the start of each bin and the commands in order
+        bin_start.assign(tiles_x * tiles_y + 1, 0);
+        auto for_each_tile = [&](int index, auto&& visit) {
+            Rect rect = list.bounds(index) & frame_rect;
+            if(rect.empty() || list.is_culled(index))
+            {
+                return;
+            }
+            int tx1 = (rect.x + rect.width - 1) / tile.cols, ty1 = (rect.y + rect.height - 1) / tile.rows;
+            for(int ty = rect.y / tile.rows; ty <= ty1; ty++)
+            {
+                for(int tx = rect.x / tile.cols; tx <= tx1; tx++)
+                {
+                    visit(ty * tiles_x + tx);
+                }
+            }
+        };
+        for(int i = 0; i < list.size(); i++)
+        {
+            for_each_tile(i, [&](int t) { bin_start[t]++; });
+        }
+        for(size_t t = 1; t < bin_start.size(); t++)
+        {
+            bin_start[t] += bin_start[t - 1];
+        }
+        bin_commands.resize(bin_start.back());
+        for(int i = list.size() - 1; i >= 0; i--)
+        {
+            for_each_tile(i, [&](int t) { bin_commands[--bin_start[t]] = i; });
+        }
+
+        tiles_drawn = 0;
+        commands_drawn = 0;
+        for(int ty = 0; ty < tiles_y; ty++)
+        {
+            for(int tx = 0; tx < tiles_x; tx++)
+            {
+                int t = ty * tiles_x + tx;
+                if(bin_start[t] == bin_start[t + 1])
+                {
+                    continue;
+                }
+                Rect rect = Rect(tx * tile.cols, ty * tile.rows, tile.cols, tile.rows) & frame_rect;
+                Mat target = tile(Rect(0, 0, rect.width, rect.height));
+                Painter painter(target);
+                painter.set_frame_arena(arena);
+                for(uint32_t k = bin_start[t]; k < bin_start[t + 1]; k++)
+                {
+                    list.replay_command(painter, bin_commands[k], rect.tl(), contour);
+                }
+                target.copyTo(frame(rect));
+                tiles_drawn++;
+                commands_drawn += bin_start[t + 1] - bin_start[t];
+            }
+        }
+        return true;
+    }
+
+    int TileRenderer::get_tiles_drawn() const
+    {
+        return tiles_drawn;
+    }
+
+    int TileRenderer::get_commands_drawn() const
+    {
+        return commands_drawn;
+    }
+}
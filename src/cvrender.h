@@ -0,0 +1,247 @@
+#pragma once
+
+#include "mbed.h"
+#include "cvimgproc.h"
+
+// Deferred rendering: a Painter constructed on a DisplayList records its draw
+// calls instead of drawing them, and the list is replayed later into any Mat
+// that shows a part of the frame. render_bands replays a frame over a small
+// band buffer, one horizontal band after the other, so a frame can be drawn
+// without a framebuffer of its full size. Retained-mode screens record each
+// frame, diff it against the previous one and redraw only the damage.
+
+namespace cv
+{
+    // Draw calls of one frame, recorded by a Painter in record mode.
+    // Commands are packed back to back in a byte buffer with 16-bit
+    // coordinates, the range the fixed-point rasterizers handle anyway; a
+    // line takes 28 bytes. Fonts and bitmaps are referenced, not copied: they
+    // must outlive the list, and a bitmap changed in place is not seen by diff.
+    class DisplayList
+    {
+    public:
+        // frame_size and type are those of the frame the commands draw
+        DisplayList(Size frame_size, int type);
+
+        void clear();
+
+        bool empty() const;
+
+        // number of recorded commands
+        int size() const;
+
+        // bytes taken by the recorded commands
+        size_t byte_size() const;
+
+        Size get_frame_size() const;
+
+        int get_type() const;
+
+        // Draw the commands into the Mat of painter, which shows the area of
+        // the frame at offset. Commands outside the area are skipped, the
+        // others are clipped to it, so the pixels match drawing the whole
+        // frame at once.
+        void replay(Painter& painter, Point offset = Point()) const;
+
+        // Replay the rects of damage into the same rects of the frame painter
+        // draws, and add them to its dirty region
+        void redraw(Painter& painter, const DirtyRegion& damage) const;
+
+        // Add to damage the areas where drawing current may give other pixels
+        // than drawing previous: the bounds of the commands that are not in
+        // both lists in the same order. Commands are matched by content,
+        // insertions and removals of up to DIFF_WINDOW commands are found.
+        static void diff(const DisplayList& previous, const DisplayList& current, DirtyRegion& damage);
+
+        static constexpr int DIFF_WINDOW = 32;
+
+        // Mark the commands a later opaque command covers completely, so
+        // replay skips them. Opaque are fill, filled rectangles and
+        // drawBitmap without alpha or blending, which replaces pixels; up to
+        // MAX_OCCLUDERS of the largest are tracked. Commands recorded
+        // afterwards are not culled until cull is called again. Returns the
+        // number of culled commands.
+        int cull();
+
+        // Pixels within the bounds of the culled commands: the overdraw a
+        // replay saves
+        int get_culled_area() const;
+
+        static constexpr int MAX_OCCLUDERS = 8;
+
+    private:
+        friend class Painter;
+        friend class TileRenderer;
+
+        enum CommandType : uint8_t
+        {
+            FILL,
+            RECTANGLE,
+            LINE,
+            CIRCLE,
+            ELLIPSE,
+            ELLIPSE_BOX,
+            POLYLINE,
+            TEXT,
+            BITMAP
+        };
+
+        enum HeaderFlags : uint8_t
+        {
+            WORD_WRAP = 1,
+            // drawn under a clip rect that cuts its bounds, replayed clipped
+            // to the bounds
+            CLIPPED = 2,
+            // a bitmap blended with alpha and color
+            BLEND = 4,
+            // a bitmap of palette indices, expanded through palette
+            INDEXED = 8
+        };
+
+        // Every command starts with a Header, followed by size bytes of the
+        // payload of its type. Records are copied in and out with memcpy, so
+        // the buffer needs no alignment, and zeroed first, so equal commands
+        // have equal bytes.
+        struct Header
+        {
+            uint8_t type;
+            uint8_t flags;
+            uint16_t size;
+            // pixels the command may change, in frame coordinates, within
+            // the clip rect it was recorded under
+            int16_t x, y, width, height;
+        };
+
+        // rectangle and line from pt1 to pt2, circle at pt1 with radius x2
+        struct Shape
+        {
+            uint32_t color;
+            int16_t thickness;
+            int16_t x1, y1, x2, y2;
+        };
+
+        struct Arc
+        {
+            uint32_t color;
+            int16_t thickness;
+            int16_t x, y, axis_x, axis_y;
+            float angle, start_angle, end_angle;
+        };
+
+        struct Box
+        {
+            uint32_t color;
+            int16_t thickness;
+            float x, y, width, height, angle;
+        };
+
+        // followed by count x, y pairs of int16_t
+        struct Poly
+        {
+            uint32_t color;
+            int16_t thickness;
+            uint16_t count;
+        };
+
+        // followed by length bytes of text; x, y, width and height are the
+        // text area, which a clip rect may cut from the header bounds
+        struct Text
+        {
+            uint32_t color, bg_color;
+            int16_t x, y, width, height;
+            uint16_t length;
+            FontBase* font;
+        };
+
+        struct Bitmap
+        {
+            int16_t x, y;
+            int16_t rows, cols;
+            int32_t type;
+            uint32_t step;
+            uint8_t* data;
+            uint32_t color;
+            uint8_t alpha;
+            const uint32_t* palette;
+        };
+
+        // bounds are those of the command, clip the clip rect of the Painter
+        void record_fill(const Rect& clip, uint32_t color);
+        void record_shape(CommandType cmd_type, const Rect& bounds, const Rect& clip, uint32_t color, int thickness, Point pt1, Point pt2);
+        void record_ellipse(const Rect& bounds, const Rect& clip, uint32_t color, int thickness, Point center, Size axes, float angle, float start_angle, float end_angle);
+        void record_ellipse(const Rect& bounds, const Rect& clip, uint32_t color, int thickness, const RotatedRect& box);
+        void record_polyline(const Rect& bounds, const Rect& clip, uint32_t color, int thickness, const std::vector<Point>& contour);
+        void record_text(const Rect& bounds, const Rect& clip, std::string_view str, Point org, FontBase& font, uint32_t color, uint32_t bg_color, bool word_wrap);
+        void record_bitmap(const Rect& bounds, const Rect& clip, const Mat& bitmap, Point org, bool blend = false, uint8_t alpha = 255, uint32_t color = 0, const uint32_t* palette = nullptr);
+
+        // append the header of a command with payload_size bytes of payload,
+        // and return the payload
+        uint8_t* append(CommandType cmd_type, const Rect& bounds, const Rect& clip, size_t payload_size, uint8_t flags = 0);
+
+        Header header(int index) const;
+        const uint8_t* payload(int index) const;
+        Rect bounds(int index) const;
+        // pixels the command is sure to overwrite, empty if not opaque
+        Rect opaque_rect(int index) const;
+        bool is_culled(int index) const;
+        // header and payload of a command
+        std::string_view command_bytes(int index) const;
+
+        // draw the command at index with painter, whose Mat shows the frame
+        // at offset; contour is reused for the points of polylines
+        void replay_command(Painter& painter, int index, Point offset, std::vector<Point>& contour) const;
+        void replay_text(Painter& painter, const Header& hdr, const uint8_t* data, Point offset) const;
+
+        Size frame_size;
+        int type;
+        std::vector<uint8_t> buffer;
+        // start of every command in buffer
+        std::vector<uint32_t> offsets;
+        // culled flag of each command up to the last cull
+        std::vector<uint8_t> culled;
+        int culled_area = 0;
+    };
+
+    // Replay list over bands of the height of band, from the top of the frame
+    // down, passing each finished band and its frame row to output. The band
+    // Mat must be of the list type and as wide as the frame; the last band may
+    // be lower. Bands are not cleared: the list should cover every pixel,
+    // usually by starting with fill(). Returns false if band does not fit.
+    bool render_bands(const DisplayList& list, const Mat& band, Callback<void(const Mat& band, int y)> output, FrameArena* arena = nullptr);
+
+    // Tile-binned replay for framebuffers in external SDRAM. Commands are
+    // binned to the tiles their bounds overlap, each tile is drawn into a
+    // small scratch Mat and then written to the frame in one copy (through
+    // the DMA2D where Mat::copyTo uses it). The rasterizers' scattered
+    // writes and their overdraw stay in the scratch Mat, best placed in
+    // DTCM, e.g. through a MatAllocator arena over it, and each frame pixel
+    // crosses the memory bus once instead of once per command covering it.
+    class TileRenderer
+    {
+    public:
+        // tile is the scratch Mat, its size is the tile size (e.g. 64x64)
+        explicit TileRenderer(const Mat& tile);
+
+        // Draw list into frame, which must be of the list frame size and of
+        // the type of list and tile. As with render_bands, tiles are not
+        // cleared: the list should cover every pixel, usually by starting
+        // with fill(). Tiles no command overlaps are left as they are.
+        // Returns false if frame or tile do not fit.
+        bool render(const DisplayList& list, const Mat& frame, FrameArena* arena = nullptr);
+
+        // tiles drawn and written to the frame by the last render
+        int get_tiles_drawn() const;
+
+        // commands drawn by the last render, summed over the tiles
+        int get_commands_drawn() const;
+
+    private:
+        Mat tile;
+        // bin_start[i] to bin_start[i + 1] are the commands of tile i
+        std::vector<uint32_t> bin_start;
+        std::vector<uint32_t> bin_commands;
+        std::vector<Point> contour;
+        int tiles_drawn = 0;
+        int commands_drawn = 0;
+    };
+}
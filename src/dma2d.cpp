@@ -1,4 +1,7 @@
 #include "dma2d.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
 
 #if defined(DMA2D)
 
@@ -6,26 +9,342 @@
 
 static bool dma2d_initialized = false;
 
-void clean_cache_for_matrix(const cv::Mat& mat, const cv::Rect& roi)
+// DMA2D color mode used to move the pixels of a mat type
+// 8-bit types are moved as L8, and L4 as L8 pairs of pixels
+static uint32_t dma2d_color_mode(int type)
+{
+  switch(type)
+  {
+  case cv::ARGB8888:
+    return 0;
+  case cv::RGB888:
+    return 1;
+  case cv::RGB565:
+    return 2;
+  case cv::ARGB4444:
+    return 4;
+  }
+  return 5; // L8
+}
+
+// bytes per pixel of dma2d_color_mode()
+static size_t dma2d_pixel_bytes(int type)
+{
+  switch(type)
+  {
+  case cv::ARGB8888:
+    return 4;
+  case cv::RGB888:
+    return 3;
+  case cv::RGB565:
+  case cv::ARGB4444:
+    return 2;
+  }
+  return 1;
+}
+
+// number of DMA2D pixels in width pixels of a mat type
+static int dma2d_width(int type, int width)
+{
+  return type == cv::L4 ? (width + 1) / 2 : width;
+}
+
+// D-cache maintenance. The DMA2D reads and writes memory behind the D-cache:
+// before a transfer the lines it reads are cleaned, and the lines it writes
+// cleaned and invalidated, so no dirty line is evicted over its output;
+// after it the lines it wrote are invalidated, so the CPU reads its output
+// rather than lines cached meanwhile. Memory in non-cacheable regions is
+// left alone.
+
+enum dma2d_cache_op
+{
+  CACHE_CLEAN,
+  CACHE_CLEAN_INVALIDATE,
+  CACHE_INVALIDATE
+};
+
+// rows of bytes a transfer reads or writes
+struct dma2d_area
+{
+  uintptr_t addr;
+  uint32_t row_bytes;
+  uint32_t stride;
+  uint32_t rows;
+};
+
+static constexpr uintptr_t DCACHE_LINE = 32;
+
+// a maintenance call costs about as much as this many lines more
+static constexpr uint32_t DCACHE_CALL_LINES = 4;
+
+struct dma2d_region
+{
+  uintptr_t start, end;
+};
+
+static dma2d_region dma2d_non_cacheable[DMA2D_NON_CACHEABLE_REGIONS];
+static int dma2d_non_cacheable_count = 0;
+
+bool dma2d_set_non_cacheable(const volatile void* addr, size_t size)
 {
+  if (dma2d_non_cacheable_count == DMA2D_NON_CACHEABLE_REGIONS)
+  {
+    return false;
+  }
+  const uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  dma2d_non_cacheable[dma2d_non_cacheable_count++] = { start, start + size };
+  return true;
+}
+
+static bool dma2d_is_non_cacheable(uintptr_t start, uintptr_t end)
+{
+  for (int i = 0; i < dma2d_non_cacheable_count; i++)
+  {
+    if (start >= dma2d_non_cacheable[i].start && end <= dma2d_non_cacheable[i].end)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
 #if defined (__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
-  if(mat.elemSize() == 1)
+// maintain the lines of bytes start to end; lines an invalidated range only
+// covers in part may hold CPU writes next to it, and are cleaned too
+static void dma2d_maintain_range(dma2d_cache_op op, uintptr_t start, uintptr_t end)
+{
+  uintptr_t first = start & ~(DCACHE_LINE - 1), last = (end + DCACHE_LINE - 1) & ~(DCACHE_LINE - 1);
+  if (op == CACHE_INVALIDATE)
   {
-    uint32_t startAddr = (uint32_t)mat.ptr<uint8_t>(roi.y, roi.x);
-    uint32_t endAddr = (uint32_t)mat.ptr<uint8_t>(roi.y + roi.height - 1, roi.x + roi.width - 1);
-    uint32_t byteSize = endAddr - startAddr + 1;
-    uint32_t alignedAddr = startAddr &  ~0x1F;
-    SCB_CleanDCache_by_Addr((void*)alignedAddr, byteSize + (startAddr - alignedAddr));
+    if (first != start)
+    {
+      SCB_CleanInvalidateDCache_by_Addr((void*)first, DCACHE_LINE);
+      first += DCACHE_LINE;
+    }
+    if (last != end && last - DCACHE_LINE >= first)
+    {
+      last -= DCACHE_LINE;
+      SCB_CleanInvalidateDCache_by_Addr((void*)last, DCACHE_LINE);
+    }
+    if (last > first)
+    {
+      SCB_InvalidateDCache_by_Addr((void*)first, int32_t(last - first));
+    }
+  }
+  else if (op == CACHE_CLEAN)
+  {
+    SCB_CleanDCache_by_Addr((void*)first, int32_t(last - first));
   }
   else
   {
-    uint32_t startAddr = (uint32_t)mat.ptr<uint16_t>(roi.y, roi.x);
-    uint32_t endAddr = (uint32_t)mat.ptr<uint16_t>(roi.y + roi.height - 1, roi.x + roi.width - 1);
-    uint32_t byteSize = endAddr - startAddr + 2;
-    uint32_t alignedAddr = startAddr &  ~0x1F;
-    SCB_CleanDCache_by_Addr((void*)alignedAddr, byteSize + (startAddr - alignedAddr));
+    SCB_CleanInvalidateDCache_by_Addr((void*)first, int32_t(last - first));
+  }
+}
+#endif
+
+// Maintain the lines of area by the cheapest of: one span from its first to
+// its last byte, which takes the lines of the padding between rows too; row
+// by row, one call each; the whole D-cache, once there are more lines to go
+// through than it holds (it also drops the lines the CPU works on, so calls
+// alone do not tip it). Invalidating the whole D-cache also cleans it. An
+// output is invalidated row by row when whole lines fit between its rows.
+static void dma2d_maintain(const dma2d_area& area, dma2d_cache_op op)
+{
+#if defined (__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+  if (area.rows == 0 || area.row_bytes == 0)
+  {
+    return;
+  }
+  const uintptr_t start = area.addr, end = area.addr + uintptr_t(area.rows - 1) * area.stride + area.row_bytes;
+  if (dma2d_is_non_cacheable(start, end))
+  {
+    return;
+  }
+  const uint32_t span_lines = uint32_t((((end + DCACHE_LINE - 1) & ~(DCACHE_LINE - 1)) - (start & ~(DCACHE_LINE - 1))) / DCACHE_LINE);
+  // a row starting within a line takes one more
+  const uint32_t row_lines = (area.row_bytes + 2 * DCACHE_LINE - 2) / DCACHE_LINE;
+  // invalidating one span would also drop the CPU writes in the lines
+  // between the rows, once the padding can hold a whole line
+  const bool gap_lines = op == CACHE_INVALIDATE && area.stride >= area.row_bytes + DCACHE_LINE;
+  const bool by_row = area.rows > 1 && area.stride > area.row_bytes &&
+    (gap_lines || area.rows * (row_lines + DCACHE_CALL_LINES) < span_lines);
+  if (std::min(span_lines, area.rows * row_lines) > DMA2D_DCACHE_BYTES / DCACHE_LINE)
+  {
+    if (op == CACHE_CLEAN)
+    {
+      SCB_CleanDCache();
+    }
+    else
+    {
+      SCB_CleanInvalidateDCache();
+    }
+  }
+  else if (by_row)
+  {
+    for (uint32_t row = 0; row < area.rows; row++)
+    {
+      const uintptr_t row_start = area.addr + uintptr_t(row) * area.stride;
+      dma2d_maintain_range(op, row_start, row_start + area.row_bytes);
+    }
+  }
+  else
+  {
+    dma2d_maintain_range(op, start, end);
+  }
+#else
+  (void)area;
+  (void)op;
+#endif
+}
+
+void clean_cache_for_matrix(const cv::Mat& mat, const cv::Rect& roi)
+{
+  const size_t bits = mat.elemBits();
+  const uintptr_t start = reinterpret_cast<uintptr_t>(mat.ptr<uint8_t>(roi.y) + roi.x * bits / 8);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(mat.ptr<uint8_t>(roi.y) + ((roi.x + roi.width) * bits + 7) / 8);
+  dma2d_maintain({ start, uint32_t(end - start), uint32_t(mat.step[0]), uint32_t(roi.height) }, CACHE_CLEAN);
+}
+
+// Register values of a queued transfer
+struct dma2d_job
+{
+  uint32_t cr;
+  uintptr_t fgmar;
+  uint32_t fgor;
+  uint32_t fgpfccr;
+  uint32_t fgcolr;
+  uintptr_t fgcmar; // CLUT to load before the transfer, 0 if none or resident
+  uintptr_t bgmar;
+  uint32_t bgor;
+  uint32_t bgpfccr;
+  uintptr_t omar;
+  uint32_t oor;
+  uint32_t opfccr;
+  uint32_t ocolr;
+  uint32_t nlr;
+  uint32_t lwr; // line watermark interrupt every lwr lines, 0 if none
+};
+
+// bits per pixel of a DMA2D color mode
+static uint32_t dma2d_mode_bits(uint32_t color_mode)
+{
+  static const uint8_t bits[] = { 32, 24, 16, 16, 16, 8, 8, 16, 4, 8, 4 };
+  return color_mode < sizeof(bits) ? bits[color_mode] : 0;
+}
+
+// the rows of a layer of job: at addr, offset pixels apart
+static dma2d_area dma2d_layer_area(const dma2d_job& job, uintptr_t addr, uint32_t offset, uint32_t color_mode)
+{
+  const uint32_t width = (job.nlr >> 16) & 0x3FFF, bits = dma2d_mode_bits(color_mode);
+  return { addr, (width * bits + 7) / 8, (width + (offset & 0x3FFF)) * bits / 8, job.nlr & 0xFFFF };
+}
+
+static dma2d_area dma2d_output_area(const dma2d_job& job)
+{
+  // memory-to-memory copies write in the foreground color mode
+  const bool copy = (job.cr & DMA2D_CR_MODE) == 0;
+  return dma2d_layer_area(job, job.omar, job.oor, copy ? job.fgpfccr & DMA2D_FGPFCCR_CM : job.opfccr & 0x7);
+}
+
+// Fences count the submitted and the completed jobs; the job of fence f is
+// in slot f % DMA2D_QUEUE_SIZE while f is after dma2d_completed, and the
+// job after dma2d_completed runs if any is queued.
+static dma2d_job dma2d_queue[DMA2D_QUEUE_SIZE];
+static volatile dma2d_fence_t dma2d_submitted = 0;
+static volatile dma2d_fence_t dma2d_completed = 0;
+// output lines of the running job reached by its line watermarks
+static volatile int dma2d_lines = 0;
+
+// The CLUT in the foreground CLUT memory once the queued jobs have run: a
+// copy of the colors it is loaded with and the FGPFCCR bits it is loaded with
+// (CCM, CS); none after a reset. Kept by dma2d_submit, in queue order.
+static uint8_t dma2d_clut[256 * 4];
+static uint32_t dma2d_clut_bytes = 0;
+static uint32_t dma2d_clut_format = 0;
+
+static uint32_t dma2d_clut_size(uint32_t fgpfccr)
+{
+  const uint32_t entries = ((fgpfccr & DMA2D_FGPFCCR_CS) >> 8) + 1;
+  return entries * ((fgpfccr & DMA2D_FGPFCCR_CCM) ? 3 : 4);
+}
+
+// whether the CLUT of job is loaded by the time it runs: the same colors in
+// the same color mode, with at least as many entries, wherever they are
+// read from
+static bool dma2d_clut_resident(const dma2d_job& job)
+{
+  const uint32_t clut_bytes = dma2d_clut_size(job.fgpfccr);
+  return clut_bytes <= dma2d_clut_bytes && (job.fgpfccr & DMA2D_FGPFCCR_CCM) == (dma2d_clut_format & DMA2D_FGPFCCR_CCM) &&
+    memcmp(reinterpret_cast<const void*>(job.fgcmar), dma2d_clut, clut_bytes) == 0;
+}
+
+// A job with a CLUT to load starts with the load; the interrupt of its
+// completion starts the transfer.
+static void dma2d_start(const dma2d_job& job)
+{
+  dma2d_lines = 0;
+  const uint32_t clut_enables = job.fgcmar != 0 ? DMA2D_CR_CTCIE | DMA2D_CR_CAEIE : 0;
+  DMA2D->CR = job.cr | DMA2D_CR_TCIE | DMA2D_CR_TEIE | DMA2D_CR_CEIE | (job.lwr != 0 ? DMA2D_CR_TWIE : 0) | clut_enables;
+  DMA2D->LWR = job.lwr;
+  DMA2D->FGMAR = job.fgmar;
+  DMA2D->FGOR = job.fgor;
+  DMA2D->FGCOLR = job.fgcolr;
+  DMA2D->BGMAR = job.bgmar;
+  DMA2D->BGOR = job.bgor;
+  DMA2D->BGPFCCR = job.bgpfccr;
+  DMA2D->OMAR = job.omar;
+  DMA2D->OOR = job.oor;
+  DMA2D->OCOLR = job.ocolr;
+  DMA2D->OPFCCR = job.opfccr;
+  DMA2D->NLR = job.nlr;
+  DMA2D->FGPFCCR = job.fgpfccr;
+  if (job.fgcmar != 0)
+  {
+    DMA2D->FGCMAR = job.fgcmar; // CLUT Address
+    DMA2D->FGPFCCR |= DMA2D_FGPFCCR_START; // Load CLUT
+    return;
+  }
+  DMA2D->CR |= DMA2D_CR_START;
+}
+
+// Line watermark: the running job has written LWR lines (one more if the
+// hardware numbers the watermark line from 0); count LWR and move the
+// watermark on by the job's step.
+// CLUT transfer complete: start the transfer of the running job.
+// Transfer complete or transfer / configuration / CLUT access error: the job
+// is done either way, start the next one.
+static void dma2d_irq_handler()
+{
+  const uint32_t isr = DMA2D->ISR;
+  if (isr & DMA2D_ISR_CTCIF)
+  {
+    DMA2D->IFCR = DMA2D_IFCR_CCTCIF;
+    DMA2D->CR |= DMA2D_CR_START;
+    return;
+  }
+  if (isr & DMA2D_ISR_TWIF)
+  {
+    DMA2D->IFCR = DMA2D_IFCR_CTWIF;
+    const dma2d_job& job = dma2d_queue[(dma2d_completed + 1) % DMA2D_QUEUE_SIZE];
+    const uint32_t lines = DMA2D->LWR & 0xFFFF;
+    dma2d_lines = int(lines);
+    if (lines + job.lwr < (job.nlr & 0xFFFF))
+    {
+      DMA2D->LWR = lines + job.lwr;
+    }
+    if ((isr & (DMA2D_ISR_TCIF | DMA2D_ISR_TEIF | DMA2D_ISR_CEIF | DMA2D_ISR_CAEIF)) == 0)
+    {
+      return;
+    }
+  }
+  DMA2D->IFCR = DMA2D_IFCR_CTCIF | DMA2D_IFCR_CTEIF | DMA2D_IFCR_CCEIF | DMA2D_IFCR_CAECIF;
+  dma2d_fence_t completed = dma2d_completed + 1;
+  dma2d_maintain(dma2d_output_area(dma2d_queue[completed % DMA2D_QUEUE_SIZE]), CACHE_INVALIDATE);
+  dma2d_completed = completed;
+  if (dma2d_submitted != completed)
+  {
+    dma2d_start(dma2d_queue[(completed + 1) % DMA2D_QUEUE_SIZE]);
   }
-#endif  
 }
 
 void dma2d_init()
@@ -35,6 +354,9 @@ void dma2d_init()
         __HAL_RCC_DMA2D_CLK_ENABLE();
         __HAL_RCC_DMA2D_FORCE_RESET();
         __HAL_RCC_DMA2D_RELEASE_RESET();
+        dma2d_clut_bytes = 0;
+        NVIC_SetVector(DMA2D_IRQn, reinterpret_cast<uintptr_t>(&dma2d_irq_handler));
+        NVIC_EnableIRQ(DMA2D_IRQn);
         dma2d_initialized = true;
     }
 }
@@ -43,81 +365,186 @@ void dma2d_deinit()
 {
     if(dma2d_initialized)
     {
+        dma2d_wait();
+        NVIC_DisableIRQ(DMA2D_IRQn);
         __HAL_RCC_DMA2D_FORCE_RESET();
         __HAL_RCC_DMA2D_CLK_DISABLE();
         dma2d_initialized = false;
     }
 }
 
-void dma2d_wait()
+static dma2d_fence_t dma2d_submit(dma2d_job job)
 {
-  while (DMA2D->CR & DMA2D_CR_START)
+  dma2d_init();
+  if (job.fgcmar != 0)
   {
-      ThisThread::yield();
+    // the CLUT of the job queued last is the one loaded before this job
+    if (dma2d_clut_resident(job))
+    {
+      job.fgcmar = 0;
+    }
+    else
+    {
+      const uint32_t clut_bytes = dma2d_clut_size(job.fgpfccr);
+      dma2d_maintain({ job.fgcmar, clut_bytes, clut_bytes, 1 }, CACHE_CLEAN);
+      memcpy(dma2d_clut, reinterpret_cast<const void*>(job.fgcmar), clut_bytes);
+      dma2d_clut_bytes = clut_bytes;
+      dma2d_clut_format = job.fgpfccr;
+    }
   }
+  const uint32_t mode = job.cr & DMA2D_CR_MODE;
+  if (mode != 0x00030000UL) // not R2M
+  {
+    dma2d_maintain(dma2d_layer_area(job, job.fgmar, job.fgor, job.fgpfccr & DMA2D_FGPFCCR_CM), CACHE_CLEAN);
+  }
+  if (mode == 0x00020000UL && job.bgmar != job.omar) // blending over other pixels than the output
+  {
+    dma2d_maintain(dma2d_layer_area(job, job.bgmar, job.bgor, job.bgpfccr & DMA2D_BGPFCCR_CM), CACHE_CLEAN);
+  }
+  dma2d_maintain(dma2d_output_area(job), CACHE_CLEAN_INVALIDATE);
+  core_util_critical_section_enter();
+  while (dma2d_submitted - dma2d_completed >= uint32_t(DMA2D_QUEUE_SIZE))
+  {
+    // queue full, let the interrupt retire a job
+    core_util_critical_section_exit();
+    ThisThread::yield();
+    core_util_critical_section_enter();
+  }
+  dma2d_fence_t fence = dma2d_submitted + 1;
+  dma2d_queue[fence % DMA2D_QUEUE_SIZE] = job;
+  dma2d_submitted = fence;
+  if (fence == dma2d_completed + 1)
+  {
+    // idle
+    dma2d_start(job);
+  }
+  core_util_critical_section_exit();
+  return fence;
 }
 
-void dma2d_fill(const cv::Mat& mat, uint16_t color)
+void dma2d_invalidate_clut()
 {
-  dma2d_init();
-  // See https://www.eet-china.com/mp/a60976.html
-  DMA2D->CR = 0x00030000UL; // R2M
-  DMA2D->OMAR = reinterpret_cast<uint32_t>(mat.data); // target addr
-  DMA2D->NLR  = (uint32_t)(mat.cols << 16) | (uint16_t)mat.rows; // cols & rows
-  DMA2D->OOR = mat.step[0] / mat.step[1] - mat.cols; // target offset
-  DMA2D->OCOLR   = color; // color
-  DMA2D->OPFCCR  = mat.elemSize() == 1 ? 5/*L8*/ : 2/*RGB565*/; // format
-  DMA2D->CR |= DMA2D_CR_START;
-  dma2d_wait();
+  dma2d_clut_bytes = 0;
 }
 
-void dma2d_copy(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos)
+bool dma2d_fence_done(dma2d_fence_t fence)
 {
-  dma2d_init();
-  // See https://www.eet-china.com/mp/a60976.html
-  DMA2D->CR = 0x00000000UL; // M2M fetch only
-  if(src_mat.elemSize() == 1)
+  core_util_critical_section_enter();
+  // fences wrap around, compare their distance
+  bool done = int32_t(dma2d_completed - fence) >= 0;
+  core_util_critical_section_exit();
+  return done;
+}
+
+int dma2d_fence_lines(dma2d_fence_t fence)
+{
+  core_util_critical_section_enter();
+  int lines = 0;
+  if (int32_t(dma2d_completed - fence) >= 0)
   {
-    DMA2D->FGMAR   = reinterpret_cast<uint32_t>(src_mat.ptr<uint8_t>(src_roi.y, src_roi.x)); // source addr
-    DMA2D->OMAR = reinterpret_cast<uint32_t>(dest_mat.ptr<uint8_t>(dest_pos.y, dest_pos.x)); // target addr
-    DMA2D->FGPFCCR  = 5; // L8
+    lines = INT_MAX;
   }
-  else
+  else if (fence == dma2d_completed + 1)
   {
-    DMA2D->FGMAR   = reinterpret_cast<uint32_t>(src_mat.ptr<uint16_t>(src_roi.y, src_roi.x)); // source addr
-    DMA2D->OMAR = reinterpret_cast<uint32_t>(dest_mat.ptr<uint16_t>(dest_pos.y, dest_pos.x)); // target addr
-    DMA2D->FGPFCCR  = 2; // RGB565
+    lines = dma2d_lines;
   }
-  DMA2D->FGOR    = src_mat.step[0] / src_mat.step[1] - src_roi.width;     // source offset
-  DMA2D->OOR     = dest_mat.step[0] / dest_mat.step[1] - src_roi.width;     // dest offset
-  DMA2D->NLR  = (uint32_t(src_roi.width) << 16) | (uint16_t)src_roi.height; // cols & rows
-  clean_cache_for_matrix(src_mat, src_roi);
-  DMA2D->CR |= DMA2D_CR_START;
-  dma2d_wait();
+  core_util_critical_section_exit();
+  return lines;
 }
 
-void dma2d_flat_copy(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer)
+void dma2d_wait_fence(dma2d_fence_t fence)
 {
-  dma2d_init();
-  // See https://www.eet-china.com/mp/a60976.html
-  DMA2D->CR = 0x00000000UL; // M2M fetch only
-  if(mat.elemSize() == 1)
+  while (!dma2d_fence_done(fence))
   {
-      DMA2D->FGMAR   = reinterpret_cast<uint32_t>(mat.ptr<uint8_t>(roi.y, roi.x)); // source addr
-      DMA2D->FGPFCCR  = 5; // L8
+      ThisThread::yield();
   }
-  else
+}
+
+dma2d_fence_t dma2d_last_fence()
+{
+  return dma2d_submitted;
+}
+
+void dma2d_wait()
+{
+  dma2d_wait_fence(dma2d_submitted);
+}
+
+dma2d_fence_t dma2d_submit_fill(const cv::Mat& mat, uint32_t color)
+{
+  if(mat.type == cv::L4)
   {
-      DMA2D->FGMAR   = reinterpret_cast<uint32_t>(mat.ptr<uint16_t>(roi.y, roi.x)); // source addr
-      DMA2D->FGPFCCR  = 2; // RGB565
+    // no 4-bit output mode, fill bytes holding two pixels
+    if(mat.cols & 1)
+    {
+      // the CPU fill must not race queued transfers to the mat
+      dma2d_wait();
+      cv::Mat target(mat);
+      target = color;
+      return dma2d_last_fence();
+    }
+    color = (color & 0x0F) * 0x11;
   }
-  DMA2D->OMAR = reinterpret_cast<uint32_t>(buffer); // target addr
-  DMA2D->FGOR    = mat.step[0] / mat.step[1] - roi.width;     // source offset
-  DMA2D->OOR     = 0;     // target offset
-  DMA2D->NLR  = (uint32_t(roi.width) << 16) | (uint16_t)roi.height; // cols & rows
-  clean_cache_for_matrix(mat, roi);
-  DMA2D->CR |= DMA2D_CR_START;
-  dma2d_wait();
+  const size_t pixel_bytes = dma2d_pixel_bytes(mat.type);
+  const int width = dma2d_width(mat.type, mat.cols);
+  // See https://www.eet-china.com/mp/a60976.html
+  dma2d_job job = {};
+  job.cr = 0x00030000UL; // R2M
+  job.omar = reinterpret_cast<uintptr_t>(mat.data); // target addr
+  job.nlr = (uint32_t(width) << 16) | (uint16_t)mat.rows; // cols & rows
+  job.oor = mat.step[0] / pixel_bytes - width; // target offset
+  job.ocolr = color; // color
+  job.opfccr = dma2d_color_mode(mat.type); // format
+  return dma2d_submit(job);
+}
+
+dma2d_fence_t dma2d_submit_copy(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos)
+{
+  const size_t bits = src_mat.elemBits();
+  const size_t pixel_bytes = dma2d_pixel_bytes(src_mat.type);
+  const int width = dma2d_width(src_mat.type, src_roi.width);
+  // See https://www.eet-china.com/mp/a60976.html
+  dma2d_job job = {};
+  job.cr = 0x00000000UL; // M2M fetch only
+  job.fgmar = reinterpret_cast<uintptr_t>(src_mat.ptr<uint8_t>(src_roi.y) + src_roi.x * bits / 8); // source addr
+  job.omar = reinterpret_cast<uintptr_t>(dest_mat.ptr<uint8_t>(dest_pos.y) + dest_pos.x * bits / 8); // target addr
+  job.fgpfccr = dma2d_color_mode(src_mat.type); // format
+  job.fgor = src_mat.step[0] / pixel_bytes - width; // source offset
+  job.oor = dest_mat.step[0] / pixel_bytes - width; // dest offset
+  job.nlr = (uint32_t(width) << 16) | (uint16_t)src_roi.height; // cols & rows
+  return dma2d_submit(job);
+}
+
+dma2d_fence_t dma2d_submit_flat_copy(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer)
+{
+  const size_t bits = mat.elemBits();
+  const size_t pixel_bytes = dma2d_pixel_bytes(mat.type);
+  const int width = dma2d_width(mat.type, roi.width);
+  // See https://www.eet-china.com/mp/a60976.html
+  dma2d_job job = {};
+  job.cr = 0x00000000UL; // M2M fetch only
+  job.fgmar = reinterpret_cast<uintptr_t>(mat.ptr<uint8_t>(roi.y) + roi.x * bits / 8); // source addr
+  job.fgpfccr = dma2d_color_mode(mat.type); // format
+  job.omar = reinterpret_cast<uintptr_t>(buffer); // target addr
+  job.fgor = mat.step[0] / pixel_bytes - width; // source offset
+  job.oor = 0; // target offset
+  job.nlr = (uint32_t(width) << 16) | (uint16_t)roi.height; // cols & rows
+  return dma2d_submit(job);
+}
+
+void dma2d_fill(const cv::Mat& mat, uint32_t color)
+{
+  dma2d_wait_fence(dma2d_submit_fill(mat, color));
+}
+
+void dma2d_copy(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos)
+{
+  dma2d_wait_fence(dma2d_submit_copy(src_mat, src_roi, dest_mat, dest_pos));
+}
+
+void dma2d_flat_copy(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer)
+{
+  dma2d_wait_fence(dma2d_submit_flat_copy(mat, roi, buffer));
 }
 
 const uint8_t RGB332toRGB888LUT[768] = {
@@ -171,23 +598,163 @@ const uint8_t RGB332toRGB888LUT[768] = {
     0xff,0xff,0xdb,0xff,0x00,0xff,0xff,0x55,0xff,0xff,0xaa,0xff,0xff,0xff,0xff,0xff
 };
 
+const uint8_t GRAY8toRGB888LUT[768] = {
+    0x00,0x00,0x00,0x01,0x01,0x01,0x02,0x02,0x02,0x03,0x03,0x03,0x04,0x04,0x04,0x05,
+    0x05,0x05,0x06,0x06,0x06,0x07,0x07,0x07,0x08,0x08,0x08,0x09,0x09,0x09,0x0a,0x0a,
+    0x0a,0x0b,0x0b,0x0b,0x0c,0x0c,0x0c,0x0d,0x0d,0x0d,0x0e,0x0e,0x0e,0x0f,0x0f,0x0f,
+    0x10,0x10,0x10,0x11,0x11,0x11,0x12,0x12,0x12,0x13,0x13,0x13,0x14,0x14,0x14,0x15,
+    0x15,0x15,0x16,0x16,0x16,0x17,0x17,0x17,0x18,0x18,0x18,0x19,0x19,0x19,0x1a,0x1a,
+    0x1a,0x1b,0x1b,0x1b,0x1c,0x1c,0x1c,0x1d,0x1d,0x1d,0x1e,0x1e,0x1e,0x1f,0x1f,0x1f,
+    0x20,0x20,0x20,0x21,0x21,0x21,0x22,0x22,0x22,0x23,0x23,0x23,0x24,0x24,0x24,0x25,
+    0x25,0x25,0x26,0x26,0x26,0x27,0x27,0x27,0x28,0x28,0x28,0x29,0x29,0x29,0x2a,0x2a,
+    0x2a,0x2b,0x2b,0x2b,0x2c,0x2c,0x2c,0x2d,0x2d,0x2d,0x2e,0x2e,0x2e,0x2f,0x2f,0x2f,
+    0x30,0x30,0x30,0x31,0x31,0x31,0x32,0x32,0x32,0x33,0x33,0x33,0x34,0x34,0x34,0x35,
+    0x35,0x35,0x36,0x36,0x36,0x37,0x37,0x37,0x38,0x38,0x38,0x39,0x39,0x39,0x3a,0x3a,
+    0x3a,0x3b,0x3b,0x3b,0x3c,0x3c,0x3c,0x3d,0x3d,0x3d,0x3e,0x3e,0x3e,0x3f,0x3f,0x3f,
+    0x40,0x40,0x40,0x41,0x41,0x41,0x42,0x42,0x42,0x43,0x43,0x43,0x44,0x44,0x44,0x45,
+    0x45,0x45,0x46,0x46,0x46,0x47,0x47,0x47,0x48,0x48,0x48,0x49,0x49,0x49,0x4a,0x4a,
+    0x4a,0x4b,0x4b,0x4b,0x4c,0x4c,0x4c,0x4d,0x4d,0x4d,0x4e,0x4e,0x4e,0x4f,0x4f,0x4f,
+    0x50,0x50,0x50,0x51,0x51,0x51,0x52,0x52,0x52,0x53,0x53,0x53,0x54,0x54,0x54,0x55,
+    0x55,0x55,0x56,0x56,0x56,0x57,0x57,0x57,0x58,0x58,0x58,0x59,0x59,0x59,0x5a,0x5a,
+    0x5a,0x5b,0x5b,0x5b,0x5c,0x5c,0x5c,0x5d,0x5d,0x5d,0x5e,0x5e,0x5e,0x5f,0x5f,0x5f,
+    0x60,0x60,0x60,0x61,0x61,0x61,0x62,0x62,0x62,0x63,0x63,0x63,0x64,0x64,0x64,0x65,
+    0x65,0x65,0x66,0x66,0x66,0x67,0x67,0x67,0x68,0x68,0x68,0x69,0x69,0x69,0x6a,0x6a,
+    0x6a,0x6b,0x6b,0x6b,0x6c,0x6c,0x6c,0x6d,0x6d,0x6d,0x6e,0x6e,0x6e,0x6f,0x6f,0x6f,
+    0x70,0x70,0x70,0x71,0x71,0x71,0x72,0x72,0x72,0x73,0x73,0x73,0x74,0x74,0x74,0x75,
+    0x75,0x75,0x76,0x76,0x76,0x77,0x77,0x77,0x78,0x78,0x78,0x79,0x79,0x79,0x7a,0x7a,
+    0x7a,0x7b,0x7b,0x7b,0x7c,0x7c,0x7c,0x7d,0x7d,0x7d,0x7e,0x7e,0x7e,0x7f,0x7f,0x7f,
+    0x80,0x80,0x80,0x81,0x81,0x81,0x82,0x82,0x82,0x83,0x83,0x83,0x84,0x84,0x84,0x85,
+    0x85,0x85,0x86,0x86,0x86,0x87,0x87,0x87,0x88,0x88,0x88,0x89,0x89,0x89,0x8a,0x8a,
+    0x8a,0x8b,0x8b,0x8b,0x8c,0x8c,0x8c,0x8d,0x8d,0x8d,0x8e,0x8e,0x8e,0x8f,0x8f,0x8f,
+    0x90,0x90,0x90,0x91,0x91,0x91,0x92,0x92,0x92,0x93,0x93,0x93,0x94,0x94,0x94,0x95,
+    0x95,0x95,0x96,0x96,0x96,0x97,0x97,0x97,0x98,0x98,0x98,0x99,0x99,0x99,0x9a,0x9a,
+    0x9a,0x9b,0x9b,0x9b,0x9c,0x9c,0x9c,0x9d,0x9d,0x9d,0x9e,0x9e,0x9e,0x9f,0x9f,0x9f,
+    0xa0,0xa0,0xa0,0xa1,0xa1,0xa1,0xa2,0xa2,0xa2,0xa3,0xa3,0xa3,0xa4,0xa4,0xa4,0xa5,
+    0xa5,0xa5,0xa6,0xa6,0xa6,0xa7,0xa7,0xa7,0xa8,0xa8,0xa8,0xa9,0xa9,0xa9,0xaa,0xaa,
+    0xaa,0xab,0xab,0xab,0xac,0xac,0xac,0xad,0xad,0xad,0xae,0xae,0xae,0xaf,0xaf,0xaf,
+    0xb0,0xb0,0xb0,0xb1,0xb1,0xb1,0xb2,0xb2,0xb2,0xb3,0xb3,0xb3,0xb4,0xb4,0xb4,0xb5,
+    0xb5,0xb5,0xb6,0xb6,0xb6,0xb7,0xb7,0xb7,0xb8,0xb8,0xb8,0xb9,0xb9,0xb9,0xba,0xba,
+    0xba,0xbb,0xbb,0xbb,0xbc,0xbc,0xbc,0xbd,0xbd,0xbd,0xbe,0xbe,0xbe,0xbf,0xbf,0xbf,
+    0xc0,0xc0,0xc0,0xc1,0xc1,0xc1,0xc2,0xc2,0xc2,0xc3,0xc3,0xc3,0xc4,0xc4,0xc4,0xc5,
+    0xc5,0xc5,0xc6,0xc6,0xc6,0xc7,0xc7,0xc7,0xc8,0xc8,0xc8,0xc9,0xc9,0xc9,0xca,0xca,
+    0xca,0xcb,0xcb,0xcb,0xcc,0xcc,0xcc,0xcd,0xcd,0xcd,0xce,0xce,0xce,0xcf,0xcf,0xcf,
+    0xd0,0xd0,0xd0,0xd1,0xd1,0xd1,0xd2,0xd2,0xd2,0xd3,0xd3,0xd3,0xd4,0xd4,0xd4,0xd5,
+    0xd5,0xd5,0xd6,0xd6,0xd6,0xd7,0xd7,0xd7,0xd8,0xd8,0xd8,0xd9,0xd9,0xd9,0xda,0xda,
+    0xda,0xdb,0xdb,0xdb,0xdc,0xdc,0xdc,0xdd,0xdd,0xdd,0xde,0xde,0xde,0xdf,0xdf,0xdf,
+    0xe0,0xe0,0xe0,0xe1,0xe1,0xe1,0xe2,0xe2,0xe2,0xe3,0xe3,0xe3,0xe4,0xe4,0xe4,0xe5,
+    0xe5,0xe5,0xe6,0xe6,0xe6,0xe7,0xe7,0xe7,0xe8,0xe8,0xe8,0xe9,0xe9,0xe9,0xea,0xea,
+    0xea,0xeb,0xeb,0xeb,0xec,0xec,0xec,0xed,0xed,0xed,0xee,0xee,0xee,0xef,0xef,0xef,
+    0xf0,0xf0,0xf0,0xf1,0xf1,0xf1,0xf2,0xf2,0xf2,0xf3,0xf3,0xf3,0xf4,0xf4,0xf4,0xf5,
+    0xf5,0xf5,0xf6,0xf6,0xf6,0xf7,0xf7,0xf7,0xf8,0xf8,0xf8,0xf9,0xf9,0xf9,0xfa,0xfa,
+    0xfa,0xfb,0xfb,0xfb,0xfc,0xfc,0xfc,0xfd,0xfd,0xfd,0xfe,0xfe,0xfe,0xff,0xff,0xff
+};
+
+static dma2d_job dma2d_convert_job(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint8_t* clut)
+{
+  const size_t src_bytes = dma2d_pixel_bytes(src_mat.type);
+  const size_t dest_bytes = dma2d_pixel_bytes(dest_mat.type);
+  dma2d_job job = {};
+  job.cr = 0x00010000UL; // M2M with PFC
+  job.fgmar = reinterpret_cast<uintptr_t>(src_mat.ptr<uint8_t>(src_roi.y) + src_roi.x * src_bytes); // source addr
+  if (src_bytes == 1)
+  {
+    job.fgpfccr = 0xFF15; // Input L8, CLUT RGB888, 256 entries
+    job.fgcmar = reinterpret_cast<uintptr_t>(clut); // loaded unless resident
+  }
+  else
+  {
+    job.fgpfccr = dma2d_color_mode(src_mat.type); // format, alpha from the pixels
+  }
+  job.omar = reinterpret_cast<uintptr_t>(dest_mat.ptr<uint8_t>(dest_pos.y) + dest_pos.x * dest_bytes); // target addr
+  job.fgor = src_mat.step[0] / src_bytes - src_roi.width; // source offset
+  job.oor = dest_mat.step[0] / dest_bytes - src_roi.width; // target offset
+  job.opfccr = dma2d_color_mode(dest_mat.type);
+  job.nlr = (uint32_t(src_roi.width) << 16) | (uint16_t)src_roi.height; // cols & rows
+  return job;
+}
+
+dma2d_fence_t dma2d_submit_convert(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint8_t* clut)
+{
+  return dma2d_submit(dma2d_convert_job(src_mat, src_roi, dest_mat, dest_pos, clut));
+}
+
+void dma2d_convert(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint8_t* clut)
+{
+  dma2d_wait_fence(dma2d_submit_convert(src_mat, src_roi, dest_mat, dest_pos, clut));
+}
+
+dma2d_fence_t dma2d_submit_blend(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, uint8_t alpha, uint32_t color)
+{
+  const size_t src_bytes = dma2d_pixel_bytes(src_mat.type);
+  const size_t dest_bytes = dma2d_pixel_bytes(dest_mat.type);
+  const uintptr_t dest = reinterpret_cast<uintptr_t>(dest_mat.ptr<uint8_t>(dest_pos.y) + dest_pos.x * dest_bytes);
+  const uint32_t dest_offset = dest_mat.step[0] / dest_bytes - src_roi.width;
+  dma2d_job job = {};
+  job.cr = 0x00020000UL; // M2M with blending
+  job.fgmar = reinterpret_cast<uintptr_t>(src_mat.ptr<uint8_t>(src_roi.y) + src_roi.x * src_bytes); // foreground addr
+  job.fgor = src_mat.step[0] / src_bytes - src_roi.width; // foreground offset
+  job.fgpfccr = src_mat.type == cv::A8 ? 9 : dma2d_color_mode(src_mat.type); // format, A8 or from dma2d_color_mode
+  if (alpha != 255)
+  {
+    job.fgpfccr |= (uint32_t(alpha) << 24) | (2UL << 16); // alpha multiplied by alpha
+  }
+  job.fgcolr = color & 0x00FFFFFF; // color of A8
+  job.bgmar = dest; // background addr, the dest pixels
+  job.bgor = dest_offset;
+  job.bgpfccr = dma2d_color_mode(dest_mat.type);
+  job.omar = dest; // target addr
+  job.oor = dest_offset; // target offset
+  job.opfccr = dma2d_color_mode(dest_mat.type);
+  job.nlr = (uint32_t(src_roi.width) << 16) | (uint16_t)src_roi.height; // cols & rows
+  return dma2d_submit(job);
+}
+
+void dma2d_blend(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, uint8_t alpha, uint32_t color)
+{
+  dma2d_wait_fence(dma2d_submit_blend(src_mat, src_roi, dest_mat, dest_pos, alpha, color));
+}
+
+dma2d_fence_t dma2d_submit_indexed(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint32_t* palette, bool blend)
+{
+  const size_t bits = src_mat.elemBits();
+  const size_t dest_bytes = dma2d_pixel_bytes(dest_mat.type);
+  const uintptr_t dest = reinterpret_cast<uintptr_t>(dest_mat.ptr<uint8_t>(dest_pos.y) + dest_pos.x * dest_bytes);
+  const uint32_t dest_offset = dest_mat.step[0] / dest_bytes - src_roi.width;
+  dma2d_job job = {};
+  job.cr = blend ? 0x00020000UL : 0x00010000UL; // M2M with blending or with PFC
+  job.fgmar = reinterpret_cast<uintptr_t>(src_mat.ptr<uint8_t>(src_roi.y) + src_roi.x * bits / 8); // source addr
+  job.fgor = src_mat.step[0] * 8 / bits - src_roi.width; // source offset
+  job.fgpfccr = src_mat.type == cv::L4 ? 0x0F08 : 0xFF05; // Input L4 or L8, CLUT ARGB8888, 16 or 256 entries
+  job.fgcmar = reinterpret_cast<uintptr_t>(palette); // loaded unless resident
+  if (blend)
+  {
+    job.bgmar = dest; // background addr, the dest pixels
+    job.bgor = dest_offset;
+    job.bgpfccr = dma2d_color_mode(dest_mat.type);
+  }
+  job.omar = dest; // target addr
+  job.oor = dest_offset; // target offset
+  job.opfccr = dma2d_color_mode(dest_mat.type);
+  job.nlr = (uint32_t(src_roi.width) << 16) | (uint16_t)src_roi.height; // cols & rows
+  return dma2d_submit(job);
+}
+
+void dma2d_indexed(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint32_t* palette, bool blend)
+{
+  dma2d_wait_fence(dma2d_submit_indexed(src_mat, src_roi, dest_mat, dest_pos, palette, blend));
+}
+
+dma2d_fence_t dma2d_submit_flat_rgb332_to_rgb565(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer, int watermark)
+{
+  cv::Mat flat(roi.height, roi.width, cv::RGB565, const_cast<void*>(buffer));
+  dma2d_job job = dma2d_convert_job(mat, roi, flat, cv::Point(0, 0), RGB332toRGB888LUT);
+  job.lwr = watermark > 0 && watermark < roi.height ? uint32_t(watermark) : 0;
+  return dma2d_submit(job);
+}
+
 void dma2d_flat_rgb332_to_rgb565(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer)
 {
-  dma2d_init();
-  DMA2D->CR = 0x00010000UL; // M2M with PFC
-  DMA2D->FGMAR   = reinterpret_cast<uint32_t>(mat.ptr<uint8_t>(roi.y, roi.x)); // source addr
-  DMA2D->FGPFCCR  = 0xFF15; // Input L8, CLUT RGB888, 256 entries
-  DMA2D->FGCMAR = reinterpret_cast<uint32_t>(RGB332toRGB888LUT); // CLUT Address
-  DMA2D->FGPFCCR |= DMA2D_FGPFCCR_START; // Load CLUT
-  while (DMA2D->FGPFCCR & DMA2D_FGPFCCR_START) {}
-  DMA2D->OMAR = reinterpret_cast<uint32_t>(buffer); // target addr
-  DMA2D->FGOR    = mat.step[0] / mat.step[1] - roi.width;     // source offset
-  DMA2D->OOR     = 0;     // target offset
-  DMA2D->OPFCCR  = 2;  // RGB565
-  DMA2D->NLR  = (uint32_t(roi.width) << 16) | (uint16_t)roi.height; // cols & rows
-  clean_cache_for_matrix(mat, roi);
-  DMA2D->CR |= DMA2D_CR_START;
-  dma2d_wait();
+  dma2d_wait_fence(dma2d_submit_flat_rgb332_to_rgb565(mat, roi, buffer));
 }
 
 #endif
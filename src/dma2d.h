@@ -5,19 +5,114 @@
 
 #if defined(DMA2D)
 
-// clean DCACHE for the mat
+// D-cache size; maintaining more lines than it holds goes through the whole
+// D-cache instead
+#ifndef DMA2D_DCACHE_BYTES
+#define DMA2D_DCACHE_BYTES 16384
+#endif
+
+// clean DCACHE for roi of the mat, row by row where the rows are far apart
+// The dma2d_* functions below maintain the D-cache themselves: they clean
+// what a transfer reads, and clean and invalidate what it writes before it
+// and invalidate that again once it completes. The CPU must not write to the
+// 32-byte lines holding the output of a transfer until it is done.
 void clean_cache_for_matrix(const cv::Mat& mat, const cv::Rect& roi);
 
-// fill the mat with the given color
-void dma2d_fill(const cv::Mat& mat, uint16_t color);
+// Mark memory the MPU maps non-cacheable (e.g. an SDRAM framebuffer), so
+// transfers within it skip the D-cache maintenance; false once
+// DMA2D_NON_CACHEABLE_REGIONS regions are marked
+constexpr int DMA2D_NON_CACHEABLE_REGIONS = 4;
+
+bool dma2d_set_non_cacheable(const volatile void* addr, size_t size);
+
+// fill the mat with the given color (a pixel value of the mat type)
+void dma2d_fill(const cv::Mat& mat, uint32_t color);
 
 // copy roi of source mat to the given position of dest mat
+// for L4 the roi x, roi width and dest x must be even
 void dma2d_copy(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos);
 
-// copy the mat to the target continuous buffer
+// copy the mat to the target continuous buffer, L4 rows are padded to whole bytes
 void dma2d_flat_copy(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer);
 
+// RGB888 CLUTs of RGB332 pixels and of GRAY8 levels
+extern const uint8_t RGB332toRGB888LUT[768];
+extern const uint8_t GRAY8toRGB888LUT[768];
+
+// convert roi of source mat to the pixel format of dest mat at the given
+// position; RGB565, RGB888 and ARGB8888 sources are read as they are, 8-bit
+// sources as L8 through the given 256 entry RGB888 clut
+// dest mat must be RGB565, RGB888 or ARGB8888
+void dma2d_convert(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint8_t* clut = nullptr);
+
+// blend roi of source mat over dest mat at the given position, the source
+// alpha scaled by alpha; ARGB8888, ARGB4444 or A8 sources, A8 taking the
+// RGB888 color; dest mat must be RGB565, RGB888 or ARGB8888
+void dma2d_blend(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, uint8_t alpha = 255, uint32_t color = 0);
+
+// expand roi of source mat, palette indices, through palette into dest mat
+// at the given position; L4 sources take 16 and 8-bit sources (read as L8)
+// 256 ARGB8888 palette entries. With blend the palette alpha blends the
+// colors over dest mat, otherwise they replace its pixels.
+// dest mat must be RGB565, RGB888 or ARGB8888
+void dma2d_indexed(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint32_t* palette, bool blend = false);
+
 // transform a RGB332 mat to RGB565 and output to the target continuous buffer
 void dma2d_flat_rgb332_to_rgb565(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer);
 
+// The CLUT of the last transfer stays loaded: transfers through a clut or
+// palette of the same colors, with no more entries in the same format, skip
+// the CLUT load. Submitting compares the colors with a copy of those of the
+// transfer queued last; a load runs before its transfer, which the interrupt
+// of its completion starts.
+// Forgets the loaded CLUT, so that the next transfer loads its own.
+void dma2d_invalidate_clut();
+
+// Queued transfers. The dma2d_submit_* functions take the same arguments as
+// the blocking functions above, queue the transfer and return a fence
+// without waiting; the transfer-complete interrupt starts the next queued
+// transfer, so the CPU can draw elsewhere meanwhile. Transfers run in
+// submit order and fences increase in that order: a fence is done once its
+// transfer and all earlier ones are. The mats, buffers and CLUTs must stay
+// valid, and the CPU must not touch their pixels, until the fence is done. Submitting to a full
+// queue waits for a free slot; the blocking functions wait for their own
+// fence, and thus for the transfers queued before them too.
+typedef uint32_t dma2d_fence_t;
+
+// jobs the queue holds, including the running one
+constexpr int DMA2D_QUEUE_SIZE = 16;
+
+dma2d_fence_t dma2d_submit_fill(const cv::Mat& mat, uint32_t color);
+
+dma2d_fence_t dma2d_submit_copy(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos);
+
+dma2d_fence_t dma2d_submit_flat_copy(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer);
+
+dma2d_fence_t dma2d_submit_convert(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint8_t* clut = nullptr);
+
+dma2d_fence_t dma2d_submit_blend(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, uint8_t alpha = 255, uint32_t color = 0);
+
+dma2d_fence_t dma2d_submit_indexed(const cv::Mat& src_mat, const cv::Rect& src_roi, const cv::Mat& dest_mat, const cv::Point& dest_pos, const uint32_t* palette, bool blend = false);
+
+// With watermark > 0 the transfer raises the line-watermark interrupt every
+// watermark lines, so dma2d_fence_lines tells how much of buffer is written
+// while the rest still converts (e.g. to send the lines to a display)
+dma2d_fence_t dma2d_submit_flat_rgb332_to_rgb565(const cv::Mat& mat, const cv::Rect& roi, volatile void *buffer, int watermark = 0);
+
+// true once the transfer of fence has completed; fence 0 is always done
+bool dma2d_fence_done(dma2d_fence_t fence);
+
+void dma2d_wait_fence(dma2d_fence_t fence);
+
+// Output lines of the transfer of fence known to be written: 0 while it is
+// queued, the lines its watermark interrupts reached while it runs, INT_MAX
+// once it is done
+int dma2d_fence_lines(dma2d_fence_t fence);
+
+// fence of the last submitted transfer
+dma2d_fence_t dma2d_last_fence();
+
+// wait until the queue is empty
+void dma2d_wait();
+
 #endif